@@ -0,0 +1,37 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_ENV_MEM_CALL_STACK
+#define COGS_HEADER_ENV_MEM_CALL_STACK
+
+
+#include "cogs/env.hpp"
+#include "cogs/os.hpp"
+
+
+namespace cogs {
+namespace env {
+
+
+/// @brief Captures return addresses of the calling thread's stack
+/// @param frames Receives the return addresses, innermost first
+/// @param maxFrames Maximum number of return addresses to capture
+/// @param skipFrames Number of innermost frames to omit, not including get_call_stack() itself
+/// @return The number of return addresses captured
+inline size_t get_call_stack(void** frames, size_t maxFrames, size_t skipFrames = 0)
+{
+	if (maxFrames > 0xFFFF)
+		maxFrames = 0xFFFF;
+	return CaptureStackBackTrace((DWORD)(skipFrames + 1), (DWORD)maxFrames, frames, NULL);
+}
+
+
+}
+}
+
+
+#endif
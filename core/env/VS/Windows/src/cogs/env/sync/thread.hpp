@@ -43,6 +43,14 @@ public:
 
 inline unsigned int get_processor_count() { return os::get_processor_count(); }
 
+inline unsigned int get_numa_node_count() { return os::get_numa_node_count(); }
+
+inline processor_set get_numa_node_processors(unsigned int node) { return os::get_numa_node_processors(node); }
+
+inline unsigned int get_current_numa_node() { return os::get_current_numa_node(); }
+
+inline bool set_current_thread_affinity(const processor_set& processors) { return os::set_current_thread_affinity(processors); }
+
 }
 }
 
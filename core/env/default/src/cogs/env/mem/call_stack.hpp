@@ -0,0 +1,31 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_ENV_MEM_CALL_STACK
+#define COGS_HEADER_ENV_MEM_CALL_STACK
+
+
+#include "cogs/env.hpp"
+
+
+namespace cogs {
+namespace env {
+
+
+/// @brief Captures return addresses of the calling thread's stack.  Not supported by the default environment.
+/// @return 0
+inline size_t get_call_stack(void**, size_t, size_t = 0)
+{
+	return 0;
+}
+
+
+}
+}
+
+
+#endif
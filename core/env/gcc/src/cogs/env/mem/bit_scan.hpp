@@ -33,7 +33,7 @@ inline std::enable_if_t<
 bit_scan_reverse(const int_t& bits)
 {
 	COGS_ASSERT(!!bits);
-	return (sizeof(unsigned int) * 8) - __builtin_clz((unsigned int)load(bits));
+	return ((sizeof(unsigned int) * 8) - 1) - __builtin_clz((unsigned int)load(bits));
 }
 
 // bits must not be zero
@@ -47,7 +47,7 @@ inline std::enable_if_t<
 bit_scan_reverse(const int_t& bits)
 {
 	COGS_ASSERT(!!bits);
-	return (sizeof(unsigned long) * 8) - __builtin_clzl((unsigned long)load(bits));
+	return ((sizeof(unsigned long) * 8) - 1) - __builtin_clzl((unsigned long)load(bits));
 }
 
 // bits must not be zero
@@ -61,7 +61,7 @@ inline std::enable_if_t<
 bit_scan_reverse(const int_t& bits)
 {
 	COGS_ASSERT(!!bits);
-	return (sizeof(unsigned long long) * 8) - __builtin_clzll((unsigned long long)load(bits));
+	return ((sizeof(unsigned long long) * 8) - 1) - __builtin_clzll((unsigned long long)load(bits));
 }
 
 
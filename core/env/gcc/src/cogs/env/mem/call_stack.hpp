@@ -0,0 +1,53 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_ENV_MEM_CALL_STACK
+#define COGS_HEADER_ENV_MEM_CALL_STACK
+
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#endif
+
+#include "cogs/env.hpp"
+
+
+namespace cogs {
+namespace env {
+
+
+/// @brief Captures return addresses of the calling thread's stack
+/// @param frames Receives the return addresses, innermost first
+/// @param maxFrames Maximum number of return addresses to capture
+/// @param skipFrames Number of innermost frames to omit, not including get_call_stack() itself
+/// @return The number of return addresses captured.  0 if not supported.
+inline size_t get_call_stack(void** frames, size_t maxFrames, size_t skipFrames = 0)
+{
+#if __has_include(<execinfo.h>)
+	void* buf[128];
+	size_t n = skipFrames + 1 + maxFrames;
+	if (n > sizeof(buf) / sizeof(buf[0]))
+		n = sizeof(buf) / sizeof(buf[0]);
+	int captured = backtrace(buf, (int)n);
+	size_t result = 0;
+	for (int i = (int)skipFrames + 1; i < captured; i++)
+		frames[result++] = buf[i];
+	return result;
+#else
+	(void)frames;
+	(void)maxFrames;
+	(void)skipFrames;
+	return 0;
+#endif
+}
+
+
+}
+}
+
+
+#endif
@@ -8,6 +8,10 @@
 #ifndef COGS_HEADER_ENV_SYNC_YIELD
 #define COGS_HEADER_ENV_SYNC_YIELD
 
+#if defined(__x86_64__) || defined(i386) || defined(__i386__) || defined(__i386)
+#include <xmmintrin.h>
+#endif
+
 #include "cogs/os.hpp"
 
 namespace cogs {
@@ -24,6 +24,7 @@
 #include "cogs/os/sync/semaphore.hpp"
 #include "cogs/os/sync/timeout.hpp"
 #include "cogs/operators.hpp"
+#include "cogs/sync/processor_set.hpp"
 #include "cogs/sync/atomic_load.hpp"
 
 
@@ -184,6 +185,23 @@ inline unsigned int get_processor_count()
 }
 
 
+// MacOS does not expose NUMA topology or support binding threads to processors.
+
+inline unsigned int get_numa_node_count() { return 1; }
+
+inline processor_set get_numa_node_processors(unsigned int node)
+{
+	processor_set result;
+	if (!node)
+		result.add_range(0, get_processor_count() - 1);
+	return result;
+}
+
+inline unsigned int get_current_numa_node() { return 0; }
+
+inline bool set_current_thread_affinity(const processor_set&) { return false; }
+
+
 }
 }
 
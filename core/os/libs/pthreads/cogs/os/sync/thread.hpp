@@ -10,7 +10,9 @@
 
 
 #include <errno.h>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
 #include <semaphore.h>
 #include <time.h>
 #include <stdlib.h>
@@ -25,6 +27,14 @@
 #include "cogs/os/sync/semaphore.hpp"
 #include "cogs/os/sync/timeout.hpp"
 #include "cogs/operators.hpp"
+#include "cogs/sync/processor_set.hpp"
+
+
+#ifndef COGS_MAX_NUMA_NODES
+
+/// @brief The maximum number of NUMA nodes recognized
+#define COGS_MAX_NUMA_NODES 64
+#endif
 
 
 namespace cogs {
@@ -160,6 +170,115 @@ inline unsigned int get_processor_count()
 }
 
 
+#if defined(__linux__)
+
+// Reads a processor list or node list from sysfs
+inline bool read_sysfs_list(const char* path, processor_set& result)
+{
+	int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return false;
+	char buf[4096];
+	ssize_t n = ::read(fd, buf, sizeof(buf) - 1);
+	::close(fd);
+	if (n <= 0)
+		return false;
+	buf[n] = 0;
+	result = processor_set::parse_list(buf);
+	return !result.is_empty();
+}
+
+class numa_topology
+{
+public:
+	unsigned int m_nodeCount;
+	processor_set m_nodeProcessors[COGS_MAX_NUMA_NODES];
+	unsigned short m_processorNodes[processor_set::max_processors];
+
+	numa_topology()
+		: m_nodeCount(0)
+	{
+		for (size_t i = 0; i < processor_set::max_processors; i++)
+			m_processorNodes[i] = 0;
+		processor_set nodes;
+		if (read_sysfs_list("/sys/devices/system/node/online", nodes))
+		{
+			// Node indexes may be sparse.  Offline nodes are left empty.
+			for (size_t node = nodes.find_next(0); node < COGS_MAX_NUMA_NODES; node = nodes.find_next(node + 1))
+			{
+				char path[64];
+				snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", (unsigned int)node);
+				processor_set& processors = m_nodeProcessors[node];
+				if (!read_sysfs_list(path, processors))
+					continue;
+				m_nodeCount = (unsigned int)node + 1;
+				for (size_t i = processors.find_next(0); i != processor_set::max_processors; i = processors.find_next(i + 1))
+					m_processorNodes[i] = (unsigned short)node;
+			}
+		}
+		if (!m_nodeCount)
+		{
+			// NUMA info is not available.  Treat all processors as a single node.
+			m_nodeCount = 1;
+			if (!read_sysfs_list("/sys/devices/system/cpu/online", m_nodeProcessors[0]))
+				m_nodeProcessors[0].add_range(0, get_processor_count() - 1);
+		}
+	}
+
+	static const numa_topology& get()
+	{
+		static numa_topology s_topology;
+		return s_topology;
+	}
+};
+
+inline unsigned int get_numa_node_count() { return numa_topology::get().m_nodeCount; }
+
+inline processor_set get_numa_node_processors(unsigned int node)
+{
+	const numa_topology& topology = numa_topology::get();
+	if (node >= topology.m_nodeCount)
+		return processor_set();
+	return topology.m_nodeProcessors[node];
+}
+
+inline unsigned int get_current_numa_node()
+{
+	const numa_topology& topology = numa_topology::get();
+	int cpu = sched_getcpu();
+	if (cpu < 0 || (size_t)cpu >= processor_set::max_processors)
+		return 0;
+	return topology.m_processorNodes[cpu];
+}
+
+inline bool set_current_thread_affinity(const processor_set& processors)
+{
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	for (size_t i = processors.find_next(0); i != processor_set::max_processors && i < CPU_SETSIZE; i = processors.find_next(i + 1))
+		CPU_SET(i, &cpuSet);
+	return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+}
+
+#else
+
+inline unsigned int get_numa_node_count() { return 1; }
+
+inline processor_set get_numa_node_processors(unsigned int node)
+{
+	processor_set result;
+	if (!node)
+		result.add_range(0, get_processor_count() - 1);
+	return result;
+}
+
+inline unsigned int get_current_numa_node() { return 0; }
+
+inline bool set_current_thread_affinity(const processor_set&) { return false; }
+
+#endif
+
+
 }
 }
 
@@ -12,14 +12,36 @@
 #include <sys/epoll.h>
 
 #include "cogs/env.hpp"
-#include "cogs/collections/map.hpp"
+#include "cogs/collections/vector.hpp"
 #include "cogs/function.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
 #include "cogs/os/io/auto_fd.hpp"
 #include "cogs/mem/placement.hpp"
 #include "cogs/mem/rcnew.hpp"
 #include "cogs/sync/cleanup_queue.hpp"
 #include "cogs/sync/dispatcher.hpp"
+#include "cogs/sync/thread.hpp"
 #include "cogs/sync/thread_pool.hpp"
+#include "cogs/sync/yield.hpp"
+
+
+#ifndef COGS_EPOLL_POOL_BATCH_SIZE
+
+/// @brief The maximum number of events os::io::epoll_pool retrieves from a single call to epoll_wait()
+///
+/// All events retrieved by a wakeup are dispatched by the same epoll thread before it waits again.
+/// A value of 1 retrieves and dispatches one event per epoll_wait() call.
+#define COGS_EPOLL_POOL_BATCH_SIZE 64
+#endif
+
+
+#ifndef COGS_EPOLL_POOL_NUMA_AFFINITY
+
+/// @brief If non-zero, os::io::epoll_pool threads are distributed across NUMA nodes, each restricted to run on
+/// the processors of its node.  Delegates are invoked on epoll threads, so work in response to I/O starts on
+/// the same node as the thread that received it.
+#define COGS_EPOLL_POOL_NUMA_AFFINITY 0
+#endif
 
 
 namespace cogs {
@@ -32,9 +54,38 @@ private:
 	thread_pool m_pool;
 	rcref<auto_fd> m_fd;
 
-	// Need to keep track of listenings in a less than ideal mannger, since kqueue does not tell us,
-	// in a race-condition-free manner, when listening sockets close.
-	typedef map<int, function<void()> > map_t;
+	// Waiters are stored in per-fd slots, in a table directly indexed by fd.  Since only one waiter
+	// is registered per fd at a time, a slot is claimed by whichever of the epoll thread, abort_waiter()
+	// or deregister_listener() first transitions it out of the armed state.
+	//
+	// Each time a slot is armed, its generation is incremented.  The generation is passed to epoll in
+	// epoll_event.data.u64, along with the fd.  An event that arrives for an older generation
+	// (i.e. after its waiter was aborted, or after the fd was closed and reused) is ignored.
+	//
+	// Slot state: (generation << 2) | phase
+	static constexpr uint64_t slot_idle = 0;
+	static constexpr uint64_t slot_armed = 1;
+	static constexpr uint64_t slot_busy = 2; // Claimed, delegate being moved out of the slot
+	static constexpr uint64_t slot_phase_mask = 3;
+
+	// Generation 0 is never armed.  It's used when no waiter is registered, so events are ignored.
+	static constexpr uint64_t shutdown_tag = ~(uint64_t)0;
+
+	static uint64_t make_tag(int fd, uint64_t generation) { return ((generation & 0xFFFFFFFF) << 32) | (uint32_t)fd; }
+	static int get_tag_fd(uint64_t tag) { return (int)(uint32_t)tag; }
+	static uint32_t get_tag_generation(uint64_t tag) { return (uint32_t)(tag >> 32); }
+
+	class slot
+	{
+	public:
+		volatile uint64_t m_state alignas(cogs::atomic::get_alignment_v<uint64_t>);
+		function<void()> m_delegate;
+
+		slot() : m_state(0) { }
+	};
+
+	static constexpr size_t slots_per_page = 1024;
+	static constexpr size_t max_pages = 4096; // Supports fd values up to 4M
 
 	class task
 	{
@@ -42,52 +93,150 @@ private:
 		rcref<auto_fd> m_fd;
 		int m_shutdownSocket[2];
 		size_t m_remainingThreads;
-		volatile map_t m_tasks;
+		slot* volatile m_pages[max_pages];
 		weak_rcptr<epoll_pool> m_epollPool;
+		const size_t m_batchSize;
+
+		volatile size_type m_wakeupCount;
+		volatile size_type m_eventCount;
+		volatile size_type m_fullBatchCount;
 
-		task(const rcref<auto_fd>& fd, const rcref<epoll_pool>& epp)
+		task(const rcref<auto_fd>& fd, const rcref<epoll_pool>& epp, size_t batchSize)
 			: m_fd(fd),
-			m_epollPool(epp)
+			m_epollPool(epp),
+			m_batchSize(batchSize),
+			m_wakeupCount(0),
+			m_eventCount(0),
+			m_fullBatchCount(0)
 		{
+			for (size_t i = 0; i < max_pages; i++)
+				m_pages[i] = nullptr;
 		}
 
-		void run()
+		~task()
+		{
+			for (size_t i = 0; i < max_pages; i++)
+				default_memory_manager::destruct_deallocate_type(m_pages[i], slots_per_page);
+		}
+
+		slot& get_slot(int fd)
 		{
+			COGS_ASSERT(fd >= 0);
+			size_t pageIndex = (size_t)fd / slots_per_page;
+			COGS_ASSERT(pageIndex < max_pages);
+			slot* page = cogs::atomic::load(m_pages[pageIndex]);
+			if (!page)
+			{
+				slot* newPage = default_memory_manager::allocate_type<slot>(slots_per_page);
+				placement_construct_multiple(newPage, slots_per_page);
+				if (cogs::atomic::compare_exchange(m_pages[pageIndex], newPage, page, page))
+					page = newPage;
+				else
+					default_memory_manager::destruct_deallocate_type(newPage, slots_per_page);
+			}
+			return page[(size_t)fd % slots_per_page];
+		}
+
+		// Returns the new generation
+		uint64_t arm(int fd, const function<void()>& d)
+		{
+			slot& s = get_slot(fd);
+			uint64_t oldState = cogs::atomic::load(s.m_state);
+			for (;;)
+			{
+				uint64_t phase = oldState & slot_phase_mask;
+				if (phase == slot_busy) // A prior waiter is still being claimed.
+				{
+					yield();
+					cogs::atomic::load(s.m_state, oldState);
+					continue;
+				}
+				COGS_ASSERT(phase == slot_idle); // Only one waiter per fd at a time
+				break;
+			}
+			s.m_delegate = d;
+			uint64_t generation = (oldState >> 2) + 1;
+			if (!(generation & 0xFFFFFFFF)) // Skip generation 0 as it wraps
+				++generation;
+			cogs::atomic::store(s.m_state, (generation << 2) | slot_armed);
+			return generation;
+		}
+
+		bool claim(int fd, uint32_t generation, function<void()>& d)
+		{
+			slot& s = get_slot(fd);
+			uint64_t oldState = cogs::atomic::load(s.m_state);
 			for (;;)
 			{
-				struct epoll_event ev;
-				int i = epoll_wait(m_fd->get(), &ev, 1, -1);
-				if ((i == -1) && (errno == EINTR))
+				if (((oldState & slot_phase_mask) != slot_armed) || ((uint32_t)(oldState >> 2) != generation))
+					return false;
+				uint64_t busyState = (oldState & ~slot_phase_mask) | slot_busy;
+				if (cogs::atomic::compare_exchange(s.m_state, busyState, oldState, oldState))
+					break;
+			}
+			d = std::move(s.m_delegate);
+			s.m_delegate.release();
+			cogs::atomic::store(s.m_state, (oldState & ~slot_phase_mask) | slot_idle);
+			return true;
+		}
+
+		bool is_armed(int fd, uint32_t generation)
+		{
+			slot& s = get_slot(fd);
+			uint64_t state = cogs::atomic::load(s.m_state);
+			return ((state & slot_phase_mask) == slot_armed) && ((uint32_t)(state >> 2) == generation);
+		}
+
+		void run()
+		{
+			size_t batchSize = m_batchSize;
+			vector<struct epoll_event> events(batchSize);
+			struct epoll_event* ev = events.get_ptr();
+			function<void()> d;
+			bool exiting = false;
+			while (!exiting)
+			{
+				int n = epoll_wait(m_fd->get(), ev, (int)batchSize, -1);
+				if ((n == -1) && (errno == EINTR))
 					continue;
-				COGS_ASSERT(i != -1);
-				if (i > 0)
+				COGS_ASSERT(n != -1);
+				if (n <= 0)
+					continue;
+				assign_next(m_wakeupCount);
+				assign_add(m_eventCount, n);
+				if ((size_t)n == batchSize)
+					assign_next(m_fullBatchCount);
+				for (int j = 0; j < n; j++)
 				{
-					int fd = ev.data.fd;
-					if (fd == m_fd->get()) // must have been triggered by m_shutdownSocket
+					uint64_t tag = ev[j].data.u64;
+					if (tag == shutdown_tag) // must have been triggered by m_shutdownSocket
 					{
+						// Finish dispatching the rest of this batch before exiting.
+						exiting = true;
 						close(m_shutdownSocket[0]);
 						close(m_shutdownSocket[1]);
 						if (--m_remainingThreads > 0) // if more threads waiting, signal another
 						{
-							i = pipe(m_shutdownSocket); // Use a pipe to tell epoll threads to shut down
+							int i = pipe(m_shutdownSocket); // Use a pipe to tell epoll threads to shut down
 							COGS_ASSERT(i != -1);
-							ev.events = EPOLLONESHOT | EPOLLOUT | EPOLLERR | EPOLLHUP;
-							ev.data.fd = fd;
-							i = epoll_ctl(m_fd->get(), EPOLL_CTL_ADD, m_shutdownSocket[1], &ev);
+							struct epoll_event shutdownEvent;
+							shutdownEvent.events = EPOLLONESHOT | EPOLLOUT | EPOLLERR | EPOLLHUP;
+							shutdownEvent.data.u64 = shutdown_tag;
+							i = epoll_ctl(m_fd->get(), EPOLL_CTL_ADD, m_shutdownSocket[1], &shutdownEvent);
 							COGS_ASSERT(i != -1);
 						}
-						break;
+						continue;
 					}
-					map_t::volatile_iterator itor = m_tasks.find(fd);
-					if (!!itor)
+					uint32_t generation = get_tag_generation(tag);
+					if (!generation) // Not armed
+						continue;
+					if (claim(get_tag_fd(tag), generation, d))
 					{
-						if (m_tasks.remove(itor).wasRemoved)
-						{
-							rcptr<epoll_pool> epp = m_epollPool;
-							COGS_ASSERT(!!epp);
-							epp->self_release();
-						}
-						itor->value();
+						rcptr<epoll_pool> epp = m_epollPool;
+						COGS_ASSERT(!!epp);
+						epp->self_release();
+						d();
+						d.release();
 					}
 				}
 			}
@@ -101,19 +250,27 @@ private:
 		m_pool.start();
 		size_t threadCount = m_pool.get_thread_count();
 		m_func->m_remainingThreads = threadCount;
-		m_pool.dispatch_parallel(threadCount, [r{ m_func.dereference() }]()
+		m_pool.dispatch_parallel(threadCount, [r{ m_func.dereference() }](size_t i)
 		{
+#if COGS_EPOLL_POOL_NUMA_AFFINITY
+			// Each epoll thread blocks in run(), so each index is claimed by a different thread.
+			cogs::set_current_thread_affinity(cogs::get_numa_node_processors((unsigned int)(i % cogs::get_numa_node_count())));
+#else
+			(void)i;
+#endif
 			r->run();
 		});
 	}
 
 protected:
-	epoll_pool()
+	explicit epoll_pool(size_t batchSize = COGS_EPOLL_POOL_BATCH_SIZE)
 		: m_fd(rcnew(auto_fd))
 	{
+		if (!batchSize)
+			batchSize = 1;
 		int fd = epoll_create1(0);
 		m_fd->get() = fd;
-		m_func = rcnew(task)(m_fd, this_rcref);
+		m_func = rcnew(task)(m_fd, this_rcref, batchSize);
 	}
 
 public:
@@ -123,7 +280,7 @@ public:
 		COGS_ASSERT(i != -1);
 		struct epoll_event ev;
 		ev.events = EPOLLONESHOT | EPOLLOUT | EPOLLERR | EPOLLHUP;
-		ev.data.fd = m_fd->get();
+		ev.data.u64 = shutdown_tag;
 		i = epoll_ctl(m_fd->get(), EPOLL_CTL_ADD, m_func->m_shutdownSocket[1], &ev);
 		COGS_ASSERT(i != -1);
 		m_pool.shutdown();
@@ -139,11 +296,38 @@ public:
 		return result;
 	}
 
+	/// @brief Counters describing how many readiness events each epoll_wait() wakeup has dispatched
+	struct stats
+	{
+		/// @brief Number of epoll_wait() calls that returned one or more events
+		size_t wakeupCount;
+
+		/// @brief Total number of events returned by epoll_wait()
+		size_t eventCount;
+
+		/// @brief Number of wakeups that returned a full batch.  If this is a large proportion
+		/// of wakeupCount, a larger batch size may reduce the number of epoll_wait() calls.
+		size_t fullBatchCount;
+
+		double get_events_per_wakeup() const { return !wakeupCount ? 0.0 : ((double)eventCount / (double)wakeupCount); }
+	};
+
+	stats get_stats() const
+	{
+		stats result;
+		result.wakeupCount = load(m_func->m_wakeupCount).get_int();
+		result.eventCount = load(m_func->m_eventCount).get_int();
+		result.fullBatchCount = load(m_func->m_fullBatchCount).get_int();
+		return result;
+	}
+
+	size_t get_batch_size() const { return m_func->m_batchSize; }
+
 	void register_fd(int fd)
 	{
 		struct epoll_event ev;
 		ev.events = EPOLLERR | EPOLLHUP | EPOLLET;
-		ev.data.fd = fd;
+		ev.data.u64 = make_tag(fd, 0);
 		int i = epoll_ctl(m_fd->get(), EPOLL_CTL_ADD, fd, &ev);
 		COGS_ASSERT(i != -1);
 	}
@@ -153,62 +337,79 @@ public:
 	protected:
 		friend class epoll_pool;
 
-		map_t::volatile_remove_token m_removeToken;
 		int m_fd;
+		uint32_t m_generation;
+		weak_rcptr<task> m_task;
 
-		remove_token(int fd, const map_t::volatile_remove_token& rt)
+		remove_token(int fd, uint32_t generation, const rcref<task>& t)
 			: m_fd(fd),
-			m_removeToken(rt)
+			m_generation(generation),
+			m_task(t)
 		{
 		}
 
 	public:
-		remove_token() { }
-		remove_token(const remove_token& rt) : m_fd(rt.m_fd), m_removeToken(rt.m_removeToken) { }
-		remove_token& operator=(const remove_token& rt) { m_fd = rt.m_fd; m_removeToken = rt.m_removeToken; return *this; }
-		bool is_active() const { return m_removeToken.is_active(); }
-		void release() { m_removeToken.release(); }
-		bool operator!() const { return !m_removeToken; }
-		bool operator==(const remove_token& rt) const { return m_removeToken == rt.m_removeToken; }
+		remove_token() : m_fd(-1), m_generation(0) { }
+		remove_token(const remove_token& rt) : m_fd(rt.m_fd), m_generation(rt.m_generation), m_task(rt.m_task) { }
+		remove_token& operator=(const remove_token& rt) { m_fd = rt.m_fd; m_generation = rt.m_generation; m_task = rt.m_task; return *this; }
+
+		bool is_active() const
+		{
+			if (!m_generation)
+				return false;
+			rcptr<task> t = m_task;
+			return !!t && t->is_armed(m_fd, m_generation);
+		}
+
+		void release() { m_fd = -1; m_generation = 0; m_task.release(); }
+		bool operator!() const { return !m_generation; }
+		bool operator==(const remove_token& rt) const { return (m_fd == rt.m_fd) && (m_generation == rt.m_generation); }
 		bool operator!=(const remove_token& rt) const { return !operator==(rt); }
 	};
 
-
-	remove_token wait_writable(int fd, const function<void()>& d)
+private:
+	remove_token wait(int fd, uint32_t events, const function<void()>& d)
 	{
 		self_acquire();
+		uint64_t generation = m_func->arm(fd, d);
 		struct epoll_event ev;
-		ev.events = EPOLLONESHOT | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET;
-		ev.data.fd = fd;
-		map_t::volatile_iterator itor = m_func->m_tasks.insert_unique(fd, d).inserted;
-		COGS_ASSERT(!!itor); // shouldn't fail
+		ev.events = events;
+		ev.data.u64 = make_tag(fd, generation);
 		int i = epoll_ctl(m_fd->get(), EPOLL_CTL_MOD, fd, &ev);
 		COGS_ASSERT(i != -1);
-		remove_token result(fd, itor);
+		remove_token result(fd, (uint32_t)generation, m_func.dereference());
 		return result;
 	}
 
+	bool claim(const remove_token& rt)
+	{
+		if (!rt.m_generation)
+			return false;
+		function<void()> d;
+		if (!m_func->claim(rt.m_fd, rt.m_generation, d))
+			return false;
+		self_release();
+		return true;
+	}
+
+public:
+	remove_token wait_writable(int fd, const function<void()>& d)
+	{
+		return wait(fd, EPOLLONESHOT | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET, d);
+	}
+
 	remove_token wait_readable(int fd, const function<void()>& d)
 	{
-		self_acquire();
-		struct epoll_event ev;
-		ev.events = EPOLLONESHOT | EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET;
-		ev.data.fd = fd;
-		map_t::volatile_iterator itor = m_func->m_tasks.insert_unique(fd, d).inserted;
-		COGS_ASSERT(!!itor); // shouldn't fail
-		int i = epoll_ctl(m_fd->get(), EPOLL_CTL_MOD, fd, &ev);
-		COGS_ASSERT(i != -1);
-		remove_token result(fd, itor);
-		return result;
+		return wait(fd, EPOLLONESHOT | EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET, d);
 	}
 
 	void abort_waiter(const remove_token& rt)
 	{
-		if (m_func->m_tasks.remove(rt.m_removeToken).wasRemoved)
+		if (claim(rt))
 		{
-			self_release();
 			struct epoll_event ev;
 			ev.events = EPOLLERR | EPOLLHUP | EPOLLET;
+			ev.data.u64 = make_tag(rt.m_fd, 0);
 			int i = epoll_ctl(m_fd->get(), EPOLL_CTL_MOD, rt.m_fd, &ev);
 			COGS_ASSERT(i != -1);
 		}
@@ -216,26 +417,15 @@ public:
 
 	remove_token register_listener(int fd, const function<void()>& d)
 	{
-		self_acquire();
-		struct epoll_event ev;
-		ev.events = EPOLLONESHOT | EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET;
-		ev.data.fd = fd; // mark lsb to clue other thread in that this is a listener FD
-		map_t::volatile_iterator itor = m_func->m_tasks.insert_unique(fd, d).inserted;
-		COGS_ASSERT(!!itor); // shouldn't fail
-		int i = epoll_ctl(m_fd->get(), EPOLL_CTL_MOD, fd, &ev);
-		COGS_ASSERT(i != -1);
-		remove_token result(fd, itor);
-		return result;
+		return wait(fd, EPOLLONESHOT | EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLET, d);
 	}
 
 	void deregister_listener(const remove_token& rt)
 	{
-		if (m_func->m_tasks.remove(rt.m_removeToken).wasRemoved)
-			self_release();
+		claim(rt);
 	}
 };
 
-
 }
 }
 }
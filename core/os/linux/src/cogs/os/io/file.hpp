@@ -0,0 +1,668 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_OS_IO_FILE
+#define COGS_HEADER_OS_IO_FILE
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "cogs/env.hpp"
+#include "cogs/collections/composite_string.hpp"
+#include "cogs/collections/vector.hpp"
+#include "cogs/function.hpp"
+#include "cogs/io/buffer.hpp"
+#include "cogs/io/composite_buffer.hpp"
+#include "cogs/io/segment_map.hpp"
+#include "cogs/mem/object.hpp"
+#include "cogs/mem/rcnew.hpp"
+#include "cogs/os/io/auto_fd.hpp"
+#include "cogs/os/io/uring_pool.hpp"
+#include "cogs/sync/dispatcher.hpp"
+#include "cogs/sync/singleton.hpp"
+#include "cogs/sync/thread_pool.hpp"
+
+
+#ifndef COGS_FILE_IO_POOL_THREAD_COUNT
+
+/// @brief The number of threads os::io::file_io_pool uses to perform blocking file I/O
+///
+/// Files use os::io::uring_pool if it is enabled and supported.  Otherwise, blocking file I/O
+/// is performed by a dedicated pool of threads, so dispatcher threads do not block on disk I/O.
+#define COGS_FILE_IO_POOL_THREAD_COUNT 4
+#endif
+
+#ifndef COGS_FILE_MAX_TRANSFER_SIZE
+
+/// @brief The maximum number of bytes os::io::file transfers in a single read or write operation
+///
+/// Larger segments are split into multiple operations, which may be performed in parallel.
+/// Must be a multiple of COGS_FILE_DIRECT_ALIGNMENT.
+#define COGS_FILE_MAX_TRANSFER_SIZE (1024 * 1024)
+#endif
+
+#ifndef COGS_FILE_DIRECT_ALIGNMENT
+
+/// @brief The alignment of offsets, lengths and buffers used with files opened with os::io::file::direct_option
+#define COGS_FILE_DIRECT_ALIGNMENT 4096
+#endif
+
+
+namespace cogs {
+namespace os {
+namespace io {
+
+
+/// @brief A pool of threads used to perform blocking file I/O, if io_uring is not used.
+class file_io_pool : public object
+{
+private:
+	thread_pool m_pool;
+
+protected:
+	file_io_pool()
+		: m_pool(true, COGS_FILE_IO_POOL_THREAD_COUNT)
+	{ }
+
+public:
+	static rcref<file_io_pool> get()
+	{
+		return singleton<file_io_pool>::get();
+	}
+
+	void dispatch(const function<void()>& d) { m_pool.dispatch(d); }
+};
+
+
+/// @brief A file, with asynchronous positional reads and writes.
+///
+/// Reads and writes are described by a segment_map or segment_buffer_map, so a single request may
+/// read or write multiple non-contiguous areas of the file.  Each segment is transferred using one or
+/// more operations of up to COGS_FILE_MAX_TRANSFER_SIZE bytes, which are performed in parallel.
+/// Operations are submitted to the os::io::uring_pool if enabled, or performed by the os::io::file_io_pool.
+class file : public object
+{
+public:
+	enum class access_mode
+	{
+		read = 1,
+		write = 2,
+		read_write = 3
+	};
+
+	/// @brief Options that can be combined and passed to file::open()
+	enum open_option
+	{
+		/// @brief Create the file if it does not exist.  Requires write access.
+		create_option = 0x01,
+
+		/// @brief Truncate the file to 0 bytes when opened.  Requires write access.
+		truncate_option = 0x02,
+
+		/// @brief Fail if create_option is specified and the file already exists
+		exclusive_option = 0x04,
+
+		/// @brief Bypass the page cache, using O_DIRECT.
+		///
+		/// Reads of unaligned segments are widened to COGS_FILE_DIRECT_ALIGNMENT, and buffers written are
+		/// copied if not aligned.  Offsets and lengths of writes must be multiples of COGS_FILE_DIRECT_ALIGNMENT.
+		direct_option = 0x08
+	};
+
+	static constexpr size_t direct_alignment = COGS_FILE_DIRECT_ALIGNMENT;
+	static constexpr size_t max_transfer_size = COGS_FILE_MAX_TRANSFER_SIZE;
+
+	static_assert((direct_alignment & (direct_alignment - 1)) == 0);
+	static_assert((max_transfer_size % direct_alignment) == 0);
+
+	class reader;
+	class writer;
+
+private:
+	auto_fd m_fd;
+	const bool m_direct;
+	const rcptr<uring_pool> m_uringPool;
+
+	file(int fd, bool direct)
+		: m_fd(fd),
+		m_direct(direct),
+		m_uringPool(uring_pool::get_default())
+	{ }
+
+	// Signals a task with 0 or an errno value, when a uring_pool operation completes
+	class result_operation : public uring_pool::operation
+	{
+	public:
+		const rcref<file> m_file; // Keeps the file open until the operation completes
+		const rcref<signallable_task<int> > m_task;
+
+		result_operation(const rcref<file>& f, const rcref<signallable_task<int> >& t)
+			: uring_pool::operation(function<void()>()),
+			m_file(f),
+			m_task(t)
+		{ }
+
+		virtual void run() { m_task->signal((m_result < 0) ? -m_result : 0); }
+	};
+
+	// Performs a blocking call on the file_io_pool.  f is passed the fd, and returns 0 or an errno value.
+	template <typename F>
+	rcref<task<int> > run_blocking(F&& f)
+	{
+		rcref<signallable_task<int> > t = rcnew(signallable_task<int>);
+		file_io_pool::get()->dispatch([r{ this_rcref }, t, f{ std::forward<F>(f) }]()
+		{
+			t->signal(f(r->m_fd.get()));
+		});
+		return t;
+	}
+
+	template <class derived_t>
+	class transfer : public signallable_task_base<derived_t>
+	{
+	protected:
+		class piece
+		{
+		public:
+			uint64_t m_offset;
+			cogs::io::composite_buffer m_data; // Buffer to read into, or data to write
+			size_t m_skip; // Leading bytes read only to satisfy alignment
+			size_t m_length; // Bytes requested, following m_skip
+			size_t m_transferred;
+			int m_error;
+			rcptr<uring_pool::operation> m_uringOp;
+
+			piece(uint64_t offset, const cogs::io::composite_buffer& data, size_t skip, size_t length)
+				: m_offset(offset),
+				m_data(data),
+				m_skip(skip),
+				m_length(length),
+				m_transferred(0),
+				m_error(0)
+			{ }
+		};
+
+		const rcref<file> m_file;
+		const bool m_isWrite;
+		vector<piece> m_pieces;
+		int m_error;
+		volatile size_t m_remainingPieces alignas(cogs::atomic::get_alignment_v<size_t>);
+		volatile int m_aborted alignas(cogs::atomic::get_alignment_v<int>);
+
+		transfer(const rcref<file>& f, bool isWrite)
+			: m_file(f),
+			m_isWrite(isWrite),
+			m_error(0),
+			m_remainingPieces(0),
+			m_aborted(0)
+		{ }
+
+		// Gets iovecs describing the untransferred portion of a piece.  Returns false if there is nothing left to transfer.
+		bool get_iovecs(const piece& p, vector<struct iovec>& iovecs) const
+		{
+			size_t total = p.m_data.get_length();
+			if (p.m_transferred >= total)
+				return false;
+			if (m_file->m_direct && ((p.m_transferred % direct_alignment) != 0))
+				return false; // Short transfer of a direct file.  Only occurs at the end of the file.
+			cogs::io::composite_buffer remaining(p.m_data, p.m_transferred);
+			size_t n = remaining.get_inner_count();
+			if (n > IOV_MAX)
+				n = IOV_MAX;
+			iovecs.resize(n);
+			struct iovec* v = iovecs.get_ptr();
+			for (size_t i = 0; i < n; i++)
+			{
+				const cogs::io::buffer& b = remaining.get_inner(i);
+				v[i].iov_base = const_cast<char*>(b.get_const_ptr());
+				v[i].iov_len = b.get_length();
+			}
+			return true;
+		}
+
+		void piece_done()
+		{
+			if (!pre_assign_prev(m_remainingPieces))
+			{
+				for (size_t i = 0; i < m_pieces.get_length(); i++)
+				{
+					if (!!m_pieces[i].m_error)
+					{
+						m_error = m_pieces[i].m_error;
+						break;
+					}
+				}
+				static_cast<derived_t*>(this)->complete();
+				this->signal();
+				this->self_release();
+			}
+		}
+
+		void run_piece(piece& p)
+		{
+			int fd = m_file->m_fd.get();
+			vector<struct iovec> iovecs;
+			while (!cogs::atomic::load(m_aborted) && get_iovecs(p, iovecs))
+			{
+				off_t offset = (off_t)(p.m_offset + p.m_transferred);
+				ssize_t i = m_isWrite
+					? pwritev(fd, iovecs.get_const_ptr(), (int)iovecs.get_length(), offset)
+					: preadv(fd, iovecs.get_const_ptr(), (int)iovecs.get_length(), offset);
+				if (i == -1)
+				{
+					if (errno == EINTR)
+						continue;
+					p.m_error = errno;
+					break;
+				}
+				if (i == 0) // End of file
+					break;
+				p.m_transferred += i;
+			}
+			piece_done();
+		}
+
+		void submit_piece(piece& p)
+		{
+			if (cogs::atomic::load(m_aborted) || !get_iovecs(p, p.m_uringOp->m_iovecs))
+			{
+				piece_done();
+				return;
+			}
+			uint64_t offset = p.m_offset + p.m_transferred;
+			if (m_isWrite)
+				m_file->m_uringPool->writev(m_file->m_fd.get(), offset, p.m_uringOp.dereference());
+			else
+				m_file->m_uringPool->readv(m_file->m_fd.get(), offset, p.m_uringOp.dereference());
+		}
+
+		void uring_piece_completed(piece& p)
+		{
+			int result = p.m_uringOp->m_result;
+			if (result < 0)
+			{
+				if ((result == -EINTR) || (result == -EAGAIN))
+				{
+					submit_piece(p);
+					return;
+				}
+				p.m_error = -result;
+			}
+			else if (result > 0)
+			{
+				p.m_transferred += result;
+				submit_piece(p);
+				return;
+			}
+			piece_done(); // result of 0 indicates end of file
+		}
+
+		void start()
+		{
+			size_t n = m_pieces.get_length();
+			if (!n)
+			{
+				static_cast<derived_t*>(this)->complete();
+				this->signal();
+				return;
+			}
+			this->self_acquire(); // Released when all pieces are done
+			m_remainingPieces = n;
+			piece* pieces = m_pieces.get_ptr();
+			rcptr<uring_pool> uringPool = m_file->m_uringPool;
+			if (!!uringPool)
+			{
+				for (size_t i = 0; i < n; i++)
+				{
+					piece* p = &pieces[i];
+					p->m_uringOp = rcnew(uring_pool::operation)([this, p]()
+					{
+						uring_piece_completed(*p);
+					});
+				}
+				for (size_t i = 0; i < n; i++)
+					submit_piece(pieces[i]);
+			}
+			else
+			{
+				rcref<file_io_pool> pool = file_io_pool::get();
+				for (size_t i = 0; i < n; i++)
+				{
+					piece* p = &pieces[i];
+					pool->dispatch([this, p]()
+					{
+						run_piece(*p);
+					});
+				}
+			}
+		}
+
+		void abort()
+		{
+			cogs::atomic::store(m_aborted, 1);
+			rcptr<uring_pool> uringPool = m_file->m_uringPool;
+			if (!!uringPool)
+			{
+				for (size_t i = 0; i < m_pieces.get_length(); i++)
+					uringPool->cancel(m_pieces[i].m_uringOp.dereference());
+			}
+		}
+
+		virtual const derived_t& get() const volatile { return *(const derived_t*)this; }
+
+	public:
+		const rcref<file>& get_file() const { return m_file; }
+
+		/// @brief Gets 0 if successful, or the errno value of the first error encountered
+		int get_error() const { return m_error; }
+
+		virtual rcref<task<bool> > cancel() volatile
+		{
+			auto t = signallable_task_base<derived_t>::cancel(); // will complete immediately
+			if (t->get())
+				((transfer*)this)->abort(); // Operations already started will complete.
+			return t;
+		}
+	};
+
+public:
+	/// @brief A task that reads one or more segments of a file
+	class reader : public transfer<reader>
+	{
+	private:
+		friend class file;
+		friend class transfer<reader>;
+
+		typedef typename transfer<reader>::piece piece;
+
+		const cogs::io::segment_map<> m_requested;
+		cogs::io::segment_buffer_map<> m_buffers;
+
+		reader(const rcref<file>& f, const cogs::io::segment_map<>& segments)
+			: transfer<reader>(f, false),
+			m_requested(segments)
+		{
+			size_t alignment = f->m_direct ? direct_alignment : 1;
+			for (auto i = segments.get_first(); !!i; ++i)
+			{
+				uint64_t start = i->key;
+				uint64_t end = i->key + i->value;
+				uint64_t alignedStart = start & ~(uint64_t)(alignment - 1);
+				uint64_t alignedEnd = (end + (alignment - 1)) & ~(uint64_t)(alignment - 1);
+				for (uint64_t pos = alignedStart; pos < alignedEnd; pos += max_transfer_size)
+				{
+					size_t n = ((alignedEnd - pos) > max_transfer_size) ? max_transfer_size : (size_t)(alignedEnd - pos);
+					size_t skip = (start > pos) ? (size_t)(start - pos) : 0;
+					size_t length = (size_t)(((end < pos + n) ? end : (pos + n)) - (pos + skip));
+					cogs::io::buffer b(n + alignment - 1);
+					size_t adjust = (alignment - ((size_t)b.get_const_ptr() & (alignment - 1))) & (alignment - 1);
+					this->m_pieces.append(1, piece(pos, cogs::io::composite_buffer(b.subrange(adjust, n)), skip, length));
+				}
+			}
+		}
+
+		void complete()
+		{
+			// Contiguous pieces of a segment are combined into one cogs::io::composite_buffer.
+			cogs::io::composite_buffer pending;
+			uint64_t pendingStart = 0;
+			for (size_t i = 0; i < this->m_pieces.get_length(); i++)
+			{
+				const piece& p = this->m_pieces[i];
+				uint64_t start = p.m_offset + p.m_skip;
+				if (!!pending.get_length() && (pendingStart + pending.get_length() != start))
+				{
+					m_buffers.write(pendingStart, pending);
+					pending.clear();
+				}
+				if (p.m_transferred <= p.m_skip)
+					continue;
+				size_t n = p.m_transferred - p.m_skip;
+				if (n > p.m_length)
+					n = p.m_length;
+				if (!pending.get_length())
+					pendingStart = start;
+				pending.append(cogs::io::composite_buffer(p.m_data, p.m_skip, n));
+				if (n < p.m_length) // Short read, at the end of the file
+				{
+					m_buffers.write(pendingStart, pending);
+					pending.clear();
+				}
+			}
+			if (!!pending.get_length())
+				m_buffers.write(pendingStart, pending);
+		}
+
+	public:
+		/// @brief Gets the segments requested to be read
+		const cogs::io::segment_map<>& get_requested() const { return m_requested; }
+
+		/// @brief Gets the data read.  Segments at or beyond the end of the file are truncated or absent.
+		const cogs::io::segment_buffer_map<>& get_buffers() const { return m_buffers; }
+
+		/// @brief Gets the contiguous data read starting at the first requested segment
+		cogs::io::composite_buffer get_buffer() const
+		{
+			auto i = m_requested.get_first();
+			return !i ? cogs::io::composite_buffer() : m_buffers.read(i->key, (size_t)i->value);
+		}
+
+		uint64_t get_read_size() const { return m_buffers.get_total_length(); }
+	};
+
+	/// @brief A task that writes one or more buffers to a file
+	class writer : public transfer<writer>
+	{
+	private:
+		friend class file;
+		friend class transfer<writer>;
+
+		typedef typename transfer<writer>::piece piece;
+
+		cogs::io::segment_map<> m_written;
+
+		static bool is_aligned(const cogs::io::composite_buffer& b)
+		{
+			for (size_t i = 0; i < b.get_inner_count(); i++)
+			{
+				const cogs::io::buffer& inner = b.get_inner(i);
+				if ((((size_t)inner.get_const_ptr() | inner.get_length()) & (direct_alignment - 1)) != 0)
+					return false;
+			}
+			return true;
+		}
+
+		static cogs::io::composite_buffer copy_aligned(const cogs::io::composite_buffer& b)
+		{
+			size_t n = b.get_length();
+			cogs::io::buffer storage(n + direct_alignment - 1);
+			size_t adjust = (direct_alignment - ((size_t)storage.get_const_ptr() & (direct_alignment - 1))) & (direct_alignment - 1);
+			cogs::io::buffer result = storage.subrange(adjust, n);
+			char* dst = const_cast<char*>(result.get_const_ptr());
+			for (size_t i = 0; i < b.get_inner_count(); i++)
+			{
+				const cogs::io::buffer& inner = b.get_inner(i);
+				memcpy(dst, inner.get_const_ptr(), inner.get_length());
+				dst += inner.get_length();
+			}
+			return cogs::io::composite_buffer(result);
+		}
+
+		writer(const rcref<file>& f, const cogs::io::segment_buffer_map<>& buffers)
+			: transfer<writer>(f, true)
+		{
+			for (auto i = buffers.get_first(); !!i; ++i)
+			{
+				size_t length = i->value.get_length();
+				for (size_t pos = 0; pos < length; pos += max_transfer_size)
+				{
+					size_t n = ((length - pos) > max_transfer_size) ? max_transfer_size : (length - pos);
+					cogs::io::composite_buffer data(i->value, pos, n);
+					if (f->m_direct && !is_aligned(data))
+						data = copy_aligned(data);
+					this->m_pieces.append(1, piece(i->key + pos, data, 0, n));
+				}
+			}
+		}
+
+		void complete()
+		{
+			for (size_t i = 0; i < this->m_pieces.get_length(); i++)
+			{
+				const piece& p = this->m_pieces[i];
+				m_written.add(p.m_offset, p.m_transferred);
+			}
+		}
+
+	public:
+		/// @brief Gets the segments successfully written
+		const cogs::io::segment_map<>& get_written() const { return m_written; }
+
+		uint64_t get_write_size() const { return m_written.get_total_length(); }
+	};
+
+	/// @brief Opens a file
+	/// @param location Path of the file
+	/// @param mode Access mode.  Default: access_mode::read
+	/// @param options A combination of open_option values.  Default: 0
+	/// @param permissions Permissions of the file, if created.  Default: 0666, which is then masked by the umask
+	/// @return The opened file, or null on failure.  On failure, errno is set.
+	static rcptr<file> open(const cstring& location, access_mode mode = access_mode::read, int options = 0, mode_t permissions = 0666)
+	{
+		rcptr<file> result;
+		int flags = O_CLOEXEC;
+		if (mode == access_mode::read_write)
+			flags |= O_RDWR;
+		else if (mode == access_mode::write)
+			flags |= O_WRONLY;
+		else
+			flags |= O_RDONLY;
+		if ((options & create_option) != 0)
+			flags |= O_CREAT;
+		if ((options & truncate_option) != 0)
+			flags |= O_TRUNC;
+		if ((options & exclusive_option) != 0)
+			flags |= O_EXCL;
+		if ((options & direct_option) != 0)
+			flags |= O_DIRECT;
+		int fd;
+		do {
+			fd = ::open(location.cstr(), flags, permissions);
+		} while ((fd == -1) && (errno == EINTR));
+		if (fd != -1)
+			result = rcnew(file)(fd, (options & direct_option) != 0);
+		return result;
+	}
+
+	static rcptr<file> open(const composite_string& location, access_mode mode = access_mode::read, int options = 0, mode_t permissions = 0666)
+	{
+		return open(string_to_cstring(location), mode, options, permissions);
+	}
+
+	/// @brief Gets the file descriptor.  Valid as long as the file object is in scope.
+	int get_fd() const { return m_fd.get(); }
+
+	bool is_direct() const { return m_direct; }
+
+	/// @brief Gets the current size of the file
+	uint64_t get_size() const
+	{
+		struct stat st;
+		if (fstat(m_fd.get(), &st) == -1)
+			return 0;
+		return (uint64_t)st.st_size;
+	}
+
+	/// @brief Reads segments of the file
+	rcref<reader> read(const cogs::io::segment_map<>& segments)
+	{
+		rcref<reader> r = rcnew(reader)(this_rcref, segments);
+		r->start();
+		return r;
+	}
+
+	/// @brief Reads a segment of the file.  Use reader::get_buffer() to retrieve the data.
+	rcref<reader> read(uint64_t offset, size_t n) { return read(cogs::io::segment_map<>(offset, n)); }
+
+	/// @brief Writes buffers to the file
+	rcref<writer> write(const cogs::io::segment_buffer_map<>& buffers)
+	{
+		rcref<writer> w = rcnew(writer)(this_rcref, buffers);
+		w->start();
+		return w;
+	}
+
+	/// @brief Writes a buffer to the file
+	rcref<writer> write(uint64_t offset, const cogs::io::composite_buffer& b)
+	{
+		cogs::io::segment_buffer_map<> buffers;
+		buffers.write(offset, b);
+		return write(buffers);
+	}
+
+	/// @brief Sets the size of the file, truncating or extending it
+	/// @return A task that completes with 0, or an errno value
+	rcref<task<int> > set_size(uint64_t n)
+	{
+		return run_blocking([n](int fd)
+		{
+			return (ftruncate(fd, (off_t)n) == -1) ? errno : 0;
+		});
+	}
+
+	/// @brief Allocates storage for a range of the file, using fallocate()
+	/// @param offset Start of the range
+	/// @param n Length of the range
+	/// @param keepSize If true, the file size is not changed if the range extends beyond the end of the file
+	/// @return A task that completes with 0, or an errno value
+	rcref<task<int> > allocate(uint64_t offset, uint64_t n, bool keepSize = false)
+	{
+		int allocateMode = keepSize ? FALLOC_FL_KEEP_SIZE : 0;
+		if (!!m_uringPool)
+		{
+			rcref<signallable_task<int> > t = rcnew(signallable_task<int>);
+			m_uringPool->fallocate(m_fd.get(), allocateMode, offset, n, rcnew(result_operation)(this_rcref, t));
+			return t;
+		}
+		return run_blocking([allocateMode, offset, n](int fd)
+		{
+			return (fallocate(fd, allocateMode, (off_t)offset, (off_t)n) == -1) ? errno : 0;
+		});
+	}
+
+	/// @brief Flushes written data to storage
+	/// @param dataOnly If true, uses fdatasync(), which does not flush metadata not needed to read the data.  Default: true
+	/// @return A task that completes with 0, or an errno value
+	rcref<task<int> > flush(bool dataOnly = true)
+	{
+		if (!!m_uringPool)
+		{
+			rcref<signallable_task<int> > t = rcnew(signallable_task<int>);
+			m_uringPool->fsync(m_fd.get(), dataOnly, rcnew(result_operation)(this_rcref, t));
+			return t;
+		}
+		return run_blocking([dataOnly](int fd)
+		{
+			return ((dataOnly ? fdatasync(fd) : fsync(fd)) == -1) ? errno : 0;
+		});
+	}
+};
+
+
+}
+}
+}
+
+
+#endif
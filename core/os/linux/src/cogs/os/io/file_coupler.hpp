@@ -0,0 +1,246 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_OS_IO_FILE_COUPLER
+#define COGS_HEADER_OS_IO_FILE_COUPLER
+
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "cogs/collections/container_queue.hpp"
+#include "cogs/io/buffer.hpp"
+#include "cogs/io/datasink.hpp"
+#include "cogs/mem/rcnew.hpp"
+#include "cogs/os/io/net/ip/tcp.hpp"
+#include "cogs/sync/dispatcher.hpp"
+
+
+namespace cogs {
+namespace os {
+namespace io {
+
+
+/// @brief Couples a range of a file to a datasink.
+///
+/// If the datasink is an io::net::ip::tcp, the range is transmitted within the kernel using tcp::transmit_file(),
+/// without copying file data through user-space buffers.  Otherwise, or if the file does not support it,
+/// the range is read into buffers of bufferBlockSize and written to the datasink.
+class file_coupler : public signallable_task_base<void>
+{
+private:
+	const weak_rcptr<cogs::io::datasink> m_sink;
+	const int m_fd;
+	uint64_t m_offset;
+	uint64_t m_remaining;
+	const bool m_closeSinkOnSourceClose;
+	const size_t m_bufferBlockSize;
+
+	rcptr<cogs::io::net::ip::tcp::file_transmitter> m_currentTransmitter;
+	rcptr<cogs::io::datasink::writer> m_currentWriter;
+	size_t m_transmitSize = 0;
+	bool m_decoupling = false;
+
+	typedef bool (file_coupler::*task_f)();
+
+	volatile container_queue<task_f> m_completionSerializer;
+
+	void process(task_f t)
+	{
+		if (m_completionSerializer.append(t))
+		{
+			size_t releaseCount = 0;
+			for (;;)
+			{
+				if ((this->*t)())
+					++releaseCount;
+				if (m_completionSerializer.remove().wasEmptied)
+					break;
+				m_completionSerializer.peek(t);
+			}
+			get_desc()->release(reference_strength::strong, releaseCount);
+		}
+	}
+
+	// Returns true, to release the reference held while coupled.
+	bool finish(bool sourceDone)
+	{
+		if (sourceDone && m_closeSinkOnSourceClose)
+		{
+			rcptr<cogs::io::datasink> snk = m_sink;
+			if (!!snk)
+				snk->close_sink();
+		}
+		m_currentTransmitter.release();
+		m_currentWriter.release();
+		signal();
+		return true;
+	}
+
+	bool transmit(const rcref<cogs::io::net::ip::tcp>& t)
+	{
+		m_transmitSize = (m_remaining > (size_t)-1) ? (size_t)-1 : (size_t)m_remaining;
+		m_currentTransmitter = t->transmit_file(m_fd, m_offset, m_transmitSize);
+		m_currentTransmitter->dispatch([this]()
+		{
+			process(&file_coupler::process_transmit);
+		});
+		return false;
+	}
+
+	bool process_transmit()
+	{
+		size_t n = m_currentTransmitter->get_transmitted_size();
+		m_offset = m_currentTransmitter->get_offset();
+		m_remaining -= n;
+		if (m_decoupling)
+			return finish(false);
+		if (m_currentTransmitter->was_unsupported())
+		{
+			m_currentTransmitter.release();
+			return write_next();
+		}
+		if (m_currentTransmitter->was_closed())
+			return finish(false);
+		if (!!m_remaining && (n == m_transmitSize)) // More than fits in a size_t was requested
+		{
+			rcptr<cogs::io::datasink> snk = m_sink;
+			if (!!snk)
+				return transmit(snk.template static_cast_to<cogs::io::net::ip::tcp>().dereference());
+		}
+		return finish(true);
+	}
+
+	// Buffered path, used if the datasink is not a tcp connection, or if the file does not support sendfile()/splice().
+	bool write_next()
+	{
+		rcptr<cogs::io::datasink> snk = m_sink;
+		if (!snk)
+			return finish(false);
+		if (!m_remaining)
+			return finish(true);
+		size_t n = (m_remaining > m_bufferBlockSize) ? m_bufferBlockSize : (size_t)m_remaining;
+		cogs::io::buffer b(n);
+		ssize_t i;
+		do {
+			i = pread(m_fd, b.get_ptr(), n, (off_t)m_offset);
+		} while ((i == -1) && (errno == EINTR));
+		if (i <= 0) // End of file, or the file could not be read
+			return finish(true);
+		b.truncate_to(i);
+		m_offset += i;
+		m_remaining -= i;
+		m_currentWriter = snk->write(b);
+		m_currentWriter->dispatch([this]()
+		{
+			process(&file_coupler::process_write);
+		});
+		return false;
+	}
+
+	bool process_write()
+	{
+		if (m_decoupling || m_currentWriter->was_closed())
+			return finish(false);
+		m_currentWriter.release();
+		return write_next();
+	}
+
+	bool process_decouple()
+	{
+		m_decoupling = true;
+		if (!!m_currentTransmitter)
+			m_currentTransmitter->abort();
+		if (!!m_currentWriter)
+			m_currentWriter->abort();
+		return true;
+	}
+
+	void decouple()
+	{
+		self_acquire(); // Ensure we don't go out of scope if decoupling() arrives at an inopportune time.
+		process(&file_coupler::process_decouple);
+	}
+
+	bool process_start()
+	{
+		rcptr<cogs::io::datasink> snk = m_sink;
+		if (!snk)
+			return finish(false);
+		rcptr<cogs::io::net::ip::tcp> t = snk.template dynamic_cast_to<cogs::io::net::ip::tcp>();
+		if (!!t)
+			return transmit(t.dereference());
+		return write_next();
+	}
+
+public:
+	/// @brief Constructor.  Call start() to begin coupling.
+	/// @param fd A file descriptor of a file.  It must remain open until the coupler completes.
+	/// @param offset The offset in the file to start reading from
+	/// @param length The number of bytes to couple.  Fewer are coupled if the end of the file is reached.
+	/// @param snk The datasink to couple to.  Scope is not extended by the coupler.
+	/// @param closeSinkOnSourceClose If true, the datasink will be closed after the range of the file has been written.  Default: false
+	/// @param bufferBlockSize The size of buffers used if the range cannot be transmitted within the kernel.  Default: COGS_DEFAULT_BLOCK_SIZE
+	file_coupler(
+		int fd,
+		uint64_t offset,
+		uint64_t length,
+		const rcref<cogs::io::datasink>& snk,
+		bool closeSinkOnSourceClose = false,
+		size_t bufferBlockSize = COGS_DEFAULT_BLOCK_SIZE)
+		: m_sink(snk),
+		m_fd(fd),
+		m_offset(offset),
+		m_remaining(length),
+		m_closeSinkOnSourceClose(closeSinkOnSourceClose),
+		m_bufferBlockSize((bufferBlockSize == 0) ? COGS_DEFAULT_BLOCK_SIZE : bufferBlockSize)
+	{ }
+
+	void start()
+	{
+		self_acquire();
+		process(&file_coupler::process_start);
+	}
+
+	virtual rcref<task<bool> > cancel() volatile
+	{
+		auto t = signallable_task_base<void>::cancel();
+		if (t->get())
+			((file_coupler*)this)->decouple(); // we manage thread safety, so cast away volatility
+		return t;
+	}
+};
+
+
+/// @brief Couples a range of a file to a datasink, using sendfile()/splice() if the datasink is a tcp connection.
+/// @param fd A file descriptor of a file.  It must remain open until the coupler completes.
+/// @param offset The offset in the file to start reading from
+/// @param length The number of bytes to couple.  Fewer are coupled if the end of the file is reached.
+/// @param snk The datasink to couple to.  Scope is not extended by the coupler.
+/// @param closeSinkOnSourceClose If true, the datasink will be closed after the range of the file has been written.  Default: false
+/// @param bufferBlockSize The size of buffers used if the range cannot be transmitted within the kernel.  Default: COGS_DEFAULT_BLOCK_SIZE
+/// @return A reference to a task that completes when the range has been written, or the datasink closes.
+inline rcref<task<void> > couple_file(
+	int fd,
+	uint64_t offset,
+	uint64_t length,
+	const rcref<cogs::io::datasink>& snk,
+	bool closeSinkOnSourceClose = false,
+	size_t bufferBlockSize = COGS_DEFAULT_BLOCK_SIZE)
+{
+	rcref<file_coupler> result = rcnew(file_coupler)(fd, offset, length, snk, closeSinkOnSourceClose, bufferBlockSize);
+	result->start();
+	return result;
+}
+
+
+}
+}
+}
+
+
+#endif
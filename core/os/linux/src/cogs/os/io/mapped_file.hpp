@@ -0,0 +1,246 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_OS_IO_MAPPED_FILE
+#define COGS_HEADER_OS_IO_MAPPED_FILE
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cogs/env.hpp"
+#include "cogs/collections/composite_string.hpp"
+#include "cogs/collections/vector.hpp"
+#include "cogs/io/buffer.hpp"
+#include "cogs/io/composite_buffer.hpp"
+#include "cogs/math/const_max_int.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/mem/object.hpp"
+#include "cogs/mem/rcnew.hpp"
+#include "cogs/os/io/auto_fd.hpp"
+
+
+#ifndef COGS_MAPPED_FILE_SEGMENT_SIZE
+
+/// @brief The default maximum size of each inner buffer of a composite_buffer returned by os::io::mapped_file
+#define COGS_MAPPED_FILE_SEGMENT_SIZE (1024 * 1024)
+#endif
+
+
+namespace cogs {
+namespace os {
+namespace io {
+
+
+/// @brief A private memory mapping of a file.
+///
+/// Data is handed out as io::buffer's and io::composite_buffer's referring directly to the mapping, without copying.
+/// Each buffer holds a reference to the mapping, which is unmapped when the mapped_file and all buffers referring to it
+/// have been released.  The mapping is private, so writes through a buffer are not written to the file, and are
+/// visible to other buffers referring to the same range, as with any shared io::buffer storage.
+/// Operations that would resize a buffer copy its contents out of the mapping.
+class mapped_file : public object
+{
+public:
+	/// @brief Access pattern hints, passed to madvise()
+	enum class advice
+	{
+		normal = MADV_NORMAL,
+		sequential = MADV_SEQUENTIAL,
+		random = MADV_RANDOM,
+		will_need = MADV_WILLNEED,
+		dont_need = MADV_DONTNEED
+	};
+
+private:
+	// The vector_descriptor of buffers referring to the mapping.  Unmaps when the last strong reference is released.
+	class descriptor : public vector_descriptor<char>
+	{
+	private:
+		void* m_base;
+		size_t m_mappedLength;
+
+		virtual void released()
+		{
+			munmap(m_base, m_mappedLength);
+			release(reference_strength::weak); // Acquired in constructor
+		}
+
+		virtual bool contains(void* obj) const
+		{
+			const unsigned char* p = (const unsigned char*)obj;
+			return (p >= (const unsigned char*)m_base) && (p < (const unsigned char*)m_base + m_mappedLength);
+		}
+
+	public:
+		descriptor(void* base, size_t mappedLength)
+			: vector_descriptor<char>(0),
+			m_base(base),
+			m_mappedLength(mappedLength)
+		{
+			// An additional weak reference ensures the descriptor is never considered owned by a single buffer,
+			// so buffers never attempt to grow into or reallocate the mapping.
+			acquire(reference_strength::weak);
+		}
+
+		virtual void dispose()
+		{
+			default_memory_manager::destruct_deallocate_type(this);
+		}
+
+		void* get_base_address() const { return m_base; }
+		size_t get_mapped_length() const { return m_mappedLength; }
+	};
+
+	// Provides access to buffer::set(), to construct a buffer referring to the mapping
+	class mapped_buffer : public cogs::io::buffer
+	{
+	public:
+		mapped_buffer(descriptor* d, char* p, size_t n)
+		{
+			d->acquire();
+			set(d, p, n);
+		}
+	};
+
+	descriptor* m_desc;
+	char* m_ptr;
+	size_t m_length;
+
+	mapped_file(descriptor* d, char* p, size_t n)
+		: m_desc(d),
+		m_ptr(p),
+		m_length(n)
+	{ }
+
+	void clamp(size_t& offset, size_t& n) const
+	{
+		if (offset > m_length)
+			offset = m_length;
+		size_t remaining = m_length - offset;
+		if (n > remaining)
+			n = remaining;
+	}
+
+public:
+	~mapped_file()
+	{
+		if (!!m_desc)
+			m_desc->release();
+	}
+
+	/// @brief Maps a range of an open file.  The fd may be closed once mapped.
+	/// @param fd A file descriptor of a file opened for reading
+	/// @param offset The offset in the file at which to start the mapping.  Default: 0
+	/// @param n The number of bytes to map.  Truncated to the end of the file.  Default: the remainder of the file
+	/// @return The mapped_file, or null on failure.  On failure, errno is set.
+	static rcptr<mapped_file> map(int fd, uint64_t offset = 0, size_t n = const_max_int_v<size_t>)
+	{
+		rcptr<mapped_file> result;
+		struct stat st;
+		if (fstat(fd, &st) == -1)
+			return result;
+		uint64_t fileSize = (uint64_t)st.st_size;
+		if (offset > fileSize)
+			offset = fileSize;
+		if (n > fileSize - offset)
+			n = (size_t)(fileSize - offset);
+		if (!n)
+		{
+			result = rcnew(mapped_file)(nullptr, nullptr, 0);
+			return result;
+		}
+		size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		uint64_t mapOffset = offset & ~(uint64_t)(pageSize - 1);
+		size_t skip = (size_t)(offset - mapOffset);
+		size_t mappedLength = n + skip;
+		void* base = mmap(0, mappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)mapOffset);
+		if (base == MAP_FAILED)
+			return result;
+		descriptor* d = default_memory_manager::allocate_type<descriptor>();
+		new (d) descriptor(base, mappedLength);
+		result = rcnew(mapped_file)(d, (char*)base + skip, n);
+		return result;
+	}
+
+	/// @brief Opens and maps a file
+	/// @param location Path of the file
+	/// @return The mapped_file, or null on failure.  On failure, errno is set.
+	static rcptr<mapped_file> open(const cstring& location)
+	{
+		rcptr<mapped_file> result;
+		auto_fd fd;
+		do {
+			fd = ::open(location.cstr(), O_RDONLY | O_CLOEXEC);
+		} while ((fd.get() == -1) && (errno == EINTR));
+		if (fd.get() != -1)
+			result = map(fd.get());
+		return result;
+	}
+
+	static rcptr<mapped_file> open(const composite_string& location) { return open(string_to_cstring(location)); }
+
+	size_t get_length() const { return m_length; }
+
+	const char* get_const_ptr() const { return m_ptr; }
+
+	/// @brief Gets a buffer referring to a range of the mapping
+	cogs::io::buffer get_buffer(size_t offset = 0, size_t n = const_max_int_v<size_t>) const
+	{
+		clamp(offset, n);
+		if (!n)
+			return cogs::io::buffer();
+		return mapped_buffer(m_desc, m_ptr + offset, n);
+	}
+
+	/// @brief Gets a composite_buffer referring to a range of the mapping.
+	///
+	/// The range is divided into inner buffers of up to segmentSize bytes, so a consumer processing one
+	/// inner buffer at a time (i.e. crypto::hash::update()) touches the mapping incrementally.
+	/// @param offset Offset into the mapping.  Default: 0
+	/// @param n Number of bytes.  Default: the remainder of the mapping
+	/// @param segmentSize The maximum size of each inner buffer.  Default: COGS_MAPPED_FILE_SEGMENT_SIZE
+	cogs::io::composite_buffer get_composite_buffer(size_t offset = 0, size_t n = const_max_int_v<size_t>, size_t segmentSize = COGS_MAPPED_FILE_SEGMENT_SIZE) const
+	{
+		cogs::io::composite_buffer result;
+		clamp(offset, n);
+		if (!segmentSize)
+			segmentSize = n;
+		while (!!n)
+		{
+			size_t segmentLength = (n > segmentSize) ? segmentSize : n;
+			result.append(mapped_buffer(m_desc, m_ptr + offset, segmentLength));
+			offset += segmentLength;
+			n -= segmentLength;
+		}
+		return result;
+	}
+
+	/// @brief Advises the kernel of the expected access pattern of a range of the mapping
+	/// @return True if successful
+	bool advise(advice a, size_t offset = 0, size_t n = const_max_int_v<size_t>) const
+	{
+		clamp(offset, n);
+		if (!n)
+			return true;
+		size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		char* start = m_ptr + offset;
+		char* alignedStart = (char*)((size_t)start & ~(pageSize - 1));
+		return madvise(alignedStart, n + (start - alignedStart), (int)a) == 0;
+	}
+};
+
+
+}
+}
+}
+
+
+#endif
@@ -10,6 +10,7 @@
 
 
 #include "cogs/os/io/epoll_pool.hpp"
+#include "cogs/os/io/uring_pool.hpp"
 #include "cogs/os/io/net/ip/endpoint.hpp"
 
 
@@ -23,6 +24,7 @@ class socket : public object
 {
 private:
 	rcref<os::io::epoll_pool> m_epollPool;
+	rcptr<os::io::uring_pool> m_uringPool; // If set, I/O is issued through io_uring instead of epoll_pool
 	address_family m_addressFamily;
 	endpoint m_localEndpoint;
 	endpoint m_remoteEndpoint;
@@ -31,13 +33,10 @@ private:
 	// We dup() the socket so we can register reads and writes independently in epoll_pool.
 	auto_fd m_dupReadFd;
 
-public:
-	socket(int type, int protocol, address_family addressFamily = address_family::inetv4, const rcref<os::io::epoll_pool>& epp = os::io::epoll_pool::get())
-		: m_fd(::socket((int)addressFamily, type, protocol)),
-		m_epollPool(epp),
-		m_addressFamily(addressFamily)
+	void init()
 	{
-		if (!!m_fd)
+		// io_uring sockets are left blocking, so the kernel polls for readiness internally instead of returning -EAGAIN.
+		if (!!m_fd && !m_uringPool)
 		{
 			int i = fcntl(m_fd.get(), F_SETFL, O_NONBLOCK);
 			if (i == -1)
@@ -47,19 +46,23 @@ public:
 		}
 	}
 
+public:
+	socket(int type, int protocol, address_family addressFamily = address_family::inetv4, const rcref<os::io::epoll_pool>& epp = os::io::epoll_pool::get())
+		: m_fd(::socket((int)addressFamily, type, protocol)),
+		m_epollPool(epp),
+		m_uringPool(os::io::uring_pool::get_default()),
+		m_addressFamily(addressFamily)
+	{
+		init();
+	}
+
 	socket(int sckt, int type, int protocol, address_family addressFamily = address_family::inetv4, const rcref<os::io::epoll_pool>& epp = os::io::epoll_pool::get())
 		: m_fd(sckt),
 		m_epollPool(epp),
+		m_uringPool(os::io::uring_pool::get_default()),
 		m_addressFamily(addressFamily)
 	{
-		if (!!m_fd)
-		{
-			int i = fcntl(m_fd.get(), F_SETFL, O_NONBLOCK);
-			if (i == -1)
-				m_fd.release();
-			else
-				m_epollPool->register_fd(m_fd.get());
-		}
+		init();
 	}
 
 	endpoint& get_local_endpoint() { return m_localEndpoint; }
@@ -84,7 +87,7 @@ public:
 		int result = m_dupReadFd.get();
 		if (result == -1)
 		{
-			if (!!m_fd)
+			if (!!m_fd && !m_uringPool) // Not needed with io_uring
 			{
 				result = m_dupReadFd.get() = dup(m_fd.get());
 				if (result != -1)
@@ -172,6 +175,11 @@ public:
 	{
 		return *m_epollPool;
 	}
+
+	const rcptr<os::io::uring_pool>& get_uring_pool() const
+	{
+		return m_uringPool;
+	}
 };
 
 
@@ -9,8 +9,14 @@
 #define COGS_HEADER_OS_IO_NET_IP_TCP
 
 
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/sendfile.h>
+
 #include "cogs/io/datastream.hpp"
 #include "cogs/io/net/connection.hpp"
+#include "cogs/io/receive_buffer_pool.hpp"
+#include "cogs/os/io/auto_fd.hpp"
 #include "cogs/os/io/net/ip/socket.hpp"
 #include "cogs/sync/thread_pool.hpp"
 
@@ -31,12 +37,13 @@ private:
 	private:
 		const weak_rcptr<tcp> m_tcp;
 		const rcref<socket> m_socket;
-		buffer m_currentBuffer;
+		const rcref<receive_buffer_pool> m_receiveBufferPool;
 		size_t m_progress = 0;
 		size_t m_adjustedRequestedSize;
 		bool m_aborted = false;
 		bool m_complete = false;
 		os::io::epoll_pool::remove_token m_waiterRemoveToken;
+		rcptr<os::io::uring_pool::operation> m_uringOp;
 
 		enum class task_type
 		{
@@ -46,16 +53,26 @@ private:
 
 		volatile container_queue<task_type> m_completionSerializer;
 
-		bool immediate_read(int s, size_t n) // for now just returns false on failure, to trigger generic socket close.  More error handling later.
+		// Receives whatever is available into pooled slabs, keeping only the bytes received.
+		// For now just returns false on failure, to trigger generic socket close.  More error handling later.
+		bool immediate_read(int s)
 		{
-			int i = recv(s, (char*)(m_currentBuffer.get_ptr()) + m_progress, (int)n, 0);
-			if (i == -1)
+			while (m_progress < m_adjustedRequestedSize)
 			{
-				if (errno == EAGAIN)
-					return true;
-				return false;
+				size_t n = m_adjustedRequestedSize - m_progress;
+				receive_buffer_pool::slab slab(*m_receiveBufferPool, n);
+				if (n > slab.get_size())
+					n = slab.get_size();
+				ssize_t i = recv(s, slab.get_ptr(), n, MSG_DONTWAIT);
+				if (i == -1)
+					return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+				if (i == 0) // closed
+					return false;
+				get_buffer().append(slab.copy(i));
+				m_progress += i;
+				if (((size_t)i < n) || (get_read_mode() == read_mode::some)) // Nothing more available now
+					break;
 			}
-			m_progress += i;
 			return true;
 		}
 
@@ -63,7 +80,8 @@ private:
 		tcp_reader(const rcref<datasource>& proxy, const rcref<tcp>& t)
 			: reader(proxy),
 			m_tcp(t),
-			m_socket(t->m_socket)
+			m_socket(t->m_socket),
+			m_receiveBufferPool(receive_buffer_pool::get())
 		{
 			m_socket->get_dup_read_fd();
 		}
@@ -74,7 +92,6 @@ private:
 		virtual void reading()
 		{
 			m_adjustedRequestedSize = get_unread_size();
-			m_currentBuffer = allocate_buffer(m_adjustedRequestedSize);
 			read_more();
 		}
 
@@ -82,39 +99,45 @@ private:
 
 		virtual void aborting() { read_more_or_abort(task_type::abort); }
 
-		// Some socket implementations (Winsock, being one, not sure about sockets with epoll)
-		// may incur significant overhead just checking how many bytes of data are available,
-		// so it's more efficient to issue an arbitrary size read, and see how much is retrieved.
-		// We go ahead and allocate a single buffer the size of the request, which is most efficient
-		// if all data is available now, and only inefficient due to RAM use otherwise.  IO buffers
-		// are usually very short-lived.
+		// Rather than allocating a buffer the size of the request and holding it while waiting
+		// for data to arrive, we wait until the socket is readable, then receive into pooled slabs.
 		void read_inner()
 		{
-			if (!!m_tcp && !!immediate_read(m_socket->get_dup(), m_adjustedRequestedSize - m_progress))
+			const rcptr<os::io::uring_pool>& uringPool = m_socket->get_uring_pool();
+			int fd = !uringPool ? m_socket->get_dup() : m_socket->get();
+			m_uringOp.release();
+			if (!!m_tcp && !!immediate_read(fd))
 			{
 				if ((m_progress != m_adjustedRequestedSize) && ((get_read_mode() != read_mode::some) || !m_progress) && (get_read_mode() != read_mode::now))
 				{
-					m_waiterRemoveToken = m_socket->get_pool().wait_readable(m_socket->get_dup(), [r{ this_weak_rcptr }]()
+					if (!!uringPool)
 					{
-						rcptr<tcp_reader> r2 = r;
-						if (!!r2)
-							r2->read_more();
-					});
+						m_uringOp = rcnew(os::io::uring_pool::operation)([r{ this_weak_rcptr }]()
+						{
+							rcptr<tcp_reader> r2 = r;
+							if (!!r2)
+								r2->read_more();
+						});
+						uringPool->poll(fd, POLLIN, m_uringOp.dereference());
+					}
+					else
+					{
+						m_waiterRemoveToken = m_socket->get_pool().wait_readable(fd, [r{ this_weak_rcptr }]()
+						{
+							rcptr<tcp_reader> r2 = r;
+							if (!!r2)
+								r2->read_more();
+						});
+					}
 				}
 				else
 				{
-					m_currentBuffer.truncate_to(m_progress);
-					get_buffer().append(m_currentBuffer);
-					m_currentBuffer.release();
 					m_complete = true;
 					complete();
 				}
 			}
 			else
 			{
-				m_currentBuffer.truncate_to(m_progress);
-				get_buffer().append(m_currentBuffer);
-				m_currentBuffer.release();
 				m_complete = true;
 				complete(true); // closes the read channel
 			}
@@ -136,7 +159,10 @@ private:
 						if (!m_complete)
 						{
 							m_aborted = true;
-							m_socket->get_pool().abort_waiter(m_waiterRemoveToken);
+							if (!!m_uringOp)
+								m_socket->get_uring_pool()->cancel(m_uringOp.dereference());
+							else
+								m_socket->get_pool().abort_waiter(m_waiterRemoveToken);
 							complete();
 						}
 					}
@@ -157,11 +183,15 @@ private:
 		bool m_aborted = false;
 		bool m_complete = false;
 		os::io::epoll_pool::remove_token m_waiterRemoveToken;
+		rcptr<os::io::uring_pool::operation> m_uringOp;
+		int m_uringResult;
+		vector<struct iovec> m_iovecs;
 
 		enum class task_type
 		{
 			write = 0,
-			abort = 1
+			abort = 1,
+			write_done = 2 // io_uring only
 		};
 
 		volatile container_queue<task_type> m_completionSerializer;
@@ -189,12 +219,20 @@ private:
 						if (!m_aborted)
 							write_inner();
 					}
+					else if (taskType == task_type::write_done)
+					{
+						if (!m_aborted)
+							uring_write_done();
+					}
 					else // if (taskType == task_type::abort)
 					{
 						if (!m_complete)
 						{
 							m_aborted = true;
-							m_socket->get_pool().abort_waiter(m_waiterRemoveToken);
+							if (!!m_uringOp)
+								m_socket->get_uring_pool()->cancel(m_uringOp.dereference());
+							else
+								m_socket->get_pool().abort_waiter(m_waiterRemoveToken);
 							complete();
 						}
 					}
@@ -205,6 +243,23 @@ private:
 			}
 		}
 
+		// Gathers up to IOV_MAX of the buffers in a composite_buffer, to be written with a single call.
+		static size_t gather(const composite_buffer& compositeBuffer, vector<struct iovec>& iovecs)
+		{
+			size_t bufferCount = compositeBuffer.get_inner_count();
+			if (bufferCount > IOV_MAX) // Any remaining buffers are sent by a subsequent call
+				bufferCount = IOV_MAX;
+			iovecs.resize(bufferCount);
+			struct iovec* iov = iovecs.get_ptr();
+			for (size_t bufIndex = 0; bufIndex < bufferCount; bufIndex++)
+			{
+				buffer b = compositeBuffer.get_inner(bufIndex);
+				iov[bufIndex].iov_base = (void*)(b.get_const_ptr());
+				iov[bufIndex].iov_len = b.get_length();
+			}
+			return bufferCount;
+		}
+
 		void write_inner()
 		{
 			if (!m_tcp)
@@ -212,6 +267,8 @@ private:
 				m_complete = true;
 				complete(true);
 			}
+			else if (!!m_socket->get_uring_pool())
+				uring_write();
 			else
 			{
 				for (;;)
@@ -223,27 +280,23 @@ private:
 					}
 					else
 					{
-						buffer b = get_buffer().get_inner(0);
-						size_t sent = send(m_socket->get(), (uint8_t*)(b.get_const_ptr()), b.get_length(), 0);
-						if (sent == b.get_length()) // complete buffer, write again immediately
-						{
-							get_buffer().advance_array();
-							continue;
-						}
+						// Send as many of the buffers as possible with a single call
+						struct msghdr msg;
+						memset(&msg, 0, sizeof(msg));
+						msg.msg_iovlen = gather(get_buffer(), m_iovecs);
+						msg.msg_iov = m_iovecs.get_ptr();
+						ssize_t sent = sendmsg(m_socket->get(), &msg, 0);
 						if (sent > 0)
 						{
 							get_buffer().advance(sent);
 							continue; // Go ahead and try a write again immediately.  Maybe the underlying layer is breaking it up, but is ready now.
 						}
-						else
+						COGS_ASSERT(sent == -1); // Don't think we'll ever get an actual zero here.
+						if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
 						{
-							COGS_ASSERT(sent == -1); // Don't think we'll ever get an actual zero here.
-							if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
-							{
-								m_complete = true;
-								complete(true);
-								break;
-							}
+							m_complete = true;
+							complete(true);
+							break;
 						}
 						m_waiterRemoveToken = m_socket->get_pool().wait_writable(m_socket->get(), [r{ this_weak_rcptr }]()
 						{
@@ -256,6 +309,47 @@ private:
 				}
 			}
 		}
+
+		void uring_write()
+		{
+			if (!get_buffer().get_length())
+			{
+				m_complete = true;
+				complete();
+				return;
+			}
+			// The operation retains the buffers, in case the writer is released while the write is in progress.
+			composite_buffer& compositeBuffer = get_buffer();
+			m_uringOp = rcnew(os::io::uring_pool::operation)([r{ this_weak_rcptr }, b{ compositeBuffer }]()
+			{
+				rcptr<tcp_writer> r2 = r;
+				if (!!r2)
+				{
+					r2->m_uringResult = r2->m_uringOp->m_result;
+					r2->write_more_or_abort(task_type::write_done);
+				}
+			});
+			gather(compositeBuffer, m_uringOp->m_iovecs);
+			m_socket->get_uring_pool()->sendmsg(m_socket->get(), m_uringOp.dereference());
+		}
+
+		void uring_write_done()
+		{
+			m_uringOp.release();
+			int i = m_uringResult;
+			if (i > 0)
+			{
+				get_buffer().advance(i);
+				uring_write();
+			}
+			else if ((i == -EAGAIN) || (i == -EINTR))
+				uring_write();
+			else
+			{
+				m_complete = true;
+				complete(true);
+			}
+		}
 	};
 
 	virtual rcref<reader> create_reader(const rcref<datasource>& proxy)
@@ -287,6 +381,7 @@ public:
 	protected:
 		rcref<os::io::epoll_pool> m_epollPool;
 		os::io::epoll_pool::remove_token m_waiterRemoveToken;
+		rcptr<os::io::uring_pool::operation> m_uringOp;
 		rcptr<tcp> m_tcp;
 		vector<address> m_addresses;
 		unsigned short m_remotePort;
@@ -334,6 +429,19 @@ public:
 					break;
 				}
 
+				const rcptr<os::io::uring_pool>& uringPool = m_tcp->m_socket->get_uring_pool();
+				if (!!uringPool)
+				{
+					m_uringOp = rcnew(os::io::uring_pool::operation)([r{ this_weak_rcptr }]()
+					{
+						rcptr<connecter> r2 = r;
+						if (!!r2)
+							r2->complete();
+					});
+					uringPool->connect(m_tcp->m_socket->get(), (sockaddr*)&sa, addr.get_sockaddr_size(), m_uringOp.dereference());
+					break;
+				}
+
 				i = ::connect(m_tcp->m_socket->get(), (sockaddr*)&sa, addr.get_sockaddr_size());
 				if (i == 0) // immediately connected??
 				{
@@ -368,9 +476,17 @@ public:
 						if (!m_aborted)
 						{
 							int errnum;
-							socklen_t len = sizeof(errnum);
-							int i = getsockopt(m_tcp->m_socket->get(), SOL_SOCKET, SO_ERROR, &errnum, &len);
-							COGS_ASSERT(i != -1);
+							if (!!m_uringOp)
+							{
+								errnum = -(m_uringOp->m_result);
+								m_uringOp.release();
+							}
+							else
+							{
+								socklen_t len = sizeof(errnum);
+								int i = getsockopt(m_tcp->m_socket->get(), SOL_SOCKET, SO_ERROR, &errnum, &len);
+								COGS_ASSERT(i != -1);
+							}
 							if (errnum == 0) //connected
 							{
 								m_tcp->m_socket->read_endpoints();
@@ -389,7 +505,10 @@ public:
 						if (!m_aborted)
 						{
 							m_aborted = true;
-							m_epollPool->abort_waiter(m_waiterRemoveToken);
+							if (!!m_uringOp)
+								m_tcp->m_socket->get_uring_pool()->cancel(m_uringOp.dereference());
+							else
+								m_epollPool->abort_waiter(m_waiterRemoveToken);
 							m_tcp.release(); // failure to connect is indicated by complete connecter with null tcp object
 							signal();
 							self_release();
@@ -412,6 +531,7 @@ public:
 			m_addresses(addresses),
 			m_remotePort(port)
 		{
+			self_acquire(); // Released when complete
 			connect();
 		}
 
@@ -420,6 +540,7 @@ public:
 			m_remotePort(port)
 		{
 			m_addresses.append(1, addr);
+			self_acquire(); // Released when complete
 			connect();
 		}
 
@@ -451,6 +572,257 @@ public:
 	virtual void abort_source() { datasource::abort_source(); m_socket->close_source(); }
 	virtual void abort_sink() { datasink::abort_sink(); m_socket->close_sink(); }
 
+	/// @brief A datasink task that transmits a range of a file to the connection, within the kernel.
+	///
+	/// With epoll, the range is sent with sendfile().  With io_uring, it's spliced through a pipe.
+	/// In either case, file data is not copied through user-space buffers.
+	class file_transmitter : public datasink_task<file_transmitter>
+	{
+	private:
+		friend class tcp;
+
+		// Largest count the kernel will transfer in a single call
+		static constexpr size_t max_transfer_size = 0x7ffff000;
+
+		const weak_rcptr<tcp> m_tcp;
+		const rcref<socket> m_socket;
+		const int m_fd;
+		off_t m_offset;
+		size_t m_remaining;
+		size_t m_transmitted = 0;
+		bool m_unsupported = false;
+		bool m_aborted = false;
+		bool m_complete = false;
+		os::io::epoll_pool::remove_token m_waiterRemoveToken;
+
+		// io_uring only
+		rcptr<os::io::uring_pool::operation> m_uringOp;
+		int m_uringResult;
+		auto_fd m_pipeRead;
+		auto_fd m_pipeWrite;
+		size_t m_pipeSize = 0;
+		size_t m_piped = 0;
+		bool m_splicingOut = false;
+
+		// Pending tasks are recorded as flags, along with a flag indicating a thread is processing them.
+		// Only one of each task can be outstanding at a time, so there is no need to queue them.
+		enum task_flags
+		{
+			transmit_task = 0x01,
+			splice_done_task = 0x02, // io_uring only
+			abort_task = 0x04,
+			processing_flag = 0x08
+		};
+
+		volatile int m_taskFlags alignas(atomic::get_alignment_v<int>) = 0;
+
+		file_transmitter(const rcref<tcp>& t, int fd, uint64_t offset, size_t length)
+			: datasink_task<file_transmitter>(t),
+			m_tcp(t),
+			m_socket(t->m_socket),
+			m_fd(fd),
+			m_offset((off_t)offset),
+			m_remaining(length)
+		{ }
+
+		virtual void executing() { process(transmit_task); }
+
+		virtual void aborting() { process(abort_task); }
+
+		void transmit_more() { process(transmit_task); }
+
+		void process(int taskFlag)
+		{
+			int oldFlags = atomic::load(m_taskFlags);
+			while (!atomic::compare_exchange(m_taskFlags, oldFlags | taskFlag | processing_flag, oldFlags, oldFlags))
+				;
+			if ((oldFlags & processing_flag) != 0)
+				return; // The thread already processing will pick it up
+			for (;;)
+			{
+				int taskFlags = atomic::exchange(m_taskFlags, (int)processing_flag);
+				if (((taskFlags & transmit_task) != 0) && !m_aborted)
+					transmit_inner();
+				if (((taskFlags & splice_done_task) != 0) && !m_aborted)
+					uring_splice_done();
+				if (((taskFlags & abort_task) != 0) && !m_complete)
+				{
+					m_aborted = true;
+					if (!!m_uringOp)
+						m_socket->get_uring_pool()->cancel(m_uringOp.dereference());
+					else
+						m_socket->get_pool().abort_waiter(m_waiterRemoveToken);
+					complete();
+				}
+				if (atomic::compare_exchange(m_taskFlags, 0, (int)processing_flag))
+					break;
+			}
+		}
+
+		// If the file does not support sendfile() or splice(), nothing is transmitted.  The caller can fall
+		// back to a buffered copy.  The task completes without closing the datasink.
+		void fail(int errnum)
+		{
+			m_complete = true;
+			if (!m_transmitted && !m_piped && ((errnum == EINVAL) || (errnum == ENOSYS) || (errnum == EOPNOTSUPP)))
+			{
+				m_unsupported = true;
+				complete();
+			}
+			else
+				complete(true);
+		}
+
+		void transmit_inner()
+		{
+			if (!m_tcp)
+			{
+				m_complete = true;
+				complete(true);
+			}
+			else if (!!m_socket->get_uring_pool())
+				uring_transmit();
+			else
+			{
+				for (;;)
+				{
+					if (!m_remaining)
+					{
+						m_complete = true;
+						complete();
+						break;
+					}
+					size_t n = (m_remaining > max_transfer_size) ? max_transfer_size : m_remaining;
+					ssize_t sent = sendfile(m_socket->get(), m_fd, &m_offset, n);
+					if (sent > 0)
+					{
+						m_transmitted += sent;
+						m_remaining -= sent;
+						continue;
+					}
+					if (sent == 0) // End of file was reached before the requested length
+					{
+						m_complete = true;
+						complete();
+						break;
+					}
+					if (errno == EINTR)
+						continue;
+					if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+					{
+						fail(errno);
+						break;
+					}
+					m_waiterRemoveToken = m_socket->get_pool().wait_writable(m_socket->get(), [r{ this_weak_rcptr }]()
+					{
+						rcptr<file_transmitter> r2 = r;
+						if (!!r2)
+							r2->transmit_more();
+					});
+					break;
+				}
+			}
+		}
+
+		void uring_transmit()
+		{
+			if (!m_piped && !m_remaining)
+			{
+				m_complete = true;
+				complete();
+				return;
+			}
+			if (!m_pipeSize)
+			{
+				int fds[2];
+				if (pipe2(fds, O_CLOEXEC) == -1)
+				{
+					fail(errno);
+					return;
+				}
+				m_pipeRead = fds[0];
+				m_pipeWrite = fds[1];
+				int pipeSize = fcntl(fds[0], F_GETPIPE_SZ);
+				m_pipeSize = (pipeSize > 0) ? (size_t)pipeSize : PIPE_BUF;
+			}
+			m_uringOp = rcnew(os::io::uring_pool::operation)([r{ this_weak_rcptr }]()
+			{
+				rcptr<file_transmitter> r2 = r;
+				if (!!r2)
+				{
+					r2->m_uringResult = r2->m_uringOp->m_result;
+					r2->process(splice_done_task);
+				}
+			});
+			m_splicingOut = !!m_piped;
+			if (m_splicingOut)
+				m_socket->get_uring_pool()->splice(m_pipeRead.get(), -1, m_socket->get(), m_piped, m_uringOp.dereference());
+			else
+			{
+				size_t n = (m_remaining > m_pipeSize) ? m_pipeSize : m_remaining;
+				m_socket->get_uring_pool()->splice(m_fd, m_offset, m_pipeWrite.get(), n, m_uringOp.dereference());
+			}
+		}
+
+		void uring_splice_done()
+		{
+			m_uringOp.release();
+			int i = m_uringResult;
+			if (i > 0)
+			{
+				if (m_splicingOut)
+				{
+					m_piped -= i;
+					m_transmitted += i;
+				}
+				else
+				{
+					m_offset += i;
+					m_remaining -= i;
+					m_piped += i;
+				}
+				uring_transmit();
+			}
+			else if ((i == -EAGAIN) || (i == -EINTR))
+				uring_transmit();
+			else if ((i == 0) && !m_splicingOut && !m_piped) // End of file was reached before the requested length
+			{
+				m_complete = true;
+				complete();
+			}
+			else
+				fail(-i);
+		}
+
+	public:
+		/// @brief Gets the number of bytes transmitted.  Intended to be called after the file_transmitter completes.
+		size_t get_transmitted_size() const { return m_transmitted; }
+
+		/// @brief Gets the file offset following the last byte transmitted.  Intended to be called after the file_transmitter completes.
+		uint64_t get_offset() const { return (uint64_t)m_offset - m_piped; }
+
+		/// @brief Tests if the file could not be transmitted within the kernel.  Intended to be called after the file_transmitter completes.
+		///
+		/// If true, nothing was transmitted and the datasink remains open.  The file can be copied through buffers instead.
+		bool was_unsupported() const { return m_unsupported; }
+
+		virtual const file_transmitter& get() const volatile { return *(const file_transmitter*)this; }
+	};
+
+	/// @brief Transmits a range of a file to the connection, without copying it through user-space buffers.
+	///
+	/// The transmit is queued in order with writes to the connection.
+	/// @param fd A file descriptor of a file.  It must remain open until the file_transmitter completes.
+	/// @param offset The offset in the file to start transmitting from
+	/// @param length The number of bytes to transmit.  Fewer are transmitted if the end of the file is reached.
+	/// @return A rcref to a file_transmitter
+	rcref<file_transmitter> transmit_file(int fd, uint64_t offset, size_t length)
+	{
+		rcref<file_transmitter> t = rcnew(file_transmitter)(this_rcref, fd, offset, length);
+		sink_enqueue(t);
+		return t;
+	}
+
 	typedef function<void(const rcref<tcp>&)> accept_delegate_t;
 
 	class listener : public object
@@ -461,6 +833,7 @@ public:
 		public:
 			rcref<os::io::epoll_pool> m_epollPool;
 			os::io::epoll_pool::remove_token m_listenerRemoveToken;
+			rcptr<os::io::uring_pool::operation> m_uringOp;
 
 			weak_rcptr<listener> m_listener;
 			rcptr<tcp> m_listenSocket;
@@ -492,6 +865,11 @@ public:
 						int i = ::listen(m_listenSocket->m_socket->get(), SOMAXCONN);
 						if (i != -1)
 						{
+							if (!!m_listenSocket->m_socket->get_uring_pool())
+							{
+								uring_accept();
+								break;
+							}
 							m_listenerRemoveToken = m_epollPool->register_listener(m_listenSocket->m_socket->get(), [r{ this_weak_rcptr }]()
 							{
 								rcptr<accept_helper> r2 = r;
@@ -508,6 +886,39 @@ public:
 
 			void close() { close_or_accept_connection(task_type::close); }
 
+			void uring_accept()
+			{
+				m_uringOp = rcnew(os::io::uring_pool::operation)([r{ this_weak_rcptr }]()
+				{
+					rcptr<accept_helper> r2 = r;
+					if (!!r2)
+						r2->accept_connection();
+				});
+				m_listenSocket->m_socket->get_uring_pool()->accept(m_listenSocket->m_socket->get(), m_uringOp.dereference());
+			}
+
+			void uring_accept_done()
+			{
+				int s = m_uringOp->m_result;
+				m_uringOp.release();
+				if (s >= 0)
+				{
+					if (m_closed)
+					{
+						::close(s);
+						return;
+					}
+					rcref<tcp> ds = rcnew(tcp)(s, m_addressFamily, m_epollPool);
+					ds->m_socket->read_endpoints();
+					thread_pool::get_default_or_immediate()->dispatch([r{ this_rcref }, ds{ std::move(ds) }]()
+					{
+						r->m_acceptDelegate(ds);
+					});
+				}
+				if (!m_closed && !!m_listener)
+					uring_accept();
+			}
+
 			void accept_connection() { close_or_accept_connection(task_type::accept); }
 
 			void close_or_accept_connection(task_type taskType)
@@ -518,7 +929,9 @@ public:
 					{
 						if (taskType == task_type::accept)
 						{
-							if (!m_closed)
+							if (!!m_uringOp)
+								uring_accept_done();
+							else if (!m_closed)
 							{
 								rcptr<listener> l = m_listener;
 								for (;;)
@@ -550,7 +963,10 @@ public:
 						else // if (taskType == task_type::close)
 						{
 							m_closed = true;
-							m_epollPool->deregister_listener(m_listenerRemoveToken);
+							if (!m_uringOp)
+								m_epollPool->deregister_listener(m_listenerRemoveToken);
+							else if (!!m_listenSocket)
+								m_listenSocket->m_socket->get_uring_pool()->cancel(m_uringOp.dereference());
 							if (!!m_listenSocket)
 							{
 								m_listenSocket->close();
@@ -0,0 +1,656 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_IO_URING_POOL
+#define COGS_HEADER_IO_URING_POOL
+
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "cogs/env.hpp"
+#include "cogs/collections/vector.hpp"
+#include "cogs/function.hpp"
+#include "cogs/mem/object.hpp"
+#include "cogs/mem/rcnew.hpp"
+#include "cogs/sync/dispatcher.hpp"
+#include "cogs/sync/thread_pool.hpp"
+#include "cogs/sync/yield.hpp"
+
+
+#ifndef COGS_USE_IO_URING
+
+/// @brief Whether os::io::uring_pool is used by default for Linux sockets and files
+///
+/// If 0, sockets use os::io::epoll_pool, and files use os::io::file_io_pool, unless
+/// os::io::uring_pool::set_enabled(true) is called at startup, before any sockets or files are created.
+#define COGS_USE_IO_URING 0
+#endif
+
+#ifndef COGS_URING_POOL_QUEUE_DEPTH
+
+/// @brief The number of submission queue entries in the io_uring used by os::io::uring_pool
+#define COGS_URING_POOL_QUEUE_DEPTH 1024
+#endif
+
+#ifndef COGS_URING_POOL_BATCH_SIZE
+
+/// @brief The maximum number of completions os::io::uring_pool reaps at once from the completion queue
+#define COGS_URING_POOL_BATCH_SIZE 64
+#endif
+
+
+namespace cogs {
+namespace os {
+namespace io {
+
+
+inline volatile int g_uringPoolEnabled alignas(cogs::atomic::get_alignment_v<int>) = COGS_USE_IO_URING;
+
+
+/// @brief An io_uring based completion pool.  Counterpart of the Windows completion_port.
+///
+/// I/O operations are queued as submission queue entries, and submitted in batches.
+/// Each operation's delegate is invoked by a pool thread when its completion queue entry arrives.
+class uring_pool : public object
+{
+public:
+	class operation : public object
+	{
+	protected:
+		friend class uring_pool;
+
+		function<void()> m_delegate;
+
+		// Set when submitted
+		struct io_uring_sqe m_sqe;
+		operation* m_nextPending;
+
+	public:
+		/// @brief Result of the operation.  Number of bytes transferred, an accepted fd, or a negated errno value.
+		int m_result;
+
+		// Storage that must remain valid until the operation completes
+		struct msghdr m_msg;
+		vector<struct iovec> m_iovecs;
+		struct sockaddr_storage m_address;
+		socklen_t m_addressLength;
+
+		explicit operation(const function<void()>& d)
+			: m_delegate(d),
+			m_result(0),
+			m_addressLength(0)
+		{
+			clear();
+		}
+
+		void clear()
+		{
+			memset(&m_msg, 0, sizeof(m_msg));
+			m_result = 0;
+		}
+
+		virtual void run()
+		{
+			m_delegate();
+		}
+	};
+
+private:
+	// user_data of a request for a pool thread to exit.  Otherwise, user_data points to an operation.
+	static constexpr uint64_t shutdown_tag = 0;
+
+	class ring
+	{
+	public:
+		int m_fd;
+
+		void* m_sqRingPtr;
+		size_t m_sqRingSize;
+		void* m_cqRingPtr;
+		size_t m_cqRingSize;
+		struct io_uring_sqe* m_sqes;
+		size_t m_sqesSize;
+
+		volatile unsigned* m_sqHead;
+		volatile unsigned* m_sqTail;
+		unsigned m_sqMask;
+		unsigned m_sqEntries;
+		unsigned* m_sqArray;
+
+		volatile unsigned* m_cqHead;
+		volatile unsigned* m_cqTail;
+		unsigned m_cqMask;
+		struct io_uring_cqe* m_cqes;
+
+		// Only accessed by the thread currently draining the submission queue
+		unsigned m_sqLocalTail;
+
+		// Completions are claimed by advancing m_cqClaim, then released to the kernel in order by advancing m_cqHead.
+		volatile unsigned m_cqClaim alignas(cogs::atomic::get_alignment_v<unsigned>);
+
+		ring()
+			: m_fd(-1),
+			m_sqRingPtr(MAP_FAILED),
+			m_cqRingPtr(MAP_FAILED),
+			m_sqes((struct io_uring_sqe*)MAP_FAILED)
+		{
+			struct io_uring_params params;
+			memset(&params, 0, sizeof(params));
+			params.flags = IORING_SETUP_CQSIZE;
+			params.cq_entries = COGS_URING_POOL_QUEUE_DEPTH * 4;
+			m_fd = (int)syscall(__NR_io_uring_setup, (unsigned)COGS_URING_POOL_QUEUE_DEPTH, &params);
+			if (m_fd == -1)
+				return;
+
+			m_sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned));
+			m_cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(struct io_uring_cqe));
+			bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+			if (singleMmap && (m_cqRingSize > m_sqRingSize))
+				m_sqRingSize = m_cqRingSize;
+			m_sqRingPtr = mmap(0, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+			if (m_sqRingPtr == MAP_FAILED)
+			{
+				release();
+				return;
+			}
+			if (singleMmap)
+				m_cqRingPtr = m_sqRingPtr;
+			else
+			{
+				m_cqRingPtr = mmap(0, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+				if (m_cqRingPtr == MAP_FAILED)
+				{
+					release();
+					return;
+				}
+			}
+			m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+			m_sqes = (struct io_uring_sqe*)mmap(0, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+			if (m_sqes == MAP_FAILED)
+			{
+				release();
+				return;
+			}
+
+			unsigned char* sq = (unsigned char*)m_sqRingPtr;
+			m_sqHead = (volatile unsigned*)(sq + params.sq_off.head);
+			m_sqTail = (volatile unsigned*)(sq + params.sq_off.tail);
+			m_sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+			m_sqEntries = *(unsigned*)(sq + params.sq_off.ring_entries);
+			m_sqArray = (unsigned*)(sq + params.sq_off.array);
+			m_sqLocalTail = *m_sqTail;
+
+			unsigned char* cq = (unsigned char*)m_cqRingPtr;
+			m_cqHead = (volatile unsigned*)(cq + params.cq_off.head);
+			m_cqTail = (volatile unsigned*)(cq + params.cq_off.tail);
+			m_cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+			m_cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+			m_cqClaim = *m_cqHead;
+		}
+
+		~ring() { release(); }
+
+		void release()
+		{
+			if (m_sqes != MAP_FAILED)
+				munmap(m_sqes, m_sqesSize);
+			if ((m_cqRingPtr != MAP_FAILED) && (m_cqRingPtr != m_sqRingPtr))
+				munmap(m_cqRingPtr, m_cqRingSize);
+			if (m_sqRingPtr != MAP_FAILED)
+				munmap(m_sqRingPtr, m_sqRingSize);
+			m_sqes = (struct io_uring_sqe*)MAP_FAILED;
+			m_cqRingPtr = MAP_FAILED;
+			m_sqRingPtr = MAP_FAILED;
+			if (m_fd != -1)
+			{
+				::close(m_fd);
+				m_fd = -1;
+			}
+		}
+
+		bool is_valid() const { return m_sqes != MAP_FAILED; }
+
+		int enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+		{
+			return (int)syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, flags, nullptr, 0);
+		}
+
+		// Called only by the thread draining the submission queue.  Returns false if the submission queue is full.
+		bool try_push(const struct io_uring_sqe& sqe)
+		{
+			if ((m_sqLocalTail - cogs::atomic::load(*m_sqHead)) >= m_sqEntries)
+				return false;
+			unsigned index = m_sqLocalTail & m_sqMask;
+			m_sqes[index] = sqe;
+			m_sqArray[index] = index;
+			++m_sqLocalTail;
+			cogs::atomic::store(*m_sqTail, m_sqLocalTail);
+			return true;
+		}
+
+		void submit(unsigned n)
+		{
+			while (!!n)
+			{
+				int i = enter(n, 0, 0);
+				if (i > 0)
+				{
+					n -= ((unsigned)i > n) ? n : (unsigned)i;
+					continue;
+				}
+				if ((i == -1) && ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)))
+				{
+					if (errno != EINTR)
+						yield();
+					continue;
+				}
+				break; // Already submitted by another thread's io_uring_enter()
+			}
+		}
+
+		// Copies up to n completions into dst.  Safe to call from multiple threads.
+		unsigned reap(struct io_uring_cqe* dst, unsigned n)
+		{
+			for (;;)
+			{
+				unsigned claim = cogs::atomic::load(m_cqClaim);
+				unsigned tail = cogs::atomic::load(*m_cqTail);
+				unsigned available = tail - claim;
+				if (!available)
+					return 0;
+				if (available > n)
+					available = n;
+				for (unsigned i = 0; i < available; i++)
+					dst[i] = m_cqes[(claim + i) & m_cqMask];
+				unsigned newClaim = claim + available;
+				if (!cogs::atomic::compare_exchange(m_cqClaim, newClaim, claim))
+					continue; // Another thread claimed them.  What we copied may be stale.
+				while (cogs::atomic::load(*m_cqHead) != claim) // Release entries back to the kernel in order.
+					yield();
+				cogs::atomic::store(*m_cqHead, newClaim);
+				return available;
+			}
+		}
+	};
+
+	class task
+	{
+	public:
+		ring m_ring;
+
+		// Operations waiting to be submitted, as a lock-free LIFO list.  While a thread is submitting them,
+		// the list is terminated by draining_marker() rather than null, so other threads only add to it.
+		operation* volatile m_pending alignas(cogs::atomic::get_alignment_v<operation*>);
+
+		const size_t m_batchSize;
+
+		volatile size_type m_submitCallCount;
+		volatile size_type m_submitCount;
+		volatile size_type m_wakeupCount;
+		volatile size_type m_completionCount;
+
+		explicit task(size_t batchSize)
+			: m_pending(nullptr),
+			m_batchSize(batchSize),
+			m_submitCallCount(0),
+			m_submitCount(0),
+			m_wakeupCount(0),
+			m_completionCount(0)
+		{ }
+
+		operation* draining_marker() { return (operation*)&m_pending; }
+
+		void submit(operation* op)
+		{
+			operation* oldHead = cogs::atomic::load(m_pending);
+			for (;;)
+			{
+				op->m_nextPending = oldHead;
+				if (cogs::atomic::compare_exchange(m_pending, op, oldHead, oldHead))
+					break;
+			}
+			if (!!oldHead)
+				return; // Another thread is submitting, and will submit this operation along with its own.
+
+			// This thread submits pending operations.  Operations added by other threads while
+			// we are submitting are submitted along with ours, with a single io_uring_enter().
+			operation* marker = draining_marker();
+			operation* list = cogs::atomic::exchange(m_pending, marker);
+			for (;;)
+			{
+				// Reverse the list, to submit in the order added
+				operation* ordered = nullptr;
+				while ((list != nullptr) && (list != marker))
+				{
+					operation* next = list->m_nextPending;
+					list->m_nextPending = ordered;
+					ordered = list;
+					list = next;
+				}
+				unsigned n = 0;
+				while (!!ordered)
+				{
+					// Once pushed, the operation may complete and be released before we are done with this loop.
+					operation* next = ordered->m_nextPending;
+					bool isShutdown = (ordered->m_sqe.user_data == shutdown_tag);
+					while (!m_ring.try_push(ordered->m_sqe))
+					{
+						// Submission queue is full.  Submit what we have, and wait for the kernel to consume entries.
+						assign_next(m_submitCallCount);
+						assign_add(m_submitCount, n);
+						m_ring.submit(n);
+						n = 0;
+						yield();
+					}
+					if (isShutdown)
+						ordered->self_release(); // No completion will refer to it
+					++n;
+					ordered = next;
+				}
+				assign_next(m_submitCallCount);
+				assign_add(m_submitCount, n);
+				m_ring.submit(n);
+				if (cogs::atomic::compare_exchange(m_pending, (operation*)nullptr, marker))
+					break;
+				list = cogs::atomic::exchange(m_pending, marker);
+			}
+		}
+
+		void run()
+		{
+			size_t batchSize = m_batchSize;
+			vector<struct io_uring_cqe> cqes(batchSize);
+			struct io_uring_cqe* cqe = cqes.get_ptr();
+			size_t shutdownCount = 0;
+			while (!shutdownCount)
+			{
+				unsigned n = m_ring.reap(cqe, (unsigned)batchSize);
+				if (!n)
+				{
+					int i = m_ring.enter(0, 1, IORING_ENTER_GETEVENTS);
+					COGS_ASSERT((i != -1) || (errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY));
+					continue;
+				}
+				assign_next(m_wakeupCount);
+				assign_add(m_completionCount, n);
+				for (unsigned j = 0; j < n; j++)
+				{
+					if (cqe[j].user_data == shutdown_tag)
+					{
+						// Finish dispatching the rest of this batch before exiting.
+						++shutdownCount;
+						continue;
+					}
+					operation* op = (operation*)cqe[j].user_data;
+					op->m_result = cqe[j].res;
+					op->run();
+					op->self_release(); // Acquired in submit()
+				}
+			}
+			// If we reaped more than one shutdown request, pass the rest along to other threads.
+			while (--shutdownCount > 0)
+				post_shutdown();
+		}
+
+		void post_shutdown()
+		{
+			rcref<operation> op = rcnew(operation)(function<void()>());
+			memset(&(op->m_sqe), 0, sizeof(op->m_sqe));
+			op->m_sqe.opcode = IORING_OP_NOP;
+			op->m_sqe.user_data = shutdown_tag;
+			op->self_acquire(); // Released once submitted
+			submit(op.get_ptr());
+		}
+	};
+
+	thread_pool m_pool;
+	rcptr<task> m_func;
+
+	void start()
+	{
+		if (!m_func->m_ring.is_valid())
+			return;
+		m_pool.start();
+		m_pool.dispatch_parallel(m_pool.get_thread_count(), [r{ m_func.dereference() }]()
+		{
+			r->run();
+		});
+	}
+
+	void submit(const struct io_uring_sqe& sqe, const rcref<operation>& op)
+	{
+		op->m_sqe = sqe;
+		op->m_sqe.user_data = (uint64_t)op.get_ptr();
+		op->self_acquire(); // Released after the completion has been processed
+		m_func->submit(op.get_ptr());
+	}
+
+	static struct io_uring_sqe make_sqe(uint8_t opcode, int fd)
+	{
+		struct io_uring_sqe sqe;
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = opcode;
+		sqe.fd = fd;
+		return sqe;
+	}
+
+protected:
+	explicit uring_pool(size_t batchSize = COGS_URING_POOL_BATCH_SIZE)
+		: m_func(rcnew(task)(!batchSize ? 1 : batchSize))
+	{ }
+
+public:
+	~uring_pool()
+	{
+		if (m_func->m_ring.is_valid())
+		{
+			for (size_t n = m_pool.get_thread_count(); n != 0; n--)
+				m_func->post_shutdown();
+			m_pool.shutdown();
+			m_pool.join();
+		}
+	}
+
+	static rcref<uring_pool> get()
+	{
+		bool isNew;
+		rcref<uring_pool> result = singleton<uring_pool>::get(isNew);
+		if (isNew)
+			result->start();
+		return result;
+	}
+
+	/// @brief Selects whether sockets and files use the uring_pool.  Should be called at startup, before any sockets or files are created.
+	static void set_enabled(bool b) { cogs::atomic::store(g_uringPoolEnabled, b ? 1 : 0); }
+
+	static bool is_enabled() { return cogs::atomic::load(g_uringPoolEnabled) != 0; }
+
+	/// @brief Gets the uring_pool to be used by sockets and files.
+	/// @return The uring_pool, or null if not enabled or if io_uring is not supported by the kernel.
+	static rcptr<uring_pool> get_default()
+	{
+		rcptr<uring_pool> result;
+		if (is_enabled())
+		{
+			rcref<uring_pool> p = get();
+			if (p->is_valid())
+				result = p;
+		}
+		return result;
+	}
+
+	bool is_valid() const { return m_func->m_ring.is_valid(); }
+
+	/// @brief Counters describing submission and completion batching
+	struct stats
+	{
+		/// @brief Number of io_uring_enter() calls made to submit operations
+		size_t submitCallCount;
+
+		/// @brief Number of operations submitted
+		size_t submitCount;
+
+		/// @brief Number of times one or more completions were reaped
+		size_t wakeupCount;
+
+		/// @brief Number of completions reaped
+		size_t completionCount;
+
+		double get_submissions_per_call() const { return !submitCallCount ? 0.0 : ((double)submitCount / (double)submitCallCount); }
+		double get_completions_per_wakeup() const { return !wakeupCount ? 0.0 : ((double)completionCount / (double)wakeupCount); }
+	};
+
+	stats get_stats() const
+	{
+		stats result;
+		result.submitCallCount = load(m_func->m_submitCallCount).get_int();
+		result.submitCount = load(m_func->m_submitCount).get_int();
+		result.wakeupCount = load(m_func->m_wakeupCount).get_int();
+		result.completionCount = load(m_func->m_completionCount).get_int();
+		return result;
+	}
+
+	void recv(int fd, void* p, size_t n, const rcref<operation>& op, int flags = 0)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_RECV, fd);
+		sqe.addr = (uint64_t)p;
+		sqe.len = (uint32_t)n;
+		sqe.msg_flags = (uint32_t)flags;
+		submit(sqe, op);
+	}
+
+	void send(int fd, const void* p, size_t n, const rcref<operation>& op, int flags = MSG_NOSIGNAL)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_SEND, fd);
+		sqe.addr = (uint64_t)p;
+		sqe.len = (uint32_t)n;
+		sqe.msg_flags = (uint32_t)flags;
+		submit(sqe, op);
+	}
+
+	/// @brief Waits for an fd to become ready.  On completion, m_result is the mask of ready events.
+	void poll(int fd, unsigned int events, const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_POLL_ADD, fd);
+		sqe.poll32_events = events;
+		submit(sqe, op);
+	}
+
+	/// @brief Sends the buffers described by op->m_iovecs
+	void sendmsg(int fd, const rcref<operation>& op, int flags = MSG_NOSIGNAL)
+	{
+		op->m_msg.msg_iov = op->m_iovecs.get_ptr();
+		op->m_msg.msg_iovlen = op->m_iovecs.get_length();
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_SENDMSG, fd);
+		sqe.addr = (uint64_t)&(op->m_msg);
+		sqe.len = 1;
+		sqe.msg_flags = (uint32_t)flags;
+		submit(sqe, op);
+	}
+
+	/// @brief Moves up to n bytes from fdIn to fdOut within the kernel.  One of the fds must be a pipe.
+	/// @param offsetIn The offset to read from fdIn, or -1 if fdIn is a pipe or socket.
+	void splice(int fdIn, int64_t offsetIn, int fdOut, size_t n, const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_SPLICE, fdOut);
+		sqe.splice_fd_in = fdIn;
+		sqe.splice_off_in = (uint64_t)offsetIn;
+		sqe.off = (uint64_t)-1;
+		sqe.len = (uint32_t)n;
+		submit(sqe, op);
+	}
+
+	/// @brief Reads from a file at an offset, into the buffers described by op->m_iovecs
+	void readv(int fd, uint64_t offset, const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_READV, fd);
+		sqe.addr = (uint64_t)op->m_iovecs.get_ptr();
+		sqe.len = (uint32_t)op->m_iovecs.get_length();
+		sqe.off = offset;
+		submit(sqe, op);
+	}
+
+	/// @brief Writes the buffers described by op->m_iovecs to a file at an offset
+	void writev(int fd, uint64_t offset, const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_WRITEV, fd);
+		sqe.addr = (uint64_t)op->m_iovecs.get_ptr();
+		sqe.len = (uint32_t)op->m_iovecs.get_length();
+		sqe.off = offset;
+		submit(sqe, op);
+	}
+
+	/// @brief Flushes a file to storage.  If dataOnly is true, metadata not needed to read the data is not flushed.
+	void fsync(int fd, bool dataOnly, const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_FSYNC, fd);
+		sqe.fsync_flags = dataOnly ? IORING_FSYNC_DATASYNC : 0;
+		submit(sqe, op);
+	}
+
+	/// @brief Allocates storage for a range of a file.  mode is as passed to fallocate().
+	void fallocate(int fd, int mode, uint64_t offset, uint64_t n, const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_FALLOCATE, fd);
+		sqe.off = offset;
+		sqe.addr = n;
+		sqe.len = (uint32_t)mode;
+		submit(sqe, op);
+	}
+
+	/// @brief Accepts a connection.  On completion, m_result is the accepted fd, and m_address contains the remote address.
+	void accept(int fd, const rcref<operation>& op)
+	{
+		op->m_addressLength = sizeof(op->m_address);
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_ACCEPT, fd);
+		sqe.addr = (uint64_t)&(op->m_address);
+		sqe.addr2 = (uint64_t)&(op->m_addressLength);
+		submit(sqe, op);
+	}
+
+	void connect(int fd, const sockaddr* addr, socklen_t addrLength, const rcref<operation>& op)
+	{
+		COGS_ASSERT(addrLength <= sizeof(op->m_address));
+		memcpy(&(op->m_address), addr, addrLength);
+		op->m_addressLength = addrLength;
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_CONNECT, fd);
+		sqe.addr = (uint64_t)&(op->m_address);
+		sqe.off = addrLength;
+		submit(sqe, op);
+	}
+
+	/// @brief Requests cancellation of an operation.  If canceled, the operation completes with -ECANCELED.
+	///
+	/// The caller must hold a reference to op, so its address cannot be reused by another operation.
+	void cancel(const rcref<operation>& op)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_ASYNC_CANCEL, -1);
+		sqe.addr = (uint64_t)op.get_ptr();
+		submit(sqe, rcnew(operation)(function<void()>()));
+	}
+
+	void dispatch(const function<void()>& d)
+	{
+		struct io_uring_sqe sqe = make_sqe(IORING_OP_NOP, -1);
+		submit(sqe, rcnew(operation)(d));
+	}
+};
+
+
+}
+}
+}
+
+
+#endif
@@ -8,30 +8,181 @@
 #define COGS_HEADER_OS_MEM_ALLOCATOR
 
 
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
 #include "cogs/env/mem/alignment.hpp"
 #include "cogs/mem/memory_manager_base.hpp"
 #include "cogs/os.hpp"
 
 
+#ifndef COGS_MMAP_THRESHOLD
+
+/// @brief Blocks of at least this many bytes are allocated using mmap(), and can be resized in place.
+///
+/// If 0, all blocks are allocated using the C runtime heap.
+#define COGS_MMAP_THRESHOLD (1024 * 256)
+#endif
+
+
+#ifndef COGS_MMAP_RESERVE_FACTOR
+
+/// @brief Address space is reserved for blocks allocated using mmap(), at this multiple of their size.
+///
+/// A block can be grown in place, by committing pages of its reserved address space.
+#define COGS_MMAP_RESERVE_FACTOR ((sizeof(void*) >= 8) ? 4 : 1)
+#endif
+
+
 namespace cogs {
 namespace os {
 
 
 class memory_manager : public memory_manager_base<memory_manager>
 {
+private:
+	// Immediately precedes a block allocated using mmap().  The mapping starts at the page containing the header.
+	// m_length is the committed length of the mapping, and m_reserved the length of address space reserved for it.
+	// The cookie identifies a mapped block.  Blocks from the C runtime heap are preceded by the heap's own
+	// bookkeeping, in which the cookie does not occur, as it depends on the block address and a constant.
+	// Only m_length and m_cookie are read before a block has been identified as mapped.
+	class mapped_header
+	{
+	public:
+		size_t m_reserved;
+		size_t m_length;
+		size_t m_cookie;
+	};
+
+	static constexpr size_t mapped_cookie = (size_t)0x6D6D61705F626C6BULL;
+
+	static size_t get_page_size()
+	{
+		static size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+		return pageSize;
+	}
+
+	static size_t get_cookie(void* p, size_t length) { return mapped_cookie ^ (size_t)p ^ length; }
+
+	static mapped_header* get_mapped_header(void* p)
+	{
+		if (!COGS_MMAP_THRESHOLD || !p || !!((size_t)p & (sizeof(size_t) - 1)))
+			return nullptr;
+		mapped_header* hdr = (mapped_header*)p - 1;
+		if (hdr->m_cookie != get_cookie(p, hdr->m_length))
+			return nullptr;
+		return hdr;
+	}
+
+	// If the block is page aligned, the header is at the end of the first page of the mapping
+	static unsigned char* get_mapping(void* p)
+	{
+		size_t pageSize = get_page_size();
+		unsigned char* base = (unsigned char*)((size_t)p & ~(pageSize - 1));
+		if (base == (unsigned char*)p)
+			base -= pageSize;
+		return base;
+	}
+
+	static size_t round_to_pages(size_t n)
+	{
+		size_t pageSize = get_page_size();
+		return (n + (pageSize - 1)) & ~(pageSize - 1);
+	}
+
 public:
 	static void* allocate(size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr)
 	{
+		if (COGS_MMAP_THRESHOLD && (n >= COGS_MMAP_THRESHOLD) && (align <= get_page_size()))
+		{
+			size_t offset = (sizeof(mapped_header) + (align - 1)) & ~(align - 1);
+			size_t length = round_to_pages(n + offset);
+			size_t reserved = length;
+			if ((COGS_MMAP_RESERVE_FACTOR > 1) && (length <= ((size_t)-1 / COGS_MMAP_RESERVE_FACTOR)))
+				reserved = length * COGS_MMAP_RESERVE_FACTOR;
+
+			// Reserve address space without committing it, then commit the pages in use
+			void* base = mmap(nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (base != MAP_FAILED)
+			{
+				if (mprotect(base, length, PROT_READ | PROT_WRITE) == 0)
+				{
+					unsigned char* p = (unsigned char*)base + offset;
+					mapped_header* hdr = (mapped_header*)p - 1;
+					hdr->m_reserved = reserved;
+					hdr->m_length = length;
+					hdr->m_cookie = get_cookie(p, length);
+					if (usableSize)
+						*usableSize = length - offset;
+					return p;
+				}
+				munmap(base, reserved);
+			}
+		}
 		if (usableSize)
 			*usableSize = n;
 		void* buf;
-		int i = posix_memalign(&buf, align, n);
-		COGS_ASSERT(i == 0);
+		if (align <= cogs::largest_alignment)
+			buf = malloc(n);
+		else
+		{
+			int i = posix_memalign(&buf, align, n);
+			COGS_ASSERT(i == 0);
+		}
 		return buf;
 	}
 
-	static void deallocate(void* p) { free(p); }
-	static bool try_reallocate(void*, size_t, size_t = cogs::largest_alignment, size_t* = nullptr) { return false; }
+	static void deallocate(void* p)
+	{
+		mapped_header* hdr = get_mapped_header(p);
+		if (!hdr)
+			free(p);
+		else
+			munmap(get_mapping(p), hdr->m_reserved);
+	}
+
+	/// @brief Resizes a block in place.
+	///
+	/// Blocks allocated using mmap() are resized by committing or decommitting pages of their reserved address space.
+	static bool try_reallocate(void* p, size_t n, size_t = cogs::largest_alignment, size_t* usableSize = nullptr)
+	{
+		if (!p)
+			return false;
+		mapped_header* hdr = get_mapped_header(p);
+		if (!hdr)
+		{
+			// A heap block may already be large enough
+			size_t heapBlockSize = malloc_usable_size(p);
+			if (n > heapBlockSize)
+				return false;
+			if (usableSize)
+				*usableSize = heapBlockSize;
+			return true;
+		}
+		unsigned char* base = get_mapping(p);
+		size_t offset = (unsigned char*)p - base;
+		if (n > (hdr->m_reserved - offset))
+			return false;
+		size_t length = round_to_pages(n + offset);
+		size_t oldLength = hdr->m_length;
+		if (length > oldLength)
+		{
+			if (mprotect(base + oldLength, length - oldLength, PROT_READ | PROT_WRITE) != 0)
+				return false;
+		}
+		else if (length < oldLength)
+		{
+			// Release the pages, and return them to reserved address space
+			madvise(base + length, oldLength - length, MADV_DONTNEED);
+			mprotect(base + length, oldLength - length, PROT_NONE);
+		}
+		hdr->m_length = length;
+		hdr->m_cookie = get_cookie(p, length);
+		if (usableSize)
+			*usableSize = length - offset;
+		return true;
+	}
 };
 
 
@@ -0,0 +1,173 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_OS_SYNC_FUTEX_SEMAPHORE
+#define COGS_HEADER_OS_SYNC_FUTEX_SEMAPHORE
+
+
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#include "cogs/env.hpp"
+#include "cogs/operators.hpp"
+#include "cogs/os/sync/timeout.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/yield.hpp"
+
+
+#ifndef COGS_FUTEX_SPIN_COUNT
+
+/// @brief The number of times a futex_semaphore checks for an available resource before blocking.
+///
+/// Spinning is skipped on single-processor systems.
+#define COGS_FUTEX_SPIN_COUNT 100
+#endif
+
+
+/// @brief Defined if os::futex_semaphore is available
+#define COGS_OS_FUTEX_SEMAPHORE
+
+
+namespace cogs {
+namespace os {
+
+
+/// @brief A semaphore implemented using a futex.
+///
+/// Acquiring an available resource, and releasing a resource when no threads are blocked, do not make system calls.
+/// A thread that finds no resources available spins briefly before blocking.
+/// Unlike os::semaphore, a futex_semaphore need not be allocated with rcnew.
+class futex_semaphore
+{
+private:
+	int m_count alignas(cogs::atomic::get_alignment_v<int>); // The futex word
+	int m_waiters alignas(cogs::atomic::get_alignment_v<int>);
+	const int m_maxResources;
+
+	futex_semaphore(const futex_semaphore&) = delete;
+	futex_semaphore& operator=(const futex_semaphore&) = delete;
+
+	static long futex(volatile int* addr, int op, int val, const timespec* ts = nullptr, unsigned int bitset = 0)
+	{
+		return syscall(SYS_futex, (int*)addr, op, val, ts, nullptr, bitset);
+	}
+
+	static bool is_multiprocessor()
+	{
+		static const bool multiprocessor = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+		return multiprocessor;
+	}
+
+	volatile int& get_count() volatile { return m_count; }
+	volatile int& get_waiters() volatile { return m_waiters; }
+
+public:
+	/// @brief Constructor
+	/// @param n Initial number of resources
+	/// @param maxResources Maximum number of resources.  Releases beyond this are ignored.  0 indicates no maximum.
+	explicit futex_semaphore(size_t n = 0, size_t maxResources = 0)
+		: m_count((int)n),
+		m_waiters(0),
+		m_maxResources(((maxResources == 0) || (maxResources > INT_MAX)) ? INT_MAX : (int)maxResources)
+	{ }
+
+	/// @brief Acquires a resource, if one is available, without blocking
+	/// @return True if a resource was acquired
+	bool try_acquire() volatile
+	{
+		volatile int& count = get_count();
+		int oldCount = cogs::atomic::load(count);
+		while (oldCount > 0)
+		{
+			if (cogs::atomic::compare_exchange(count, oldCount - 1, oldCount, oldCount))
+				return true;
+		}
+		return false;
+	}
+
+	/// @brief Acquires a resource
+	/// @param timeout Timeout.  Default: infinite
+	/// @param spinCount Number of times to check for an available resource before blocking
+	/// @return True if a resource was acquired, false if the timeout expired
+	bool acquire(const timeout_t& timeout = timeout_t::infinite(), unsigned int spinCount = COGS_FUTEX_SPIN_COUNT) volatile
+	{
+		if (try_acquire())
+			return true;
+		if (!timeout)
+			return false;
+		if (is_multiprocessor())
+		{
+			for (unsigned int i = 0; i < spinCount; i++)
+			{
+				yield();
+				if ((cogs::atomic::load(get_count()) > 0) && try_acquire())
+					return true;
+			}
+		}
+
+		timespec ts;
+		const timespec* tsPtr = nullptr;
+		if (!timeout.is_infinite())
+		{
+			timeout.get_expiration(ts);
+			tsPtr = &ts;
+		}
+
+		// A releasing thread increments the count before checking for waiters, and a waiting thread increments
+		// the waiter count before checking the count, so a release cannot be missed.
+		volatile int& waiters = get_waiters();
+		assign_next(waiters);
+		bool result = true;
+		while (!try_acquire())
+		{
+			// timeout_t expirations are based on CLOCK_REALTIME
+			long i = futex(&get_count(), FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME, 0, tsPtr, FUTEX_BITSET_MATCH_ANY);
+			if ((i == -1) && (errno == ETIMEDOUT))
+			{
+				result = try_acquire();
+				break;
+			}
+		}
+		assign_prev(waiters);
+		return result;
+	}
+
+	/// @brief Releases resources, waking blocked threads if any
+	/// @param n Number of resources to release.  Default: 1
+	void release(size_t n = 1) volatile
+	{
+		if (!n)
+			return;
+		volatile int& count = get_count();
+		int oldCount = cogs::atomic::load(count);
+		int newCount;
+		do {
+			if (oldCount >= m_maxResources)
+				return;
+			newCount = ((size_t)(m_maxResources - oldCount) < n) ? m_maxResources : (oldCount + (int)n);
+		} while (!cogs::atomic::compare_exchange(count, newCount, oldCount, oldCount));
+
+		int waiters = cogs::atomic::load(get_waiters());
+		if (waiters > 0)
+		{
+			int added = newCount - oldCount;
+			futex(&count, FUTEX_WAKE_PRIVATE, (added < waiters) ? added : waiters);
+		}
+	}
+};
+
+
+}
+}
+
+
+#endif
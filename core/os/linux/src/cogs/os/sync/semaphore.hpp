@@ -0,0 +1,48 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_OS_SYNC_SEMAPHORE
+#define COGS_HEADER_OS_SYNC_SEMAPHORE
+
+
+#include "cogs/env.hpp"
+#include "cogs/os/sync/futex_semaphore.hpp"
+#include "cogs/os/sync/timeout.hpp"
+#include "cogs/mem/rc_container.hpp"
+
+
+namespace cogs {
+namespace os {
+
+
+// os::semaphore provides the basis for thread synchronization.
+
+// cogs synchronization objects (event, mutex) use os::semaphores to block threads.
+
+
+class semaphore : public object
+{
+private:
+	futex_semaphore m_semaphore;
+
+public:
+	bool acquire(const timeout_t& timeout = timeout_t::infinite())
+	{
+		return m_semaphore.acquire(timeout);
+	}
+
+	void release(size_t n)
+	{
+		m_semaphore.release(n);
+	}
+};
+
+
+}
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "cogs/mem/default_memory_manager.hpp"
 #include "cogs/os.hpp"
 #include "cogs/os/sync/timeout.hpp"
+#include "cogs/sync/processor_set.hpp"
 
 
 namespace cogs {
@@ -82,6 +83,50 @@ inline unsigned int get_processor_count()
 }
 
 
+// Only processors in the first processor group (the first 64 processors) are represented.
+
+inline unsigned int get_numa_node_count()
+{
+	ULONG highestNode;
+	if (!GetNumaHighestNodeNumber(&highestNode))
+		return 1;
+	return (unsigned int)highestNode + 1;
+}
+
+inline processor_set get_numa_node_processors(unsigned int node)
+{
+	processor_set result;
+	ULONGLONG mask;
+	if (node <= 0xFF && GetNumaNodeProcessorMask((UCHAR)node, &mask))
+	{
+		for (size_t i = 0; i < 64; i++)
+		{
+			if (!!(mask & ((ULONGLONG)1 << i)))
+				result.add(i);
+		}
+	}
+	else if (!node)
+		result.add_range(0, get_processor_count() - 1);
+	return result;
+}
+
+inline unsigned int get_current_numa_node()
+{
+	UCHAR node;
+	if (!GetNumaProcessorNode((UCHAR)GetCurrentProcessorNumber(), &node) || node == 0xFF)
+		return 0;
+	return node;
+}
+
+inline bool set_current_thread_affinity(const processor_set& processors)
+{
+	DWORD_PTR mask = (DWORD_PTR)processors.get_mask();
+	if (!mask)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+
 }
 }
 
@@ -134,6 +134,9 @@
 /// as well as
 /// @ref cogs::priority_dispatcher.
 ///
+/// @ref cogs::hash_table - An unordered container with O(1) insert, search and removal.  Based on a paper by Shalev and Shavit titled, "Split-Ordered Lists: Lock-Free Extensible Hash Tables".
+/// This is used to provide @ref cogs::hash_map and @ref cogs::hash_set.
+///
 /// @ref cogs::transactable - A transactional type wrapper.  Encapsulates a type and provides access to it using simple atomic read/write transactions.
 ///
 /// @ref cogs::freelist - A simple lock-free <a href="https://en.wikipedia.org/wiki/Free_list">free-list</a>.
@@ -157,7 +160,7 @@
 ///
 /// @ref Timers - cogs::timer, @ref cogs::resettable_timer, @ref cogs::pulse_timer, @ref cogs::refireable_timer, @ref cogs::single_fire_timer
 ///
-/// @ref cogs::mutex, @ref cogs::semaphore, @ref cogs::rwlock, @ref cogs::priority_queue
+/// @ref cogs::mutex, @ref cogs::semaphore, @ref cogs::rwlock, @ref cogs::reader_biased_rwlock, @ref cogs::priority_queue
 ///
 /// @ref cogs::thread, @ref cogs::thread_pool
 ///
@@ -244,6 +247,9 @@
 #include "cogs/operators.hpp"
 #include "cogs/collections/array_view.hpp"
 #include "cogs/collections/avltree.hpp"
+#include "cogs/collections/bplus_map.hpp"
+#include "cogs/collections/bplus_set.hpp"
+#include "cogs/collections/bplus_tree.hpp"
 #include "cogs/collections/btree_node.hpp"
 #include "cogs/collections/btree.hpp"
 #include "cogs/collections/composite_string.hpp"
@@ -253,10 +259,14 @@
 #include "cogs/collections/container_queue.hpp"
 #include "cogs/collections/container_skiplist.hpp"
 #include "cogs/collections/container_stack.hpp"
+#include "cogs/collections/default_hasher.hpp"
 #include "cogs/collections/dlink.hpp"
 #include "cogs/collections/dlist.hpp"
 #include "cogs/collections/backed_vector.hpp"
 #include "cogs/collections/function_list.hpp"
+#include "cogs/collections/hash_map.hpp"
+#include "cogs/collections/hash_set.hpp"
+#include "cogs/collections/hash_table.hpp"
 #include "cogs/collections/map.hpp"
 #include "cogs/collections/multimap.hpp"
 #include "cogs/collections/multiset.hpp"
@@ -272,6 +282,7 @@
 #include "cogs/collections/vector.hpp"
 #include "cogs/collections/vector_view.hpp"
 #include "cogs/collections/weak_rcptr_list.hpp"
+#include "cogs/collections/work_stealing_deque.hpp"
 #include "cogs/crypto/adler32.hpp"
 #include "cogs/crypto/cipher.hpp"
 #include "cogs/crypto/crc.hpp"
@@ -343,6 +354,7 @@
 #include "cogs/io/limiter.hpp"
 #include "cogs/io/permission.hpp"
 #include "cogs/io/queue.hpp"
+#include "cogs/io/segment_map.hpp"
 #include "cogs/io/net/address.hpp"
 #include "cogs/io/net/connection.hpp"
 #include "cogs/io/net/endpoint.hpp"
@@ -397,6 +409,7 @@
 #include "cogs/math/value_to_bits.hpp"
 #include "cogs/math/vec.hpp"
 #include "cogs/mem/allocator_base.hpp"
+#include "cogs/mem/arena_memory_manager.hpp"
 #include "cogs/mem/memory_manager_base.hpp"
 #include "cogs/mem/auto_handle.hpp"
 #include "cogs/mem/batch_allocator.hpp"
@@ -421,9 +434,12 @@
 #include "cogs/mem/is_reference_type.hpp"
 #include "cogs/mem/is_same_instance.hpp"
 #include "cogs/mem/is_static_castable.hpp"
+#include "cogs/mem/local_rcref.hpp"
+#include "cogs/mem/magazine_memory_manager.hpp"
 #include "cogs/mem/object.hpp"
 #include "cogs/mem/placement.hpp"
 #include "cogs/mem/placement_header.hpp"
+#include "cogs/mem/profiling_memory_manager.hpp"
 #include "cogs/mem/ptr.hpp"
 #include "cogs/mem/rcnew.hpp"
 #include "cogs/mem/rcptr.hpp"
@@ -433,6 +449,7 @@
 #include "cogs/mem/rc_obj.hpp"
 #include "cogs/mem/rc_obj_base.hpp"
 #include "cogs/mem/ref.hpp"
+#include "cogs/mem/slab_memory_manager.hpp"
 #include "cogs/mem/storage_union.hpp"
 #include "cogs/mem/unowned.hpp"
 #include "cogs/mem/weak_rcptr.hpp"
@@ -449,13 +466,17 @@
 #include "cogs/sync/default_atomic_operators.hpp"
 #include "cogs/sync/defer_guard.hpp"
 #include "cogs/sync/dispatcher.hpp"
+#include "cogs/sync/epoch.hpp"
 #include "cogs/sync/dispatch_parallel.hpp"
 #include "cogs/sync/event.hpp"
 #include "cogs/sync/hazard.hpp"
+#include "cogs/sync/numa_thread_pool.hpp"
 #include "cogs/sync/priority_dispatcher.hpp"
 #include "cogs/sync/priority_queue.hpp"
+#include "cogs/sync/processor_set.hpp"
 #include "cogs/sync/pulse_timer.hpp"
 #include "cogs/sync/quit_dispatcher.hpp"
+#include "cogs/sync/reader_biased_rwlock.hpp"
 #include "cogs/sync/refireable_timer.hpp"
 #include "cogs/sync/resettable_condition.hpp"
 #include "cogs/sync/resettable_timer.hpp"
@@ -0,0 +1,80 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_BPLUS_MAP
+#define COGS_HEADER_COLLECTION_BPLUS_MAP
+
+
+#include <utility>
+
+#include "cogs/collections/bplus_tree.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup Collections
+/// @brief A sorted O(log n) collection of values indexed by unique keys, stored in a B+tree.
+///
+/// Provides the same interface as nonvolatile_map.  Lookups and in-order traversal are more cache-efficient, but inserting
+/// or removing an element invalidates all iterators.
+/// @tparam key_t The key type
+/// @tparam value_t The value type
+/// @tparam comparator_t A static comparator class used to compare keys.  Default: default_comparator
+/// @tparam memory_manager_t A static memory manager used to allocate nodes.  Default: default_memory_manager
+/// @tparam node_size The approximate size of a node, in bytes.  Default: COGS_BPLUS_TREE_NODE_SIZE
+template <typename key_t, typename value_t, class comparator_t = default_comparator, class memory_manager_t = default_memory_manager, size_t node_size = COGS_BPLUS_TREE_NODE_SIZE>
+class bplus_map : public bplus_tree<key_t, value_t, comparator_t, memory_manager_t, node_size>
+{
+private:
+	typedef bplus_tree<key_t, value_t, comparator_t, memory_manager_t, node_size> base_t;
+	typedef bplus_map<key_t, value_t, comparator_t, memory_manager_t, node_size> this_t;
+
+public:
+	typedef typename base_t::iterator iterator;
+	typedef typename base_t::remove_token remove_token;
+	typedef typename base_t::insert_unique_result insert_unique_result;
+	typedef typename base_t::insert_replace_result insert_replace_result;
+
+	bplus_map() { }
+	bplus_map(this_t&& src) : base_t(std::move(src)) { }
+	bplus_map(const this_t& src) : base_t(src) { }
+
+	this_t& operator=(this_t&& src) { base_t::operator=(std::move(src)); return *this; }
+	this_t& operator=(const this_t& src) { base_t::operator=(src); return *this; }
+
+	insert_unique_result insert_unique(const key_t& k, const value_t& v) { return this->insert_unique_emplace(k, v); }
+	insert_unique_result insert_unique(key_t&& k, const value_t& v) { return this->insert_unique_emplace(std::move(k), v); }
+	insert_unique_result insert_unique(const key_t& k, value_t&& v) { return this->insert_unique_emplace(k, std::move(v)); }
+	insert_unique_result insert_unique(key_t&& k, value_t&& v) { return this->insert_unique_emplace(std::move(k), std::move(v)); }
+
+	insert_replace_result insert_replace(const key_t& k, const value_t& v) { return this->insert_replace_emplace(k, v); }
+	insert_replace_result insert_replace(key_t&& k, const value_t& v) { return this->insert_replace_emplace(std::move(k), v); }
+	insert_replace_result insert_replace(const key_t& k, value_t&& v) { return this->insert_replace_emplace(k, std::move(v)); }
+	insert_replace_result insert_replace(key_t&& k, value_t&& v) { return this->insert_replace_emplace(std::move(k), std::move(v)); }
+
+	void swap(this_t& wth) { base_t::swap(wth); }
+
+	this_t exchange(this_t&& src)
+	{
+		this_t tmp(std::move(src));
+		swap(tmp);
+		return tmp;
+	}
+
+	void exchange(this_t&& src, this_t& rtn)
+	{
+		rtn = std::move(src);
+		swap(rtn);
+	}
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,75 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_BPLUS_SET
+#define COGS_HEADER_COLLECTION_BPLUS_SET
+
+
+#include <utility>
+
+#include "cogs/collections/bplus_tree.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup Collections
+/// @brief A sorted O(log n) collection, stored in a B+tree.  Unique values are enforced.
+///
+/// Provides the same interface as nonvolatile_set.  Lookups and in-order traversal are more cache-efficient, but inserting
+/// or removing an element invalidates all iterators.
+/// @tparam T The type to contain
+/// @tparam comparator_t A static comparator class used to compare values.  Default: default_comparator
+/// @tparam memory_manager_t A static memory manager used to allocate nodes.  Default: default_memory_manager
+/// @tparam node_size The approximate size of a node, in bytes.  Default: COGS_BPLUS_TREE_NODE_SIZE
+template <typename T, class comparator_t = default_comparator, class memory_manager_t = default_memory_manager, size_t node_size = COGS_BPLUS_TREE_NODE_SIZE>
+class bplus_set : public bplus_tree<T, void, comparator_t, memory_manager_t, node_size>
+{
+private:
+	typedef bplus_tree<T, void, comparator_t, memory_manager_t, node_size> base_t;
+	typedef bplus_set<T, comparator_t, memory_manager_t, node_size> this_t;
+
+public:
+	typedef typename base_t::iterator iterator;
+	typedef typename base_t::remove_token remove_token;
+	typedef typename base_t::insert_unique_result insert_unique_result;
+	typedef typename base_t::insert_replace_result insert_replace_result;
+
+	bplus_set() { }
+	bplus_set(this_t&& src) : base_t(std::move(src)) { }
+	bplus_set(const this_t& src) : base_t(src) { }
+
+	this_t& operator=(this_t&& src) { base_t::operator=(std::move(src)); return *this; }
+	this_t& operator=(const this_t& src) { base_t::operator=(src); return *this; }
+
+	insert_unique_result insert_unique(const T& t) { return this->insert_unique_emplace(t); }
+	insert_unique_result insert_unique(T&& t) { return this->insert_unique_emplace(std::move(t)); }
+
+	insert_replace_result insert_replace(const T& t) { return this->insert_replace_emplace(t); }
+	insert_replace_result insert_replace(T&& t) { return this->insert_replace_emplace(std::move(t)); }
+
+	void swap(this_t& wth) { base_t::swap(wth); }
+
+	this_t exchange(this_t&& src)
+	{
+		this_t tmp(std::move(src));
+		swap(tmp);
+		return tmp;
+	}
+
+	void exchange(this_t&& src, this_t& rtn)
+	{
+		rtn = std::move(src);
+		swap(rtn);
+	}
+};
+
+
+}
+
+
+#endif
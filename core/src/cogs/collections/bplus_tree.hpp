@@ -0,0 +1,954 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_BPLUS_TREE
+#define COGS_HEADER_COLLECTION_BPLUS_TREE
+
+
+#include <cstring>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "cogs/env.hpp"
+#include "cogs/operators.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+
+
+#ifndef COGS_BPLUS_TREE_NODE_SIZE
+
+/// @brief The approximate size of a bplus_tree node, in bytes.  Determines the number of keys per node.
+#define COGS_BPLUS_TREE_NODE_SIZE 256
+#endif
+
+
+namespace cogs {
+
+
+template <typename value_t, size_t n>
+class bplus_tree_leaf_values
+{
+private:
+	alignas(value_t) unsigned char m_valueStorage[sizeof(value_t) * n];
+
+public:
+	value_t* get_values() { return std::launder(reinterpret_cast<value_t*>(m_valueStorage)); }
+};
+
+template <size_t n>
+class bplus_tree_leaf_values<void, n>
+{
+};
+
+
+template <typename key_t, typename value_t>
+class bplus_tree_entry
+{
+public:
+	const key_t& key;
+	value_t& value;
+};
+
+
+/// @ingroup Collections
+/// @brief A sorted O(log n) collection with unique keys, stored in a B+tree.  The basis of bplus_map and bplus_set.
+///
+/// Keys are stored in contiguous arrays within wide nodes, so a lookup touches few cache lines, and elements are
+/// not individually allocated.  All elements are stored in leaves, which are linked to allow in-order traversal
+/// without returning to the interior of the tree.
+///
+/// If the key is an arithmetic type and the default comparator is used, the unused key slots of each node are
+/// padded with the maximum value, and nodes are searched with a fixed-length branch-free loop that compilers
+/// vectorize.  Otherwise, nodes are searched using a binary search.
+///
+/// Unlike map and set, inserting or removing an element invalidates all iterators.  Not thread-safe.
+/// @tparam key_t The key type
+/// @tparam value_t The value type, or void if there is no value
+/// @tparam comparator_t A static comparator class used to compare keys.  Default: default_comparator
+/// @tparam memory_manager_t A static memory manager used to allocate nodes.  Default: default_memory_manager
+/// @tparam node_size The approximate size of a node, in bytes.  Default: COGS_BPLUS_TREE_NODE_SIZE
+template <typename key_t, typename value_t = void, class comparator_t = default_comparator, class memory_manager_t = default_memory_manager, size_t node_size = COGS_BPLUS_TREE_NODE_SIZE>
+class bplus_tree
+{
+public:
+	typedef key_t key_type;
+	typedef value_t value_type;
+	typedef memory_manager_t memory_manager_type;
+
+private:
+	typedef bplus_tree<key_t, value_t, comparator_t, memory_manager_t, node_size> this_t;
+
+	static_assert(memory_manager_t::is_static);
+
+	static constexpr bool has_values = !std::is_void_v<value_t>;
+	static constexpr size_t value_size = has_values ? sizeof(std::conditional_t<has_values, value_t, char>) : 0;
+
+	static constexpr size_t compute_capacity(size_t overhead, size_t elementSize)
+	{
+		size_t n = (node_size > overhead) ? ((node_size - overhead) / elementSize) : 0;
+		return (n < 4) ? 4 : n;
+	}
+
+	static constexpr size_t leaf_capacity = compute_capacity(sizeof(void*) * 4, sizeof(key_t) + value_size);
+	static constexpr size_t inner_capacity = compute_capacity(sizeof(void*) * 3, sizeof(key_t) + sizeof(void*));
+	static constexpr size_t leaf_min = leaf_capacity / 2;
+	static constexpr size_t inner_min = inner_capacity / 2;
+	static constexpr size_t max_depth = sizeof(size_t) * 8;
+
+	static constexpr bool padded_search = std::is_arithmetic_v<key_t> && std::is_same_v<comparator_t, default_comparator>;
+
+	class node_header
+	{
+	public:
+		size_t m_count;
+		bool m_isLeaf;
+
+		explicit node_header(bool isLeaf)
+			: m_count(0),
+			m_isLeaf(isLeaf)
+		{ }
+	};
+
+	// Storage for 1 more than capacity, so a full node can accept an element before it is split
+	template <size_t n>
+	class key_array
+	{
+	private:
+		alignas(key_t) unsigned char m_keyStorage[sizeof(key_t) * (n + 1)];
+
+	public:
+		key_array()
+		{
+			if constexpr (padded_search)
+				pad_keys(get_keys(), 0, n);
+		}
+
+		key_t* get_keys() { return std::launder(reinterpret_cast<key_t*>(m_keyStorage)); }
+		const key_t* get_keys() const { return std::launder(reinterpret_cast<const key_t*>(m_keyStorage)); }
+	};
+
+	class leaf : public node_header, public key_array<leaf_capacity>, public bplus_tree_leaf_values<value_t, leaf_capacity + 1>
+	{
+	public:
+		leaf* m_prev;
+		leaf* m_next;
+
+		leaf()
+			: node_header(true),
+			m_prev(nullptr),
+			m_next(nullptr)
+		{ }
+	};
+
+	class inner : public node_header, public key_array<inner_capacity>
+	{
+	public:
+		node_header* m_children[inner_capacity + 2];
+
+		inner()
+			: node_header(false)
+		{ }
+	};
+
+	class path_entry
+	{
+	public:
+		inner* m_node;
+		size_t m_index;
+	};
+
+	node_header* m_root;
+	leaf* m_first;
+	leaf* m_last;
+	size_t m_count;
+
+	static void pad_keys(key_t* keys, size_t from, size_t to)
+	{
+		if constexpr (padded_search)
+		{
+			for (size_t i = from; i < to; i++)
+				keys[i] = (std::numeric_limits<key_t>::max)();
+		}
+	}
+
+	static bool is_less_than(const key_t& k1, const key_t& k2) { return comparator_t::is_less_than(k1, k2); }
+
+	// Gets the number of keys less than k.  The index of the first key not less than k.
+	template <size_t capacity>
+	static size_t count_less_than(const key_t* keys, size_t n, const key_t& k)
+	{
+		if constexpr (padded_search)
+		{
+			// Unused slots contain the maximum value, so are never less than k.
+			// A fixed-length loop without branches, to allow vectorization.
+			size_t result = 0;
+			for (size_t i = 0; i < capacity; i++)
+				result += (keys[i] < k) ? 1 : 0;
+			return result;
+		}
+		else
+		{
+			size_t lo = 0;
+			while (lo < n)
+			{
+				size_t mid = lo + ((n - lo) / 2);
+				if (is_less_than(keys[mid], k))
+					lo = mid + 1;
+				else
+					n = mid;
+			}
+			return lo;
+		}
+	}
+
+	static size_t get_child_index(const inner* n, const key_t& k)
+	{
+		const key_t* keys = n->get_keys();
+		size_t i = count_less_than<inner_capacity>(keys, n->m_count, k);
+		if ((i < n->m_count) && !is_less_than(k, keys[i]))
+			i++;
+		return i;
+	}
+
+	// Opens a gap at pos, in an array containing count elements
+	template <typename T>
+	static void open_gap(T* a, size_t count, size_t pos)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+			memmove((void*)(a + pos + 1), (void*)(a + pos), (count - pos) * sizeof(T));
+		else
+		{
+			for (size_t i = count; i > pos; i--)
+			{
+				new (a + i) T(std::move(a[i - 1]));
+				a[i - 1].~T();
+			}
+		}
+	}
+
+	// Closes a gap at pos (already destructed), in an array containing count elements including the gap
+	template <typename T>
+	static void close_gap(T* a, size_t count, size_t pos)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+			memmove((void*)(a + pos), (void*)(a + pos + 1), (count - pos - 1) * sizeof(T));
+		else
+		{
+			for (size_t i = pos + 1; i < count; i++)
+			{
+				new (a + i - 1) T(std::move(a[i]));
+				a[i].~T();
+			}
+		}
+	}
+
+	// Moves n elements to uninitialized storage
+	template <typename T>
+	static void move_elements(T* dst, T* src, size_t n)
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+			memcpy((void*)dst, (void*)src, n * sizeof(T));
+		else
+		{
+			for (size_t i = 0; i < n; i++)
+			{
+				new (dst + i) T(std::move(src[i]));
+				src[i].~T();
+			}
+		}
+	}
+
+	template <typename T>
+	static void destruct_elements(T* a, size_t n)
+	{
+		if constexpr (!std::is_trivially_destructible_v<T>)
+		{
+			for (size_t i = 0; i < n; i++)
+				a[i].~T();
+		}
+	}
+
+	static leaf* create_leaf()
+	{
+		leaf* l = memory_manager_t::template allocate_type<leaf>();
+		new (l) leaf;
+		return l;
+	}
+
+	static inner* create_inner()
+	{
+		inner* n = memory_manager_t::template allocate_type<inner>();
+		new (n) inner;
+		return n;
+	}
+
+	static void dispose_leaf(leaf* l)
+	{
+		destruct_elements(l->get_keys(), l->m_count);
+		if constexpr (has_values)
+			destruct_elements(l->get_values(), l->m_count);
+		memory_manager_t::destruct_deallocate_type(l);
+	}
+
+	static void dispose_inner(inner* n)
+	{
+		destruct_elements(n->get_keys(), n->m_count);
+		memory_manager_t::destruct_deallocate_type(n);
+	}
+
+	static void dispose_subtree(node_header* n)
+	{
+		if (n->m_isLeaf)
+			dispose_leaf(static_cast<leaf*>(n));
+		else
+		{
+			inner* in = static_cast<inner*>(n);
+			for (size_t i = 0; i <= in->m_count; i++)
+				dispose_subtree(in->m_children[i]);
+			dispose_inner(in);
+		}
+	}
+
+	void clear_inner()
+	{
+		if (!!m_root)
+			dispose_subtree(m_root);
+		m_root = nullptr;
+		m_first = nullptr;
+		m_last = nullptr;
+		m_count = 0;
+	}
+
+	leaf* find_leaf(const key_t& k, path_entry* path, size_t& depth) const
+	{
+		depth = 0;
+		node_header* n = m_root;
+		while (!n->m_isLeaf)
+		{
+			inner* in = static_cast<inner*>(n);
+			size_t i = get_child_index(in, k);
+			if (!!path)
+			{
+				path[depth].m_node = in;
+				path[depth].m_index = i;
+			}
+			depth++;
+			n = in->m_children[i];
+		}
+		return static_cast<leaf*>(n);
+	}
+
+	static void remove_inner_entry(inner* n, size_t keyIndex)
+	{
+		// Removes the key at keyIndex, and the child to its right
+		key_t* keys = n->get_keys();
+		keys[keyIndex].~key_t();
+		close_gap(keys, n->m_count, keyIndex);
+		close_gap(n->m_children, n->m_count + 1, keyIndex + 1);
+		n->m_count--;
+		pad_keys(keys, n->m_count, n->m_count + 1);
+	}
+
+	void unlink_leaf(leaf* l)
+	{
+		if (!!l->m_prev)
+			l->m_prev->m_next = l->m_next;
+		else
+			m_first = l->m_next;
+		if (!!l->m_next)
+			l->m_next->m_prev = l->m_prev;
+		else
+			m_last = l->m_prev;
+	}
+
+	// Inserts sep and right into the parent of left, splitting ancestors as needed
+	void insert_into_parent(path_entry* path, size_t depth, node_header* left, key_t sep, node_header* right)
+	{
+		for (;;)
+		{
+			if (!depth)
+			{
+				inner* root = create_inner();
+				new (root->get_keys()) key_t(std::move(sep));
+				root->m_children[0] = left;
+				root->m_children[1] = right;
+				root->m_count = 1;
+				m_root = root;
+				return;
+			}
+			path_entry& pe = path[--depth];
+			inner* p = pe.m_node;
+			key_t* keys = p->get_keys();
+			open_gap(keys, p->m_count, pe.m_index);
+			new (keys + pe.m_index) key_t(std::move(sep));
+			open_gap(p->m_children, p->m_count + 1, pe.m_index + 1);
+			p->m_children[pe.m_index + 1] = right;
+			if (++(p->m_count) <= inner_capacity)
+				return;
+
+			// Split.  The middle key moves up to the parent.
+			inner* r = create_inner();
+			size_t mid = p->m_count / 2;
+			size_t rightCount = p->m_count - mid - 1;
+			key_t promoted(std::move(keys[mid]));
+			keys[mid].~key_t();
+			move_elements(r->get_keys(), keys + mid + 1, rightCount);
+			memcpy((void*)r->m_children, (void*)(p->m_children + mid + 1), (rightCount + 1) * sizeof(node_header*));
+			r->m_count = rightCount;
+			p->m_count = mid;
+			pad_keys(keys, mid, inner_capacity + 1);
+			left = p;
+			right = r;
+			sep = std::move(promoted);
+		}
+	}
+
+	// Restores the minimum occupancy of the inner node at path[depth], after removal of one of its entries
+	void rebalance_inner(path_entry* path, size_t depth)
+	{
+		for (;;)
+		{
+			inner* n = path[depth].m_node;
+			if (!depth)
+			{
+				if (!n->m_count)
+				{
+					m_root = n->m_children[0];
+					dispose_inner(n);
+				}
+				return;
+			}
+			if (n->m_count >= inner_min)
+				return;
+
+			inner* p = path[depth - 1].m_node;
+			size_t i = path[depth - 1].m_index;
+			key_t* parentKeys = p->get_keys();
+			key_t* keys = n->get_keys();
+			inner* left = (i > 0) ? static_cast<inner*>(p->m_children[i - 1]) : nullptr;
+			inner* right = (i < p->m_count) ? static_cast<inner*>(p->m_children[i + 1]) : nullptr;
+			if (!!left && (left->m_count > inner_min))
+			{
+				// Rotate right, through the parent
+				key_t* leftKeys = left->get_keys();
+				open_gap(keys, n->m_count, 0);
+				new (keys) key_t(std::move(parentKeys[i - 1]));
+				open_gap(n->m_children, n->m_count + 1, 0);
+				n->m_children[0] = left->m_children[left->m_count];
+				n->m_count++;
+				parentKeys[i - 1] = std::move(leftKeys[left->m_count - 1]);
+				leftKeys[left->m_count - 1].~key_t();
+				left->m_count--;
+				pad_keys(leftKeys, left->m_count, left->m_count + 1);
+				return;
+			}
+			if (!!right && (right->m_count > inner_min))
+			{
+				// Rotate left, through the parent
+				key_t* rightKeys = right->get_keys();
+				new (keys + n->m_count) key_t(std::move(parentKeys[i]));
+				n->m_children[n->m_count + 1] = right->m_children[0];
+				n->m_count++;
+				parentKeys[i] = std::move(rightKeys[0]);
+				rightKeys[0].~key_t();
+				close_gap(rightKeys, right->m_count, 0);
+				close_gap(right->m_children, right->m_count + 1, 0);
+				right->m_count--;
+				pad_keys(rightKeys, right->m_count, right->m_count + 1);
+				return;
+			}
+
+			// Merge with a sibling, pulling down the separating key
+			size_t sepIndex = !!left ? (i - 1) : i;
+			inner* dst = !!left ? left : n;
+			inner* src = !!left ? n : right;
+			key_t* dstKeys = dst->get_keys();
+			new (dstKeys + dst->m_count) key_t(std::move(parentKeys[sepIndex]));
+			move_elements(dstKeys + dst->m_count + 1, src->get_keys(), src->m_count);
+			memcpy((void*)(dst->m_children + dst->m_count + 1), (void*)src->m_children, (src->m_count + 1) * sizeof(node_header*));
+			dst->m_count += src->m_count + 1;
+			src->m_count = 0;
+			dispose_inner(src);
+			remove_inner_entry(p, sepIndex);
+			depth--;
+		}
+	}
+
+	void remove_from_leaf(leaf* l, size_t pos, path_entry* path, size_t depth)
+	{
+		key_t* keys = l->get_keys();
+		keys[pos].~key_t();
+		close_gap(keys, l->m_count, pos);
+		if constexpr (has_values)
+		{
+			value_t* values = l->get_values();
+			values[pos].~value_t();
+			close_gap(values, l->m_count, pos);
+		}
+		l->m_count--;
+		pad_keys(keys, l->m_count, l->m_count + 1);
+		m_count--;
+
+		if (!depth)
+		{
+			if (!l->m_count)
+			{
+				dispose_leaf(l);
+				m_root = nullptr;
+				m_first = nullptr;
+				m_last = nullptr;
+			}
+			return;
+		}
+		if (l->m_count >= leaf_min)
+			return;
+
+		inner* p = path[depth - 1].m_node;
+		size_t i = path[depth - 1].m_index;
+		key_t* parentKeys = p->get_keys();
+		leaf* left = (i > 0) ? static_cast<leaf*>(p->m_children[i - 1]) : nullptr;
+		leaf* right = (i < p->m_count) ? static_cast<leaf*>(p->m_children[i + 1]) : nullptr;
+		if (!!left && (left->m_count > leaf_min))
+		{
+			// Borrow the last element of the left sibling
+			size_t last = left->m_count - 1;
+			open_gap(keys, l->m_count, 0);
+			new (keys) key_t(std::move(left->get_keys()[last]));
+			left->get_keys()[last].~key_t();
+			if constexpr (has_values)
+			{
+				open_gap(l->get_values(), l->m_count, 0);
+				new (l->get_values()) value_t(std::move(left->get_values()[last]));
+				left->get_values()[last].~value_t();
+			}
+			left->m_count--;
+			l->m_count++;
+			pad_keys(left->get_keys(), left->m_count, left->m_count + 1);
+			parentKeys[i - 1] = keys[0];
+			return;
+		}
+		if (!!right && (right->m_count > leaf_min))
+		{
+			// Borrow the first element of the right sibling
+			key_t* rightKeys = right->get_keys();
+			new (keys + l->m_count) key_t(std::move(rightKeys[0]));
+			rightKeys[0].~key_t();
+			close_gap(rightKeys, right->m_count, 0);
+			if constexpr (has_values)
+			{
+				value_t* rightValues = right->get_values();
+				new (l->get_values() + l->m_count) value_t(std::move(rightValues[0]));
+				rightValues[0].~value_t();
+				close_gap(rightValues, right->m_count, 0);
+			}
+			right->m_count--;
+			l->m_count++;
+			pad_keys(rightKeys, right->m_count, right->m_count + 1);
+			parentKeys[i] = rightKeys[0];
+			return;
+		}
+
+		// Merge with a sibling
+		size_t sepIndex = !!left ? (i - 1) : i;
+		leaf* dst = !!left ? left : l;
+		leaf* src = !!left ? l : right;
+		move_elements(dst->get_keys() + dst->m_count, src->get_keys(), src->m_count);
+		if constexpr (has_values)
+			move_elements(dst->get_values() + dst->m_count, src->get_values(), src->m_count);
+		dst->m_count += src->m_count;
+		src->m_count = 0;
+		unlink_leaf(src);
+		dispose_leaf(src);
+		remove_inner_entry(p, sepIndex);
+		rebalance_inner(path, depth - 1);
+	}
+
+public:
+	class iterator
+	{
+	private:
+		friend class bplus_tree;
+
+		leaf* m_leaf;
+		size_t m_index;
+
+		iterator(leaf* l, size_t i)
+			: m_leaf(l),
+			m_index(i)
+		{ }
+
+	public:
+		typedef std::conditional_t<has_values, bplus_tree_entry<key_t, value_t>, const key_t&> reference;
+
+		class arrow
+		{
+		private:
+			bplus_tree_entry<key_t, value_t> m_entry;
+
+		public:
+			explicit arrow(const bplus_tree_entry<key_t, value_t>& e) : m_entry(e) { }
+			const bplus_tree_entry<key_t, value_t>* operator->() const { return &m_entry; }
+		};
+
+		iterator()
+			: m_leaf(nullptr),
+			m_index(0)
+		{ }
+
+		void release() { m_leaf = nullptr; }
+
+		void assign_next()
+		{
+			if (!!m_leaf && (++m_index == m_leaf->m_count))
+			{
+				m_leaf = m_leaf->m_next;
+				m_index = 0;
+			}
+		}
+
+		void assign_prev()
+		{
+			if (!!m_leaf)
+			{
+				if (!!m_index)
+					m_index--;
+				else
+				{
+					m_leaf = m_leaf->m_prev;
+					if (!!m_leaf)
+						m_index = m_leaf->m_count - 1;
+				}
+			}
+		}
+
+		iterator& operator++() { assign_next(); return *this; }
+		iterator& operator--() { assign_prev(); return *this; }
+		iterator operator++(int) { iterator tmp(*this); assign_next(); return tmp; }
+		iterator operator--(int) { iterator tmp(*this); assign_prev(); return tmp; }
+
+		iterator next() const { iterator tmp(*this); tmp.assign_next(); return tmp; }
+		iterator prev() const { iterator tmp(*this); tmp.assign_prev(); return tmp; }
+
+		bool operator!() const { return !m_leaf; }
+
+		bool operator==(const iterator& i) const { return (m_leaf == i.m_leaf) && (!m_leaf || (m_index == i.m_index)); }
+		bool operator!=(const iterator& i) const { return !operator==(i); }
+
+		const key_t& get_key() const { return m_leaf->get_keys()[m_index]; }
+
+		template <typename V = value_t, typename enable = std::enable_if_t<!std::is_void_v<V> > >
+		V& get_value() const { return m_leaf->get_values()[m_index]; }
+
+		reference operator*() const
+		{
+			if constexpr (has_values)
+				return reference{ get_key(), get_value() };
+			else
+				return get_key();
+		}
+
+		auto operator->() const
+		{
+			if constexpr (has_values)
+				return arrow(reference{ get_key(), get_value() });
+			else
+				return &get_key();
+		}
+	};
+
+	typedef iterator remove_token;
+
+	struct insert_unique_result
+	{
+		iterator inserted;
+		iterator existing;
+	};
+
+	struct insert_replace_result
+	{
+		iterator inserted;
+		bool wasReplacement;
+	};
+
+	bplus_tree()
+		: m_root(nullptr),
+		m_first(nullptr),
+		m_last(nullptr),
+		m_count(0)
+	{ }
+
+	bplus_tree(this_t&& src)
+		: m_root(src.m_root),
+		m_first(src.m_first),
+		m_last(src.m_last),
+		m_count(src.m_count)
+	{
+		src.m_root = nullptr;
+		src.m_first = nullptr;
+		src.m_last = nullptr;
+		src.m_count = 0;
+	}
+
+	bplus_tree(const this_t& src)
+		: bplus_tree()
+	{
+		copy_from(src);
+	}
+
+	~bplus_tree() { clear_inner(); }
+
+	this_t& operator=(this_t&& src)
+	{
+		this_t tmp(std::move(src));
+		swap(tmp);
+		return *this;
+	}
+
+	this_t& operator=(const this_t& src)
+	{
+		if (this != &src)
+		{
+			clear();
+			copy_from(src);
+		}
+		return *this;
+	}
+
+	void clear() { clear_inner(); }
+
+	bool drain() { bool foundAny = !!m_count; clear(); return foundAny; }
+
+	size_t size() const { return m_count; }
+	bool is_empty() const { return !m_count; }
+	bool operator!() const { return is_empty(); }
+
+	iterator get_first() const { return !m_first ? iterator() : iterator(m_first, 0); }
+	iterator get_last() const { return !m_last ? iterator() : iterator(m_last, m_last->m_count - 1); }
+
+	/// @brief Inserts an element, if no element with an equal key is present
+	/// @param k The key
+	/// @param args Arguments to construct the value with
+	template <typename key_arg_t, typename... args_t>
+	insert_unique_result insert_unique_emplace(key_arg_t&& k, args_t&&... args)
+	{
+		insert_unique_result result;
+		bool wasReplacement;
+		iterator i = insert(false, wasReplacement, std::forward<key_arg_t>(k), std::forward<args_t>(args)...);
+		if (wasReplacement)
+			result.existing = i;
+		else
+			result.inserted = i;
+		return result;
+	}
+
+	/// @brief Inserts an element, replacing the value of an element with an equal key, if present
+	/// @param k The key
+	/// @param args Arguments to construct the value with
+	template <typename key_arg_t, typename... args_t>
+	insert_replace_result insert_replace_emplace(key_arg_t&& k, args_t&&... args)
+	{
+		insert_replace_result result;
+		result.inserted = insert(true, result.wasReplacement, std::forward<key_arg_t>(k), std::forward<args_t>(args)...);
+		return result;
+	}
+
+	bool remove(const iterator& i)
+	{
+		path_entry path[max_depth];
+		size_t depth;
+		find_leaf(i.get_key(), path, depth);
+		remove_from_leaf(i.m_leaf, i.m_index, path, depth);
+		return true;
+	}
+
+	bool remove(const iterator& i, bool& wasLast)
+	{
+		remove(i);
+		wasLast = !m_count;
+		return true;
+	}
+
+	/// @brief Removes the element with a key equal to the specified key, if present
+	/// @return True if an element was removed
+	bool remove_key(const key_t& k)
+	{
+		if (!m_root)
+			return false;
+		path_entry path[max_depth];
+		size_t depth;
+		leaf* l = find_leaf(k, path, depth);
+		size_t pos = count_less_than<leaf_capacity>(l->get_keys(), l->m_count, k);
+		if ((pos == l->m_count) || is_less_than(k, l->get_keys()[pos]))
+			return false;
+		remove_from_leaf(l, pos, path, depth);
+		return true;
+	}
+
+	/// @brief Gets an iterator to the first element with a key not less than k
+	iterator lower_bound(const key_t& k) const
+	{
+		if (!m_root)
+			return iterator();
+		size_t depth;
+		leaf* l = find_leaf(k, nullptr, depth);
+		size_t pos = count_less_than<leaf_capacity>(l->get_keys(), l->m_count, k);
+		if (pos < l->m_count)
+			return iterator(l, pos);
+		return !l->m_next ? iterator() : iterator(l->m_next, 0);
+	}
+
+	iterator find(const key_t& criteria) const
+	{
+		iterator i = lower_bound(criteria);
+		if (!!i && is_less_than(criteria, i.get_key()))
+			i.release();
+		return i;
+	}
+
+	iterator find_nearest_less_than(const key_t& criteria) const
+	{
+		iterator i = lower_bound(criteria);
+		if (!i)
+			return get_last();
+		i.assign_prev();
+		return i;
+	}
+
+	iterator find_nearest_greater_than(const key_t& criteria) const
+	{
+		iterator i = lower_bound(criteria);
+		if (!!i && !is_less_than(criteria, i.get_key()))
+			i.assign_next();
+		return i;
+	}
+
+	iterator find_equal_or_nearest_less_than(const key_t& criteria) const
+	{
+		iterator i = lower_bound(criteria);
+		if (!i)
+			return get_last();
+		if (is_less_than(criteria, i.get_key()))
+			i.assign_prev();
+		return i;
+	}
+
+	iterator find_equal_or_nearest_greater_than(const key_t& criteria) const { return lower_bound(criteria); }
+
+	iterator operator[](const key_t& criteria) const { return find(criteria); }
+
+	bool contains(const key_t& criteria) const { return !!find(criteria); }
+
+	void swap(this_t& wth)
+	{
+		std::swap(m_root, wth.m_root);
+		std::swap(m_first, wth.m_first);
+		std::swap(m_last, wth.m_last);
+		std::swap(m_count, wth.m_count);
+	}
+
+	this_t exchange(this_t&& src)
+	{
+		this_t tmp(std::move(src));
+		swap(tmp);
+		return tmp;
+	}
+
+	void exchange(this_t&& src, this_t& rtn)
+	{
+		rtn = std::move(src);
+		swap(rtn);
+	}
+
+	iterator begin() const { return get_first(); }
+	iterator rbegin() const { return get_last(); }
+	iterator end() const { return iterator(); }
+	iterator rend() const { return iterator(); }
+
+private:
+	void copy_from(const this_t& src)
+	{
+		for (iterator i = src.get_first(); !!i; i.assign_next())
+		{
+			if constexpr (has_values)
+				insert_replace_emplace(i.get_key(), i.get_value());
+			else
+				insert_replace_emplace(i.get_key());
+		}
+	}
+
+	template <typename key_arg_t, typename... args_t>
+	iterator insert(bool replace, bool& wasReplacement, key_arg_t&& k, args_t&&... args)
+	{
+		if (!m_root)
+		{
+			leaf* l = create_leaf();
+			m_root = l;
+			m_first = l;
+			m_last = l;
+		}
+
+		path_entry path[max_depth];
+		size_t depth;
+		leaf* l = find_leaf(k, path, depth);
+		key_t* keys = l->get_keys();
+		size_t pos = count_less_than<leaf_capacity>(keys, l->m_count, k);
+		if ((pos < l->m_count) && !is_less_than(k, keys[pos]))
+		{
+			wasReplacement = true;
+			if (replace)
+			{
+				if constexpr (has_values)
+				{
+					value_t* values = l->get_values();
+					values[pos].~value_t();
+					new (values + pos) value_t(std::forward<args_t>(args)...);
+				}
+			}
+			return iterator(l, pos);
+		}
+
+		wasReplacement = false;
+		open_gap(keys, l->m_count, pos);
+		new (keys + pos) key_t(std::forward<key_arg_t>(k));
+		if constexpr (has_values)
+		{
+			value_t* values = l->get_values();
+			open_gap(values, l->m_count, pos);
+			new (values + pos) value_t(std::forward<args_t>(args)...);
+		}
+		m_count++;
+		if (++(l->m_count) <= leaf_capacity)
+			return iterator(l, pos);
+
+		// Split.  The first key of the new right leaf is copied up to the parent.
+		leaf* r = create_leaf();
+		size_t mid = l->m_count / 2;
+		size_t rightCount = l->m_count - mid;
+		move_elements(r->get_keys(), keys + mid, rightCount);
+		if constexpr (has_values)
+			move_elements(r->get_values(), l->get_values() + mid, rightCount);
+		r->m_count = rightCount;
+		l->m_count = mid;
+		pad_keys(keys, mid, leaf_capacity + 1);
+		r->m_next = l->m_next;
+		if (!!r->m_next)
+			r->m_next->m_prev = r;
+		else
+			m_last = r;
+		r->m_prev = l;
+		l->m_next = r;
+		insert_into_parent(path, depth, l, key_t(r->get_keys()[0]), r);
+		return (pos < mid) ? iterator(l, pos) : iterator(r, pos - mid);
+	}
+};
+
+
+}
+
+
+#endif
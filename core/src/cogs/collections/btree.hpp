@@ -1086,7 +1086,6 @@ public:
 	ref_t find_any_equal_or_nearest_less_than(const key_t& criteria) const
 	{
 		ref_t lastFound;
-		ref_t lastLesser;
 		ref_t n = get_root();
 		typename ref_t::lock_t lockedRef;
 		while (!!n)
@@ -1095,7 +1094,7 @@ public:
 			const key_t& key = lockedRef->get_key();
 			if (comparator_t::is_less_than(key, criteria))
 			{
-				lastLesser = n; // lesser
+				lastFound = n; // lesser
 				n = lockedRef->get_right_link();
 			}
 			else if (comparator_t::is_less_than(criteria, key))
@@ -1147,7 +1146,6 @@ public:
 	ref_t find_first_equal_or_nearest_less_than(const key_t& criteria) const
 	{
 		ref_t lastFound;
-		ref_t lastLesser;
 		ref_t n = get_root();
 		typename ref_t::lock_t lockedRef;
 		while (!!n)
@@ -1156,7 +1154,7 @@ public:
 			const key_t& key = lockedRef->get_key();
 			if (comparator_t::is_less_than(key, criteria))
 			{
-				lastLesser = n; // lesser
+				lastFound = n; // lesser
 				n = lockedRef->get_right_link();
 			}
 			else if (comparator_t::is_less_than(criteria, key))
@@ -1238,7 +1236,6 @@ public:
 	ref_t find_last_equal_or_nearest_less_than(const key_t& criteria) const
 	{
 		ref_t lastFound;
-		ref_t lastLesser;
 		ref_t n = get_root();
 		typename ref_t::lock_t lockedRef;
 		while (!!n)
@@ -1247,7 +1244,7 @@ public:
 			const key_t& key = lockedRef->get_key();
 			if (comparator_t::is_less_than(key, criteria))
 			{
-				lastLesser = n; // lesser
+				lastFound = n; // lesser
 				n = lockedRef->get_right_link();
 			}
 			else if (comparator_t::is_less_than(criteria, key))
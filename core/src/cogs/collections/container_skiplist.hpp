@@ -746,7 +746,7 @@ protected:
 				else //if (!!level)
 				{
 					rcptr<link_t> newLastAdjacent = next;
-					result = insert_replace_inner(level - 1, criteria, prev, newLastAdjacent, sentinelPtr);
+					result = insert_replace_inner(level - 1, criteria, prev.dereference(), newLastAdjacent, sentinelPtr);
 				}
 				if (level <= m_height)
 				{
@@ -796,7 +796,7 @@ protected:
 				if (!!level)
 				{
 					rcptr<link_t> newLastAdjacent = next;
-					result = insert_unique_inner(level - 1, criteria, prev, newLastAdjacent, sentinelPtr);
+					result = insert_unique_inner(level - 1, criteria, prev.dereference(), newLastAdjacent, sentinelPtr);
 					if (!!result)
 						break;
 				}
@@ -1047,7 +1047,7 @@ protected:
 			m_memoryManager(std::move(mm))
 		{
 			height_t heightPlusOne = max_height + 1;
-			m_links = mm.template allocate_type<transactable_t>(heightPlusOne);
+			m_links = m_memoryManager.template allocate_type<transactable_t>(heightPlusOne);
 			for (size_t i = 0; i <= max_height; i++)
 				new (m_links.get_ptr() + i) transactable_t;
 			for (height_t i = 0; i <= max_height; i++)
@@ -0,0 +1,132 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_DEFAULT_HASHER
+#define COGS_HEADER_COLLECTION_DEFAULT_HASHER
+
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "cogs/env.hpp"
+
+
+namespace cogs {
+
+
+template <typename T, typename = void>
+class has_get_hash : public std::false_type
+{ };
+
+template <typename T>
+class has_get_hash<T, std::void_t<decltype(std::declval<const T&>().get_hash())> > : public std::true_type
+{ };
+
+template <typename T>
+inline constexpr bool has_get_hash_v = has_get_hash<T>::value;
+
+
+template <typename T, typename = void>
+class has_contiguous_hashable_contents : public std::false_type
+{ };
+
+template <typename T>
+class has_contiguous_hashable_contents<T, std::void_t<decltype(std::declval<const T&>().get_const_ptr()), decltype(std::declval<const T&>().get_length())> >
+	: public std::bool_constant<std::is_trivially_copyable_v<std::remove_cv_t<std::remove_pointer_t<decltype(std::declval<const T&>().get_const_ptr())> > > >
+{ };
+
+template <typename T>
+inline constexpr bool has_contiguous_hashable_contents_v = has_contiguous_hashable_contents<T>::value;
+
+
+/// @ingroup Collections
+/// @brief A default hasher, used by hash_map and hash_set
+///
+/// Integral, enum and pointer values are hashed by mixing their bits.  Types with a get_hash() member
+/// use it.  Types with get_const_ptr() and get_length() members referring to trivially copyable elements,
+/// such as vector and string, are hashed by their contents.  Other types use std::hash.
+class default_hasher
+{
+private:
+	static constexpr uint64_t rotate_left(uint64_t n, unsigned int bits) { return (n << bits) | (n >> (64 - bits)); }
+
+	static constexpr uint64_t mix_word(uint64_t h, uint64_t w)
+	{
+		w *= 0x87C37B91114253D5ULL;
+		w = rotate_left(w, 31);
+		w *= 0x4CF5AD432745937FULL;
+		h ^= w;
+		return (rotate_left(h, 27) * 5) + 0x52DCE729;
+	}
+
+public:
+	/// @brief Mixes the bits of a value, such that each bit of the input affects all bits of the result
+	static constexpr size_t mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+		return (size_t)h;
+	}
+
+	/// @brief Hashes a block of memory
+	static size_t hash_bytes(const void* p, size_t n)
+	{
+		const unsigned char* src = (const unsigned char*)p;
+		uint64_t h = 0x9E3779B97F4A7C15ULL ^ ((uint64_t)n * 0xC2B2AE3D27D4EB4FULL);
+		while (n >= sizeof(uint64_t))
+		{
+			uint64_t w;
+			memcpy(&w, src, sizeof(uint64_t));
+			h = mix_word(h, w);
+			src += sizeof(uint64_t);
+			n -= sizeof(uint64_t);
+		}
+		if (!!n)
+		{
+			uint64_t w = 0;
+			memcpy(&w, src, n);
+			h = mix_word(h, w);
+		}
+		return mix(h);
+	}
+
+	/// @brief Gets the hash of a value
+	template <typename T>
+	static size_t get_hash(const T& t)
+	{
+		typedef std::remove_cv_t<T> type;
+		if constexpr (std::is_enum_v<type>)
+			return mix((uint64_t)static_cast<std::underlying_type_t<type> >(t));
+		else if constexpr (std::is_integral_v<type>)
+		{
+			if constexpr (sizeof(type) > sizeof(uint64_t))
+				return mix((uint64_t)t ^ (uint64_t)(t >> 64));
+			else
+				return mix((uint64_t)t);
+		}
+		else if constexpr (std::is_pointer_v<type>)
+			return mix((uint64_t)(size_t)t);
+		else if constexpr (has_get_hash_v<type>)
+			return (size_t)t.get_hash();
+		else if constexpr (has_contiguous_hashable_contents_v<type>)
+			return hash_bytes(t.get_const_ptr(), t.get_length() * sizeof(*t.get_const_ptr()));
+		else
+			return mix((uint64_t)std::hash<type>()(t));
+	}
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,211 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_HASH_MAP
+#define COGS_HEADER_COLLECTION_HASH_MAP
+
+
+#include <type_traits>
+#include <utility>
+
+#include "cogs/operators.hpp"
+#include "cogs/collections/hash_table.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup LockFreeCollections
+/// @brief An unordered O(1) collection of values indexed by unique keys.
+///
+/// Unlike map, elements are not sorted.  Lookups do not traverse a tree or skiplist, so involve fewer
+/// dependent loads.  Thread-safe (volatile) lookups return copies of values, or pass them to a function.
+/// @tparam key_t The key type
+/// @tparam value_t The value type
+/// @tparam hasher_t A static hasher class.  Default: default_hasher
+/// @tparam comparator_t A static comparator class used to compare keys for equality.  Default: default_comparator
+/// @tparam memory_manager_t A static memory manager.  Default: default_memory_manager
+template <typename key_t, typename value_t, class hasher_t = default_hasher, class comparator_t = default_comparator, class memory_manager_t = default_memory_manager>
+class hash_map
+{
+public:
+	typedef key_t key_type;
+	typedef value_t value_type;
+	typedef memory_manager_t memory_manager_type;
+
+	class payload
+	{
+	private:
+		key_t m_key;
+		value_t m_value;
+
+	public:
+		template <typename key_arg_t, typename... args_t>
+		explicit payload(key_arg_t&& k, args_t&&... args)
+			: m_key(std::forward<key_arg_t>(k)),
+			m_value(std::forward<args_t>(args)...)
+		{ }
+
+		const key_t& get_key() const { return m_key; }
+		value_t& get_value() { return m_value; }
+		const value_t& get_value() const { return m_value; }
+	};
+
+private:
+	typedef hash_map<key_t, value_t, hasher_t, comparator_t, memory_manager_t> this_t;
+	typedef hash_table<key_t, payload, hasher_t, comparator_t, memory_manager_t> hash_table_t;
+
+	hash_table_t m_contents;
+
+	hash_map(const this_t&) = delete;
+	this_t& operator=(const this_t&) = delete;
+
+public:
+	typedef typename hash_table_t::iterator iterator;
+
+	/// @brief Constructor
+	/// @param initialBuckets The initial number of buckets.  Rounded up to a power of 2.
+	explicit hash_map(size_t initialBuckets = COGS_HASH_TABLE_INITIAL_BUCKETS)
+		: m_contents(initialBuckets)
+	{ }
+
+	hash_map(this_t&& src)
+		: m_contents(std::move(src.m_contents))
+	{ }
+
+	this_t& operator=(this_t&& src)
+	{
+		m_contents = std::move(src.m_contents);
+		return *this;
+	}
+
+	void swap(this_t& wth) { m_contents.swap(wth.m_contents); }
+
+	void clear() { m_contents.clear(); }
+
+	size_t size() const { return m_contents.size(); }
+	size_t size() const volatile { return m_contents.size(); }
+
+	bool is_empty() const { return m_contents.is_empty(); }
+	bool is_empty() const volatile { return m_contents.is_empty(); }
+
+	/// @{
+	/// @brief Inserts a value, if no value with an equal key is present
+	/// @return True if the value was inserted, false if a value with an equal key was already present
+	bool insert_unique(const key_t& k, const value_t& v) { return insert_unique_emplace(k, v); }
+	bool insert_unique(const key_t& k, value_t&& v) { return insert_unique_emplace(k, std::move(v)); }
+	/// @}
+
+	/// @{
+	/// @brief Thread-safe implementation of insert_unique()
+	bool insert_unique(const key_t& k, const value_t& v) volatile { return insert_unique_emplace(k, v); }
+	bool insert_unique(const key_t& k, value_t&& v) volatile { return insert_unique_emplace(k, std::move(v)); }
+	/// @}
+
+	/// @brief Inserts a value constructed from args, if no value with an equal key is present
+	/// @return True if the value was inserted, false if a value with an equal key was already present
+	template <typename... args_t>
+	bool insert_unique_emplace(const key_t& k, args_t&&... args)
+	{
+		bool inserted;
+		m_contents.insert_unique_emplace(k, inserted, k, std::forward<args_t>(args)...);
+		return inserted;
+	}
+
+	/// @brief Thread-safe implementation of insert_unique_emplace()
+	template <typename... args_t>
+	bool insert_unique_emplace(const key_t& k, args_t&&... args) volatile
+	{
+		return m_contents.insert_unique_emplace(k, k, std::forward<args_t>(args)...);
+	}
+
+	/// @{
+	/// @brief Inserts a value, replacing the value of an equal key, if present
+	/// @return True if the value was inserted, false if an existing value was replaced
+	bool insert_replace(const key_t& k, const value_t& v)
+	{
+		bool inserted;
+		payload& p = m_contents.insert_unique_emplace(k, inserted, k, v);
+		if (!inserted)
+			p.get_value() = v;
+		return inserted;
+	}
+
+	bool insert_replace(const key_t& k, value_t&& v)
+	{
+		bool inserted;
+		payload& p = m_contents.insert_unique_emplace(k, inserted, k, std::move(v));
+		if (!inserted)
+			p.get_value() = std::move(v);
+		return inserted;
+	}
+	/// @}
+
+	/// @brief Finds the value associated with a key
+	/// @return A pointer to the value, or nullptr if not found
+	value_t* find(const key_t& k) const
+	{
+		payload* p = m_contents.find(k);
+		return !p ? nullptr : &p->get_value();
+	}
+
+	/// @brief Thread-safe implementation of find().  Copies the value associated with a key.
+	/// @param k The key to find
+	/// @param[out] rtn Receives a copy of the value, if found
+	/// @return True if the key was found
+	bool find(const key_t& k, value_t& rtn) const volatile
+	{
+		return m_contents.find(k, [&](const payload& p) { rtn = p.get_value(); });
+	}
+
+	/// @brief Thread-safe implementation of find().  Passes the value associated with a key to f, if found.
+	///
+	/// The value may be removed by another thread while f is being called, but will not be disposed.
+	/// @return True if the key was found
+	template <typename F, typename enable = std::enable_if_t<std::is_invocable_v<F, const value_t&> > >
+	bool find_via(const key_t& k, F&& f) const volatile
+	{
+		return m_contents.find(k, [&](const payload& p) { f(p.get_value()); });
+	}
+
+	bool contains(const key_t& k) const { return m_contents.contains(k); }
+	bool contains(const key_t& k) const volatile { return m_contents.contains(k); }
+
+	/// @brief Removes the value associated with a key
+	/// @return True if a value was removed
+	bool remove(const key_t& k) { return m_contents.remove(k); }
+
+	/// @brief Thread-safe implementation of remove()
+	bool remove(const key_t& k) volatile { return m_contents.remove(k); }
+
+	void remove(const iterator& i) { m_contents.remove(i); }
+
+	/// @brief Calls f with each key and value
+	template <typename F>
+	void for_each(F&& f) const
+	{
+		m_contents.for_each([&](const payload& p) { f(p.get_key(), p.get_value()); });
+	}
+
+	/// @brief Thread-safe implementation of for_each().
+	///
+	/// Values inserted or removed by other threads during the traversal may or may not be included.
+	template <typename F>
+	void for_each(F&& f) const volatile
+	{
+		m_contents.for_each([&](const payload& p) { f(p.get_key(), p.get_value()); });
+	}
+
+	iterator begin() const { return m_contents.begin(); }
+	iterator end() const { return m_contents.end(); }
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,123 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_HASH_SET
+#define COGS_HEADER_COLLECTION_HASH_SET
+
+
+#include <utility>
+
+#include "cogs/operators.hpp"
+#include "cogs/collections/hash_table.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup LockFreeCollections
+/// @brief An unordered O(1) collection.  Unique values are enforced.
+/// @tparam T The type to contain
+/// @tparam hasher_t A static hasher class.  Default: default_hasher
+/// @tparam comparator_t A static comparator class used to compare values for equality.  Default: default_comparator
+/// @tparam memory_manager_t A static memory manager.  Default: default_memory_manager
+template <typename T, class hasher_t = default_hasher, class comparator_t = default_comparator, class memory_manager_t = default_memory_manager>
+class hash_set
+{
+public:
+	typedef T type;
+	typedef memory_manager_t memory_manager_type;
+
+private:
+	typedef hash_set<type, hasher_t, comparator_t, memory_manager_t> this_t;
+	typedef hash_table<type, type, hasher_t, comparator_t, memory_manager_t> hash_table_t;
+
+	hash_table_t m_contents;
+
+	hash_set(const this_t&) = delete;
+	this_t& operator=(const this_t&) = delete;
+
+public:
+	typedef typename hash_table_t::iterator iterator;
+
+	/// @brief Constructor
+	/// @param initialBuckets The initial number of buckets.  Rounded up to a power of 2.
+	explicit hash_set(size_t initialBuckets = COGS_HASH_TABLE_INITIAL_BUCKETS)
+		: m_contents(initialBuckets)
+	{ }
+
+	hash_set(this_t&& src)
+		: m_contents(std::move(src.m_contents))
+	{ }
+
+	this_t& operator=(this_t&& src)
+	{
+		m_contents = std::move(src.m_contents);
+		return *this;
+	}
+
+	void swap(this_t& wth) { m_contents.swap(wth.m_contents); }
+
+	void clear() { m_contents.clear(); }
+
+	size_t size() const { return m_contents.size(); }
+	size_t size() const volatile { return m_contents.size(); }
+
+	bool is_empty() const { return m_contents.is_empty(); }
+	bool is_empty() const volatile { return m_contents.is_empty(); }
+
+	/// @{
+	/// @brief Inserts a value, if an equal value is not already present
+	/// @return True if the value was inserted
+	bool insert_unique(const type& t)
+	{
+		bool inserted;
+		m_contents.insert_unique_emplace(t, inserted, t);
+		return inserted;
+	}
+
+	bool insert_unique(type&& t)
+	{
+		bool inserted;
+		m_contents.insert_unique_emplace(t, inserted, std::move(t));
+		return inserted;
+	}
+	/// @}
+
+	/// @brief Thread-safe implementation of insert_unique()
+	bool insert_unique(const type& t) volatile { return m_contents.insert_unique_emplace(t, t); }
+
+	bool contains(const type& t) const { return m_contents.contains(t); }
+	bool contains(const type& t) const volatile { return m_contents.contains(t); }
+
+	/// @brief Removes a value equal to the specified value
+	/// @return True if a value was removed
+	bool remove(const type& t) { return m_contents.remove(t); }
+
+	/// @brief Thread-safe implementation of remove()
+	bool remove(const type& t) volatile { return m_contents.remove(t); }
+
+	void remove(const iterator& i) { m_contents.remove(i); }
+
+	/// @brief Calls f with each value
+	template <typename F>
+	void for_each(F&& f) const { m_contents.for_each(std::forward<F>(f)); }
+
+	/// @brief Thread-safe implementation of for_each().
+	///
+	/// Values inserted or removed by other threads during the traversal may or may not be included.
+	template <typename F>
+	void for_each(F&& f) const volatile { m_contents.for_each(std::forward<F>(f)); }
+
+	iterator begin() const { return m_contents.begin(); }
+	iterator end() const { return m_contents.end(); }
+};
+
+
+}
+
+
+#endif
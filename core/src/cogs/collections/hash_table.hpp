@@ -0,0 +1,596 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_COLLECTION_HASH_TABLE
+#define COGS_HEADER_COLLECTION_HASH_TABLE
+
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "cogs/env.hpp"
+#include "cogs/operators.hpp"
+#include "cogs/collections/default_hasher.hpp"
+#include "cogs/env/mem/bit_scan.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+#include "cogs/sync/epoch.hpp"
+
+
+#ifndef COGS_HASH_TABLE_LOAD_FACTOR
+
+/// @brief The average number of elements per bucket, above which a hash_table doubles its number of buckets
+#define COGS_HASH_TABLE_LOAD_FACTOR 2
+#endif
+
+
+#ifndef COGS_HASH_TABLE_INITIAL_BUCKETS
+
+/// @brief The default initial number of buckets in a hash_table
+#define COGS_HASH_TABLE_INITIAL_BUCKETS 16
+#endif
+
+
+namespace cogs {
+
+
+/// @ingroup LockFreeCollections
+/// @brief An unordered O(1) collection of payloads with unique keys.  The basis of hash_map and hash_set.
+///
+/// Implemented as a lock-free split-ordered list (Shalev and Shavit).  All elements are stored in a single
+/// lock-free linked list, sorted by bit-reversed hash.  Each bucket refers to a sentinel node within the list,
+/// created when the bucket is first used.  Doubling the number of buckets splits each bucket without moving
+/// any elements, so growth does not block or copy.
+///
+/// Thread-safe (volatile) operations use epoch-based reclamation.  A removed element is disposed once no thread
+/// can still be traversing it.  Non-volatile operations dispose removed elements immediately.
+/// @tparam key_t The key type
+/// @tparam payload_t The type stored.  If not key_t, must provide a get_key() member returning the key.
+/// @tparam hasher_t A static hasher class.  Default: default_hasher
+/// @tparam comparator_t A static comparator class used to compare keys for equality.  Default: default_comparator
+/// @tparam memory_manager_t A static memory manager.  Default: default_memory_manager
+template <typename key_t, typename payload_t, class hasher_t = default_hasher, class comparator_t = default_comparator, class memory_manager_t = default_memory_manager>
+class hash_table
+{
+public:
+	typedef key_t key_type;
+	typedef payload_t payload_type;
+	typedef memory_manager_t memory_manager_type;
+
+private:
+	typedef hash_table<key_t, payload_t, hasher_t, comparator_t, memory_manager_t> this_t;
+
+	static_assert(memory_manager_t::is_static);
+
+	static constexpr size_t segment_count = sizeof(size_t) * 8;
+	static constexpr size_t max_bucket_count = (size_t)1 << (segment_count - 1);
+
+	class link
+	{
+	public:
+		link* m_next alignas(atomic::get_alignment_v<link*>); // Low bit is set once the node has been removed
+		size_t m_order; // Bit-reversed hash.  Low bit is set for elements, clear for bucket sentinels.
+
+		explicit link(size_t order)
+			: m_next(nullptr),
+			m_order(order)
+		{ }
+
+		bool is_element() const { return !!(m_order & 1); }
+	};
+
+	class node : public link
+	{
+	public:
+		payload_t m_payload;
+
+		template <typename... args_t>
+		explicit node(size_t order, args_t&&... args)
+			: link(order),
+			m_payload(std::forward<args_t>(args)...)
+		{ }
+	};
+
+	link m_head; // Sentinel of bucket 0, at the start of the list
+	link** m_segments[segment_count]; // Segment n contains the buckets [2^n, 2^(n+1)), except segment 0 contains [0, 2)
+	size_t m_bucketCount alignas(atomic::get_alignment_v<size_t>);
+	size_t m_count alignas(atomic::get_alignment_v<size_t>);
+
+	hash_table(const this_t&) = delete;
+	this_t& operator=(const this_t&) = delete;
+
+	static bool is_marked(link* l) { return !!((size_t)l & 1); }
+	static link* get_marked(link* l) { return (link*)((size_t)l | 1); }
+	static link* get_unmarked(link* l) { return (link*)((size_t)l & ~(size_t)1); }
+
+	static size_t reverse_bits(size_t n)
+	{
+		uint64_t x = n;
+		x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+		x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+		x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+		x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+		x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+		x = (x >> 32) | (x << 32);
+		return (size_t)(x >> (64 - segment_count));
+	}
+
+	static size_t get_segment_index(size_t bucket) { return (bucket < 2) ? 0 : bit_scan_reverse(bucket); }
+	static size_t get_segment_base(size_t segmentIndex) { return !segmentIndex ? 0 : ((size_t)1 << segmentIndex); }
+	static size_t get_segment_size(size_t segmentIndex) { return !segmentIndex ? 2 : ((size_t)1 << segmentIndex); }
+
+	static const key_t& get_key(const payload_t& p)
+	{
+		if constexpr (std::is_same_v<payload_t, key_t>)
+			return p;
+		else
+			return p.get_key();
+	}
+
+	static void dispose_node(void* p) { memory_manager_t::destruct_deallocate_type((node*)p); }
+
+	template <bool is_volatile>
+	static void dispose_removed(link* l)
+	{
+		if constexpr (is_volatile)
+			epoch::retire((void*)l, &dispose_node);
+		else
+			dispose_node(l);
+	}
+
+	link** get_bucket_slot(size_t bucket, bool create)
+	{
+		size_t segmentIndex = get_segment_index(bucket);
+		link** segment = atomic::load(m_segments[segmentIndex]);
+		if (!segment)
+		{
+			if (!create)
+				return nullptr;
+			size_t segmentSize = get_segment_size(segmentIndex);
+			link** newSegment = memory_manager_t::template allocate_type<link*>(segmentSize);
+			for (size_t i = 0; i < segmentSize; i++)
+				newSegment[i] = nullptr;
+			link** oldSegment = nullptr;
+			if (atomic::compare_exchange(m_segments[segmentIndex], newSegment, oldSegment, oldSegment))
+				segment = newSegment;
+			else
+			{
+				memory_manager_t::destruct_deallocate_type(newSegment, segmentSize);
+				segment = oldSegment;
+			}
+		}
+		return &segment[bucket - get_segment_base(segmentIndex)];
+	}
+
+	static size_t get_parent_bucket(size_t bucket) { return bucket & ~((size_t)1 << bit_scan_reverse(bucket)); }
+
+	// Gets the sentinel of a bucket, creating it if necessary
+	template <bool is_volatile>
+	link* get_bucket(size_t bucket)
+	{
+		if (!bucket)
+			return &m_head;
+		link** slot = get_bucket_slot(bucket, true);
+		link* sentinel = atomic::load(*slot);
+		if (!sentinel)
+		{
+			link* parent = get_bucket<is_volatile>(get_parent_bucket(bucket));
+			link* newSentinel = memory_manager_t::template allocate_type<link>();
+			new (newSentinel) link(reverse_bits(bucket));
+			sentinel = insert_link<is_volatile>(parent, newSentinel, nullptr);
+			if (sentinel != newSentinel)
+				memory_manager_t::destruct_deallocate_type(newSentinel);
+			link* oldSentinel = nullptr;
+			atomic::compare_exchange(*slot, sentinel, oldSentinel);
+		}
+		return sentinel;
+	}
+
+	// Gets the sentinel of a bucket, or of its closest initialized ancestor, which precedes the bucket's contents in the list
+	link* find_bucket(size_t bucket)
+	{
+		while (!!bucket)
+		{
+			link** slot = get_bucket_slot(bucket, false);
+			if (!!slot)
+			{
+				link* sentinel = atomic::load(*slot);
+				if (!!sentinel)
+					return sentinel;
+			}
+			bucket = get_parent_bucket(bucket);
+		}
+		return &m_head;
+	}
+
+	size_t get_bucket_index(size_t hash) const { return hash & (atomic::load(m_bucketCount) - 1); }
+
+	// Finds the node matching order and key (or the sentinel matching order, if key is nullptr), starting at start.
+	// If not found, prevRtn and curRtn indicate where it would be inserted.  Removed nodes encountered are unlinked.
+	template <bool is_volatile>
+	bool search(link* start, size_t order, const key_t* key, link**& prevRtn, link*& curRtn)
+	{
+		for (;;)
+		{
+			link** prev = &start->m_next;
+			link* cur = atomic::load(*prev);
+			bool restart = false;
+			while (!!cur)
+			{
+				link* next = atomic::load(cur->m_next);
+				if (is_marked(next))
+				{
+					link* oldCur = cur;
+					if (!atomic::compare_exchange(*prev, get_unmarked(next), oldCur))
+					{
+						restart = true;
+						break;
+					}
+					dispose_removed<is_volatile>(cur);
+					cur = get_unmarked(next);
+					continue;
+				}
+				if (cur->m_order >= order)
+				{
+					if (cur->m_order > order)
+						break;
+					if (!key || comparator_t::equals(get_key(static_cast<node*>(cur)->m_payload), *key))
+					{
+						prevRtn = prev;
+						curRtn = cur;
+						return true;
+					}
+				}
+				prev = &cur->m_next;
+				cur = next;
+			}
+			if (!restart)
+			{
+				prevRtn = prev;
+				curRtn = cur;
+				return false;
+			}
+		}
+	}
+
+	// Returns the existing link if a match was found, otherwise inserts and returns l
+	template <bool is_volatile>
+	link* insert_link(link* start, link* l, const key_t* key)
+	{
+		link** prev;
+		link* cur;
+		for (;;)
+		{
+			if (search<is_volatile>(start, l->m_order, key, prev, cur))
+				return cur;
+			l->m_next = cur;
+			link* oldCur = cur;
+			if (atomic::compare_exchange(*prev, l, oldCur))
+				return l;
+		}
+	}
+
+	template <bool is_volatile, typename... args_t>
+	node* insert_unique_inner(const key_t& key, bool& inserted, args_t&&... args)
+	{
+		size_t hash = hasher_t::get_hash(key);
+		size_t order = reverse_bits(hash) | 1;
+		link* start = get_bucket<is_volatile>(get_bucket_index(hash));
+		link** prev;
+		link* cur;
+		node* n = nullptr;
+		const key_t* keyPtr = &key;
+		for (;;)
+		{
+			if (search<is_volatile>(start, order, keyPtr, prev, cur))
+			{
+				if (!!n)
+					memory_manager_t::destruct_deallocate_type(n); // Was not published
+				inserted = false;
+				return static_cast<node*>(cur);
+			}
+			if (!n)
+			{
+				n = memory_manager_t::template allocate_type<node>();
+				new (n) node(order, std::forward<args_t>(args)...);
+				keyPtr = &get_key(n->m_payload); // key may have been moved from
+			}
+			n->m_next = cur;
+			link* oldCur = cur;
+			if (atomic::compare_exchange(*prev, static_cast<link*>(n), oldCur))
+				break;
+		}
+		inserted = true;
+		volatile size_t& count = m_count;
+		size_t newCount = pre_assign_next(count);
+		size_t bucketCount = atomic::load(m_bucketCount);
+		if ((newCount > bucketCount * COGS_HASH_TABLE_LOAD_FACTOR) && (bucketCount < max_bucket_count))
+			atomic::compare_exchange(m_bucketCount, bucketCount * 2, bucketCount);
+		return n;
+	}
+
+	template <bool is_volatile>
+	node* find_inner(const key_t& key)
+	{
+		size_t hash = hasher_t::get_hash(key);
+		link** prev;
+		link* cur;
+		if (search<is_volatile>(find_bucket(get_bucket_index(hash)), reverse_bits(hash) | 1, &key, prev, cur))
+			return static_cast<node*>(cur);
+		return nullptr;
+	}
+
+	template <bool is_volatile>
+	bool remove_inner(const key_t& key)
+	{
+		size_t hash = hasher_t::get_hash(key);
+		size_t order = reverse_bits(hash) | 1;
+		link* start = find_bucket(get_bucket_index(hash));
+		link** prev;
+		link* cur;
+		for (;;)
+		{
+			if (!search<is_volatile>(start, order, &key, prev, cur))
+				return false;
+			link* next = atomic::load(cur->m_next);
+			if (is_marked(next))
+				continue;
+			if constexpr (!is_volatile)
+			{
+				*prev = next;
+				dispose_removed<false>(cur);
+				break;
+			}
+			else
+			{
+				// Marking the node removes it.  Whichever thread then unlinks it, disposes of it.
+				link* oldNext = next;
+				if (!atomic::compare_exchange(cur->m_next, get_marked(next), oldNext))
+					continue;
+				link* oldCur = cur;
+				if (atomic::compare_exchange(*prev, next, oldCur))
+					dispose_removed<true>(cur);
+				else
+					search<true>(start, order, &key, prev, cur);
+				break;
+			}
+		}
+		volatile size_t& count = m_count;
+		assign_prev(count);
+		return true;
+	}
+
+	template <typename F>
+	void for_each_inner(F&& f)
+	{
+		for (link* l = get_unmarked(atomic::load(m_head.m_next)); !!l;)
+		{
+			link* next = atomic::load(l->m_next);
+			if (l->is_element() && !is_marked(next))
+				f(static_cast<node*>(l)->m_payload);
+			l = get_unmarked(next);
+		}
+	}
+
+	void clear_inner()
+	{
+		link* l = m_head.m_next;
+		while (!!l)
+		{
+			link* next = get_unmarked(l->m_next);
+			if (l->is_element())
+				dispose_node(l);
+			else
+				memory_manager_t::destruct_deallocate_type(l);
+			l = next;
+		}
+		m_head.m_next = nullptr;
+		for (size_t i = 0; i < segment_count; i++)
+		{
+			if (!!m_segments[i])
+			{
+				memory_manager_t::destruct_deallocate_type(m_segments[i], get_segment_size(i));
+				m_segments[i] = nullptr;
+			}
+		}
+		m_count = 0;
+	}
+
+	this_t* get_nonvolatile() const volatile { return const_cast<this_t*>(this); }
+
+public:
+	class iterator
+	{
+	private:
+		link* m_link;
+
+		explicit iterator(link* l)
+			: m_link(l)
+		{
+			skip_sentinels();
+		}
+
+		void skip_sentinels()
+		{
+			while (!!m_link && !m_link->is_element())
+				m_link = m_link->m_next;
+		}
+
+		friend class hash_table;
+
+	public:
+		iterator() : m_link(nullptr) { }
+
+		bool operator==(const iterator& i) const { return m_link == i.m_link; }
+		bool operator!=(const iterator& i) const { return m_link != i.m_link; }
+
+		iterator& operator++()
+		{
+			if (!!m_link)
+			{
+				m_link = m_link->m_next;
+				skip_sentinels();
+			}
+			return *this;
+		}
+
+		iterator operator++(int)
+		{
+			iterator result(*this);
+			++*this;
+			return result;
+		}
+
+		payload_t& operator*() const { return static_cast<node*>(m_link)->m_payload; }
+		payload_t* operator->() const { return &static_cast<node*>(m_link)->m_payload; }
+		payload_t* get() const { return !m_link ? nullptr : &static_cast<node*>(m_link)->m_payload; }
+	};
+
+	/// @brief Constructor
+	/// @param initialBuckets The initial number of buckets.  Rounded up to a power of 2.
+	explicit hash_table(size_t initialBuckets = COGS_HASH_TABLE_INITIAL_BUCKETS)
+		: m_head(0),
+		m_count(0)
+	{
+		size_t bucketCount = 2;
+		while ((bucketCount < initialBuckets) && (bucketCount < max_bucket_count))
+			bucketCount <<= 1;
+		m_bucketCount = bucketCount;
+		for (size_t i = 0; i < segment_count; i++)
+			m_segments[i] = nullptr;
+	}
+
+	hash_table(this_t&& src)
+		: hash_table(2)
+	{
+		swap(src);
+	}
+
+	~hash_table() { clear_inner(); }
+
+	this_t& operator=(this_t&& src)
+	{
+		this_t tmp(std::move(src));
+		swap(tmp);
+		return *this;
+	}
+
+	void swap(this_t& wth)
+	{
+		std::swap(m_head.m_next, wth.m_head.m_next);
+		for (size_t i = 0; i < segment_count; i++)
+			std::swap(m_segments[i], wth.m_segments[i]);
+		std::swap(m_bucketCount, wth.m_bucketCount);
+		std::swap(m_count, wth.m_count);
+	}
+
+	void clear() { clear_inner(); }
+
+	size_t size() const { return m_count; }
+	size_t size() const volatile { return atomic::load(get_nonvolatile()->m_count); }
+
+	bool is_empty() const { return !m_count; }
+	bool is_empty() const volatile { return !size(); }
+
+	size_t get_bucket_count() const { return m_bucketCount; }
+	size_t get_bucket_count() const volatile { return atomic::load(get_nonvolatile()->m_bucketCount); }
+
+	/// @brief Inserts a payload constructed from args, if no payload with an equal key is present
+	/// @param key The key of the payload to be inserted
+	/// @param[out] inserted Set to true if the payload was inserted, or false if an existing payload was found
+	/// @return The inserted payload, or the existing payload with an equal key
+	template <typename... args_t>
+	payload_t& insert_unique_emplace(const key_t& key, bool& inserted, args_t&&... args)
+	{
+		return insert_unique_inner<false>(key, inserted, std::forward<args_t>(args)...)->m_payload;
+	}
+
+	/// @brief Thread-safe implementation of insert_unique_emplace()
+	/// @return True if the payload was inserted, false if a payload with an equal key was already present
+	template <typename... args_t>
+	bool insert_unique_emplace(const key_t& key, args_t&&... args) volatile
+	{
+		bool inserted;
+		epoch::guard g;
+		get_nonvolatile()->template insert_unique_inner<true>(key, inserted, std::forward<args_t>(args)...);
+		return inserted;
+	}
+
+	/// @brief Finds the payload with a key equal to the specified key
+	/// @return A pointer to the payload, or nullptr if not found
+	payload_t* find(const key_t& key) const
+	{
+		node* n = get_nonvolatile()->template find_inner<false>(key);
+		return !n ? nullptr : &n->m_payload;
+	}
+
+	/// @brief Thread-safe implementation of find().  Passes the payload to f, if found.
+	///
+	/// The payload may be removed by another thread while f is being called, but will not be disposed.
+	/// @return True if a payload with a key equal to the specified key was found
+	template <typename F>
+	bool find(const key_t& key, F&& f) const volatile
+	{
+		epoch::guard g;
+		node* n = get_nonvolatile()->template find_inner<true>(key);
+		if (!n)
+			return false;
+		f(const_cast<const payload_t&>(n->m_payload));
+		return true;
+	}
+
+	bool contains(const key_t& key) const { return !!find(key); }
+
+	bool contains(const key_t& key) const volatile
+	{
+		epoch::guard g;
+		return !!get_nonvolatile()->template find_inner<true>(key);
+	}
+
+	/// @brief Removes the payload with a key equal to the specified key
+	/// @return True if a payload was removed
+	bool remove(const key_t& key) { return remove_inner<false>(key); }
+
+	/// @brief Thread-safe implementation of remove()
+	bool remove(const key_t& key) volatile
+	{
+		epoch::guard g;
+		return get_nonvolatile()->template remove_inner<true>(key);
+	}
+
+	void remove(const iterator& i) { remove(get_key(*i)); }
+
+	/// @brief Calls f with each payload
+	template <typename F>
+	void for_each(F&& f) const
+	{
+		get_nonvolatile()->for_each_inner([&](payload_t& p) { f(const_cast<const payload_t&>(p)); });
+	}
+
+	/// @brief Thread-safe implementation of for_each().
+	///
+	/// Payloads inserted or removed by other threads during the traversal may or may not be included.
+	template <typename F>
+	void for_each(F&& f) const volatile
+	{
+		epoch::guard g;
+		get_nonvolatile()->for_each_inner([&](payload_t& p) { f(const_cast<const payload_t&>(p)); });
+	}
+
+	iterator begin() const { return iterator(m_head.m_next); }
+	iterator end() const { return iterator(); }
+};
+
+
+}
+
+
+#endif
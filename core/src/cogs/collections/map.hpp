@@ -1291,9 +1291,10 @@ public:
 	{ }
 
 	nonvolatile_map(const this_t& src)
+		: m_count(0)
 	{
 		for (const auto& entry : src)
-			insert_replace(entry.m_key, entry.m_value);
+			insert_replace(entry.key, entry.value);
 	}
 
 	~nonvolatile_map()
@@ -1313,9 +1314,13 @@ public:
 
 	this_t& operator=(const this_t& src)
 	{
-		clear();
-		for (const auto& entry : src)
-			insert_replace(entry.m_key, entry.m_value);
+		if (this != &src)
+		{
+			clear();
+			for (const auto& entry : src)
+				insert_replace(entry.key, entry.value);
+		}
+		return *this;
 	}
 
 	this_t& operator=(const volatile this_t&) = delete;
@@ -1642,9 +1642,9 @@ inline cstring fixed_integer_native_const<has_sign, bits, value>::to_cstring(uin
 }
 
 
-template <typename type>
+template <typename type, size_t inline_n>
 template <typename char_t>
-inline string_t<char_t> vector<type>::to_string_t(const string_t<char_t>& prefix, const string_t<char_t>& delimiter, const string_t<char_t>& postfix) const
+inline string_t<char_t> vector<type, inline_n>::to_string_t(const string_t<char_t>& prefix, const string_t<char_t>& delimiter, const string_t<char_t>& postfix) const
 {
 	string str = prefix;
 	size_t sz = get_length();
@@ -1664,22 +1664,22 @@ inline string_t<char_t> vector<type>::to_string_t(const string_t<char_t>& prefix
 	return str;
 }
 
-template <typename type>
-inline string vector<type>::to_string(const string& prefix, const string& delimiter, const string& postfix) const
+template <typename type, size_t inline_n>
+inline string vector<type, inline_n>::to_string(const string& prefix, const string& delimiter, const string& postfix) const
 {
 	return to_string_t<wchar_t>(prefix, delimiter, postfix);
 }
 
-template <typename type>
-inline cstring vector<type>::to_cstring(const cstring& prefix, const cstring& delimiter, const cstring& postfix) const
+template <typename type, size_t inline_n>
+inline cstring vector<type, inline_n>::to_cstring(const cstring& prefix, const cstring& delimiter, const cstring& postfix) const
 {
 	return to_string_t<char>(prefix, delimiter, postfix);
 }
 
 
-template <typename type>
+template <typename type, size_t inline_n>
 template <typename char_t>
-inline string_t<char_t> vector<type>::to_string_t() const
+inline string_t<char_t> vector<type, inline_n>::to_string_t() const
 {
 	class string_helper
 	{
@@ -1702,33 +1702,33 @@ inline string_t<char_t> vector<type>::to_string_t() const
 	return to_string_t<char>(helper::get_prefix(), helper::get_delimiter(), helper::get_postfix());
 }
 
-template <typename type>
-inline string vector<type>::to_string() const { return to_string_t<wchar_t>(); }
+template <typename type, size_t inline_n>
+inline string vector<type, inline_n>::to_string() const { return to_string_t<wchar_t>(); }
 
-template <typename type>
-inline cstring vector<type>::to_cstring() const { return to_string_t<char>(); }
+template <typename type, size_t inline_n>
+inline cstring vector<type, inline_n>::to_cstring() const { return to_string_t<char>(); }
 
 
-template <typename type>
+template <typename type, size_t inline_n>
 template <typename char_t>
-inline string_t<char_t> vector<type>::to_string_t(const string_t<char_t>& prefix, const string_t<char_t>& delimiter, const string_t<char_t>& postfix) const volatile { vector<type> cpy(*this); return cpy.template to_string_t<char_t>(prefix, delimiter, postfix); }
+inline string_t<char_t> vector<type, inline_n>::to_string_t(const string_t<char_t>& prefix, const string_t<char_t>& delimiter, const string_t<char_t>& postfix) const volatile { vector<type, inline_n> cpy(*this); return cpy.template to_string_t<char_t>(prefix, delimiter, postfix); }
 
-template <typename type>
-inline string vector<type>::to_string(const string& prefix, const string& delimiter, const string& postfix) const volatile { vector<type> cpy(*this); return cpy.to_string(prefix, delimiter, postfix); }
+template <typename type, size_t inline_n>
+inline string vector<type, inline_n>::to_string(const string& prefix, const string& delimiter, const string& postfix) const volatile { vector<type, inline_n> cpy(*this); return cpy.to_string(prefix, delimiter, postfix); }
 
-template <typename type>
-inline cstring vector<type>::to_cstring(const cstring& prefix, const cstring& delimiter, const cstring& postfix) const volatile { vector<type> cpy(*this); return cpy.to_cstring(prefix, delimiter, postfix); }
+template <typename type, size_t inline_n>
+inline cstring vector<type, inline_n>::to_cstring(const cstring& prefix, const cstring& delimiter, const cstring& postfix) const volatile { vector<type, inline_n> cpy(*this); return cpy.to_cstring(prefix, delimiter, postfix); }
 
 
-template <typename type>
+template <typename type, size_t inline_n>
 template <typename char_t>
-inline string_t<char_t> vector<type>::to_string_t() const volatile { vector<type> cpy(*this); return cpy.template to_string_t<char_t>(); }
+inline string_t<char_t> vector<type, inline_n>::to_string_t() const volatile { vector<type, inline_n> cpy(*this); return cpy.template to_string_t<char_t>(); }
 
-template <typename type>
-inline string vector<type>::to_string() const volatile { vector<type> cpy(*this); return cpy.to_string(); }
+template <typename type, size_t inline_n>
+inline string vector<type, inline_n>::to_string() const volatile { vector<type, inline_n> cpy(*this); return cpy.to_string(); }
 
-template <typename type>
-inline cstring vector<type>::to_cstring() const volatile { vector<type> cpy(*this); return cpy.to_cstring(); }
+template <typename type, size_t inline_n>
+inline cstring vector<type, inline_n>::to_cstring() const volatile { vector<type, inline_n> cpy(*this); return cpy.to_cstring(); }
 
 
 }
@@ -8,6 +8,7 @@
 #ifndef COGS_HEADER_COLLECTION_VECTOR
 #define COGS_HEADER_COLLECTION_VECTOR
 
+#include <cstring>
 #include <type_traits>
 #include <compare>
 
@@ -238,12 +239,43 @@ public:
 	}
 };
 
-// vector_content is an internal helper class containing the contents of a vector.
+// Storage for up to inline_n elements within a vector_content, used in place of a vector_descriptor
+template <typename type, size_t inline_n>
+class vector_inline_storage
+{
+private:
+	static_assert(std::is_trivially_copyable_v<type>);
+
+	alignas(type) unsigned char m_inlineStorage[sizeof(type) * inline_n];
+
+public:
+	type* get_inline_ptr() const { return const_cast<type*>(reinterpret_cast<const type*>(m_inlineStorage)); }
+
+	bool is_inline_ptr(const type* p) const
+	{
+		const type* start = get_inline_ptr();
+		return (p >= start) && (p <= start + inline_n);
+	}
+};
+
 template <typename type>
-class vector_content
+class vector_inline_storage<type, 0>
 {
 public:
-	typedef vector_content<type> this_t;
+	type* get_inline_ptr() const { return nullptr; }
+	bool is_inline_ptr(const type*) const { return false; }
+};
+
+// vector_content is an internal helper class containing the contents of a vector.
+//
+// If inline_n is non-zero, contents of up to inline_n elements are stored within the vector_content, without
+// a descriptor.  Inline contents are owned, and are copied along with the vector_content, so are not shared.
+// Only trivially copyable types may be stored inline.
+template <typename type, size_t inline_n = 0>
+class vector_content : public vector_inline_storage<type, inline_n>
+{
+public:
+	typedef vector_content<type, inline_n> this_t;
 	typedef vector_descriptor<type> desc_t;
 
 	type* m_ptr;
@@ -265,39 +297,29 @@ public:
 
 	vector_content(this_t&& src)
 	{
-		m_ptr = src.m_ptr;
-		m_desc = src.m_desc;
-		m_length = src.m_length;
+		set(src);
 		src.clear_inner();
 	}
 
 	this_t& operator=(this_t&& src)
 	{
-		clear();
-		m_ptr = src.m_ptr;
-		m_desc = src.m_desc;
-		m_length = src.m_length;
+		release();
+		set(src);
 		src.clear_inner();
 		return *this;
 	}
 
 	vector_content(const this_t& src) // does not acquire
-		: m_ptr(src.m_ptr),
-		m_desc(src.m_desc),
-		m_length(src.m_length)
-	{ }
+	{
+		set(src);
+	}
 
 	vector_content(const this_t& src, size_t i) // does not acquire
 	{
 		if (i >= src.m_length)
 			clear_inner();
 		else
-		{
-			size_t remainingSpace = src.m_length - i;
-			m_desc = src.m_desc;
-			m_length = remainingSpace;
-			m_ptr = src.m_ptr + i;
-		}
+			set(src, i, src.m_length - i);
 	}
 
 	vector_content(const this_t& src, size_t i, size_t n) // does not acquire
@@ -309,9 +331,7 @@ public:
 			size_t remainingSpace = src.m_length - i;
 			if (n > remainingSpace)
 				n = remainingSpace;
-			m_desc = src.m_desc;
-			m_length = n;
-			m_ptr = src.m_ptr + i;
+			set(src, i, n);
 		}
 	}
 
@@ -338,14 +358,31 @@ public:
 
 	this_t& operator=(const this_t& src) // does not acquire
 	{
-		m_ptr = src.m_ptr;
-		m_desc = src.m_desc;
-		m_length = src.m_length;
+		set(src);
 		return *this;
 	}
 
+	// True if contents are stored inline, within this vector_content
+	bool is_inline() const
+	{
+		if constexpr (inline_n > 0)
+			return !m_desc && this->is_inline_ptr(m_ptr);
+		else
+			return false;
+	}
+
+	// True if the buffer is not shared, and may be modified in place
+	bool is_owned() const
+	{
+		if (!!m_desc)
+			return m_desc->is_owned();
+		return is_inline();
+	}
+
 	size_t get_capacity() const
 	{
+		if (is_inline())
+			return inline_n - (m_ptr - this->get_inline_ptr());
 		if (!m_desc || (!m_desc->is_owned()))
 			return 0;
 		return m_desc->get_capacity_after(m_ptr);
@@ -353,11 +390,33 @@ public:
 
 	size_t get_reverse_capacity() const
 	{
+		if (is_inline())
+			return m_ptr - this->get_inline_ptr();
 		if (!m_desc || (!m_desc->is_owned()))
 			return 0;
 		return m_desc->get_capacity_before(m_ptr);
 	}
 
+	// Returns true if the buffer is owned and can hold n elements, extending it in place if necessary
+	bool try_reallocate(size_t n)
+	{
+		if (!!m_desc)
+			return m_desc->is_owned() && m_desc->try_reallocate(n);
+		return is_inline() && (n <= inline_n);
+	}
+
+	// Only call if is_owned()
+	type* get_base() const { return !!m_desc ? m_desc->get_base() : this->get_inline_ptr(); }
+
+	// Only call if is_owned()
+	size_t get_full_capacity() const { return !!m_desc ? m_desc->get_capacity() : inline_n; }
+
+	void set_constructed_range(type* p, size_t n)
+	{
+		if (!!m_desc)
+			m_desc->set_constructed_range(p, n);
+	}
+
 	void set(desc_t* desc, type* p, size_t n)
 	{
 		m_desc = desc;
@@ -365,15 +424,36 @@ public:
 		m_length = n;
 	}
 
-	void set(const this_t& src)
+	void set(const this_t& src) { set(src, 0, src.m_length); }
+
+	// Refers to n elements of src, starting at index i.  Does not acquire.
+	// Inline elements are copied.
+	void set(const this_t& src, size_t i, size_t n)
 	{
 		m_desc = src.m_desc;
-		m_ptr = src.m_ptr;
-		m_length = src.m_length;
+		m_length = n;
+		if constexpr (inline_n > 0)
+		{
+			if (src.is_inline())
+			{
+				m_ptr = this->get_inline_ptr() + (src.m_ptr - src.get_inline_ptr()) + i;
+				if (this != &src)
+					memcpy((void*)m_ptr, (const void*)(src.m_ptr + i), n * sizeof(type));
+				return;
+			}
+		}
+		m_ptr = src.m_ptr + i;
 	}
 
 	void swap(this_t& wth)
 	{
+		if constexpr (inline_n > 0)
+		{
+			this_t tmp(*this);
+			set(wth);
+			wth.set(tmp);
+			return;
+		}
 		type* p = m_ptr;
 		m_ptr = wth.m_ptr;
 		wth.m_ptr = p;
@@ -389,6 +469,13 @@ public:
 
 	void exchange(const this_t& src, this_t& rtn)
 	{
+		if constexpr (inline_n > 0)
+		{
+			this_t tmp(*this);
+			set(src);
+			rtn.set(tmp);
+			return;
+		}
 		type* p = m_ptr;
 		m_ptr = src.m_ptr;
 		rtn.m_ptr = p;
@@ -411,9 +498,7 @@ public:
 	void acquire(const this_t& src)
 	{
 		desc_t* oldDesc = m_desc;
-		m_desc = src.m_desc;
-		m_ptr = src.m_ptr;
-		m_length = src.m_length;
+		set(src);
 		if (m_desc != oldDesc)
 		{
 			acquire();
@@ -431,10 +516,7 @@ public:
 				clear_inner();
 			else
 			{
-				size_t remainingSpace = src.m_length - i;
-				m_desc = src.m_desc;
-				m_length = remainingSpace;
-				m_ptr = src.m_ptr + i;
+				set(src, i, src.m_length - i);
 				if (m_desc == oldDesc)
 					break;
 				acquire();
@@ -457,9 +539,7 @@ public:
 				size_t remainingSpace = src.m_length - i;
 				if (n > remainingSpace)
 					n = remainingSpace;
-				m_desc = src.m_desc;
-				m_length = n;
-				m_ptr = src.m_ptr + i;
+				set(src, i, n);
 				if (m_desc == oldDesc)
 					break;
 				acquire();
@@ -505,6 +585,15 @@ public:
 	// Does not construct.
 	void allocate_inner(size_t n)
 	{
+		if constexpr (inline_n > 0)
+		{
+			if (n <= inline_n)
+			{
+				m_desc = 0;
+				m_ptr = this->get_inline_ptr();
+				return;
+			}
+		}
 		desc_t* newDesc = desc_t::allocate(n).get_ptr();
 		m_desc = newDesc;
 		m_ptr = newDesc->get_ptr();
@@ -550,17 +639,17 @@ public:
 		if (!!n)
 		{
 			desc_t* oldDesc = m_desc;
-			if (!!oldDesc && oldDesc->is_owned() && oldDesc->try_reallocate(n))
+			if (try_reallocate(n))
 			{
 				trim_lingering();
-				type* trueBase = oldDesc->get_base();
+				type* trueBase = get_base();
 				size_t gap = m_ptr - trueBase;
-				size_t stationaryCapacity = oldDesc->get_capacity() - gap;
+				size_t stationaryCapacity = get_full_capacity() - gap;
 				if (n > stationaryCapacity)
 				{
 					placement_move(trueBase, m_ptr, m_length);
 					m_ptr = trueBase;
-					oldDesc->set_constructed_range(m_ptr, m_length);
+					set_constructed_range(m_ptr, m_length);
 				}
 			}
 			else
@@ -674,18 +763,18 @@ public:
 		size_t oldLength = m_length;
 		size_t newLength = n + oldLength;
 		desc_t* oldDesc = m_desc;
-		if (!!oldDesc && oldDesc->is_owned() && oldDesc->try_reallocate(newLength))
+		if (try_reallocate(newLength))
 		{
 			trim_lingering();
-			type* trueBase = oldDesc->get_base();
+			type* trueBase = get_base();
 			size_t gap = m_ptr - trueBase;
-			size_t stationaryCapacity = oldDesc->get_capacity() - gap;
-			if (n > stationaryCapacity)
+			size_t stationaryCapacity = get_full_capacity() - gap;
+			if (newLength > stationaryCapacity)
 			{
 				placement_move(trueBase, m_ptr, oldLength);
 				m_ptr = trueBase;
 			}
-			oldDesc->set_constructed_range(m_ptr, newLength);
+			set_constructed_range(m_ptr, newLength);
 		}
 		else
 		{
@@ -773,10 +862,10 @@ public:
 		size_t oldLength = m_length;
 		size_t newLength = n + oldLength;
 		desc_t* oldDesc = m_desc;
-		if (!!oldDesc && oldDesc->is_owned() && oldDesc->try_reallocate(newLength))
+		if (try_reallocate(newLength))
 		{
 			trim_lingering();
-			type* trueBase = oldDesc->get_base();
+			type* trueBase = get_base();
 			size_t gap = m_ptr - trueBase;
 			if (n <= gap)
 				m_ptr -= n;
@@ -785,7 +874,7 @@ public:
 				placement_move(trueBase + n, m_ptr, oldLength);
 				m_ptr = trueBase;
 			}
-			oldDesc->set_constructed_range(m_ptr, newLength);
+			set_constructed_range(m_ptr, newLength);
 		}
 		else
 		{
@@ -870,7 +959,7 @@ public:
 		{
 			reserve(n);
 			placement_construct_multiple(m_ptr, n, src);
-			m_desc->set_constructed_range(m_ptr, n);
+			set_constructed_range(m_ptr, n);
 		}
 		m_length = n;
 	}
@@ -886,7 +975,7 @@ public:
 			if (lastPosition != 0)
 				placement_construct_multiple(m_ptr, lastPosition, src);
 			placement_construct(m_ptr + lastPosition, std::forward<type2>(src));
-			m_desc->set_constructed_range(m_ptr, n);
+			set_constructed_range(m_ptr, n);
 		}
 		m_length = n;
 	}
@@ -899,14 +988,14 @@ public:
 		{
 			reserve(n);
 			placement_copy_construct_array(m_ptr, src, n);
-			m_desc->set_constructed_range(m_ptr, n);
+			set_constructed_range(m_ptr, n);
 		}
 		m_length = n;
 	}
 
 	void copy_on_write()
 	{
-		if (!!m_length && (!m_desc || !m_desc->is_owned()))
+		if (!!m_length && !is_owned())
 		{
 			desc_t* oldDesc = m_desc;
 			type* oldPtr = m_ptr;
@@ -927,7 +1016,7 @@ public:
 		size_t secondSegmentLength = forwardLength - replaceLength;
 		size_t newLength = (m_length - replaceLength) + n;
 		desc_t* oldDesc = m_desc;
-		if (!!oldDesc && oldDesc->is_owned() && oldDesc->try_reallocate(newLength))
+		if (try_reallocate(newLength))
 		{
 			trim_lingering();
 			type* pastFirstSegment = m_ptr + i;
@@ -936,13 +1025,13 @@ public:
 				placement_move(pastFirstSegment + n, pastFirstSegment + replaceLength, secondSegmentLength);
 			else if (n > replaceLength)
 			{
-				type* trueBase = oldDesc->get_base();
+				type* trueBase = get_base();
 				size_t startGap = m_ptr - trueBase;
 
 				size_t growingBy = n - replaceLength;
 				bool leadingLargeEnough = growingBy <= startGap;
 
-				size_t stationaryCapacity = oldDesc->get_capacity() - startGap;
+				size_t stationaryCapacity = get_full_capacity() - startGap;
 				bool trailingLargeEnough = newLength <= stationaryCapacity;
 
 				type* src = m_ptr;
@@ -976,19 +1065,19 @@ public:
 					m_ptr = trueBase;
 				}
 
-				if (shiftForward) // Just need to scoot secondSegment forward a bit.
-					placement_move(pastFirstSegment + n, pastFirstSegment + replaceLength, secondSegmentLength);
 				if (shiftBack)
 					placement_move(m_ptr, src, i);
+				if (shiftForward) // Just need to scoot secondSegment forward a bit.
+					placement_move(m_ptr + i + n, pastFirstSegment + replaceLength, secondSegmentLength);
 			}
-			oldDesc->set_constructed_range(m_ptr, newLength);
+			set_constructed_range(m_ptr, newLength);
 		}
 		else
 		{
 			type* oldPtr = m_ptr;
 			allocate_inner(newLength); // a reallocation was necessary.
 			placement_copy_construct_array(m_ptr, oldPtr, i);
-			placement_copy_construct_array(m_ptr + n, oldPtr + replaceLength, secondSegmentLength);
+			placement_copy_construct_array(m_ptr + i + n, oldPtr + i + replaceLength, secondSegmentLength);
 			if (!!oldDesc)
 				oldDesc->release();
 		}
@@ -1532,8 +1621,13 @@ public:
 /// will be destructed.  If the buffer is shared, removed elements will not be destructed because they
 /// may be referenced by another vector<>.  It's possible for unreachable elements to linger until
 /// its buffer is no longer referenced.
+///
+/// If inline_n is non-zero, up to inline_n elements are stored within the vector itself, without
+/// allocating a buffer.  Inline elements are copied along with the vector, rather than shared.
+/// Only trivially copyable types may be stored inline.
 /// @tparam T type to contain
-template <typename T>
+/// @tparam inline_n Number of elements that may be stored inline.  Default: 0
+template <typename T, size_t inline_n = 0>
 class vector
 {
 private:
@@ -1546,17 +1640,17 @@ private:
 
 public:
 	typedef T type;
-	typedef vector<type> this_t;
+	typedef vector<type, inline_n> this_t;
 
 protected:
-	template <typename>
+	template <typename, size_t>
 	friend class vector;
 
 	friend class io::composite_buffer_content;
 	friend class io::buffer;
 
 	typedef vector_descriptor<type> desc_t;
-	typedef vector_content<type> content_t;
+	typedef vector_content<type, inline_n> content_t;
 	typedef transactable<content_t> transactable_t;
 	transactable_t m_contents;
 
@@ -1918,15 +2012,15 @@ public:
 		return *this;
 	}
 
-	bool is_unowned() const { return !!m_contents->m_length && !m_contents->m_desc; }
-	bool is_unowned() const volatile { read_token rt; m_contents.begin_read(rt); return !!rt->m_length && !rt->m_desc; }
+	bool is_unowned() const { return !!m_contents->m_length && !m_contents->m_desc && !m_contents->is_inline(); }
+	bool is_unowned() const volatile { read_token rt; m_contents.begin_read(rt); return !!rt->m_length && !rt->m_desc && !rt->is_inline(); }
 
-	bool is_owned() const { return !!m_contents->m_length && !!m_contents->m_desc && m_contents->m_desc->is_owned(); }
+	bool is_owned() const { return !!m_contents->m_length && m_contents->is_owned(); }
 	bool is_owned() const volatile
 	{
 		read_token rt;
 		m_contents.guarded_begin_read(rt);
-		bool result = !!rt->m_length && !!rt->m_desc && rt->m_desc->is_owned();
+		bool result = !!rt->m_length && rt->is_owned();
 		rt->release();
 		return result;
 	}
@@ -1971,7 +2065,7 @@ public:
 			size_t adjustedLength = length - i;
 			if (adjustedLength > n)
 				adjustedLength = n;
-			storage.set(m_contents->m_desc, m_contents->m_ptr + i, adjustedLength);
+			storage.m_contents->set(*m_contents, i, adjustedLength);
 		}
 		return storage;
 	}
@@ -2373,7 +2467,7 @@ public:
 		m_contents.set(content_t(src, n));
 	}
 
-	void assign(const vector<type>& src)
+	void assign(const this_t& src)
 	{
 		if (this != &src)
 		{
@@ -2778,8 +2872,7 @@ public:
 			{
 				guarded_begin_write(wt);
 				desc = wt->m_desc; // acquired, regardless of whether the commit succeeds.
-				result.m_contents->m_desc = desc;
-				result.m_contents->m_ptr = wt->m_ptr;
+				result.m_contents->set(*wt);
 				size_t length = wt->m_length;
 				if (i >= length)
 				{
@@ -2832,14 +2925,13 @@ public:
 				size_t length = wt->m_length;
 				if (i >= length) // nop.  If nothing to split off back, we don't need to write at all.
 				{
-					result.m_ptr = 0;
-					result.m_length = 0;
+					result.m_contents->clear_inner();
 					if (desc) // Release our copy from guard
 						desc->release();
 					break;
 				}
 				size_t remainingLength = length - i;
-				result.set(desc, wt->m_ptr + i, remainingLength);
+				result.m_contents->set(*wt, i, remainingLength);
 				wt->m_length = i;
 				if (!!m_contents.end_write(wt))
 					break;
@@ -2847,8 +2939,8 @@ public:
 					desc->release();
 				result.m_contents->m_desc = 0;
 			}
-			return result;
 		}
+		return result;
 	}
 
 	this_t split_off_front(size_t n) { return split_off_before(n); }
@@ -2885,8 +2977,7 @@ public:
 			{
 				guarded_begin_write(wt);
 				desc = wt->m_desc; // acquired, regardless of whether the commit succeeds.
-				result.m_contents->m_ptr = wt->m_ptr;
-				result.m_contents->m_desc = desc;
+				result.m_contents->set(*wt);
 				size_t length = wt->m_length;
 				if (n >= length)
 				{
@@ -0,0 +1,120 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_COLLECTION_WORK_STEALING_DEQUE
+#define COGS_HEADER_COLLECTION_WORK_STEALING_DEQUE
+
+#include <type_traits>
+
+#include "cogs/env.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup LockFreeCollections
+/// @brief A fixed-capacity work-stealing deque (Chase-Lev).
+///
+/// A work_stealing_deque has a single owner thread, which may push and pop elements at the bottom.
+/// Any thread may steal elements from the top.  The owner operates in LIFO order without contention,
+/// and only contends with thieves over the last remaining element.  Thieves operate in FIFO order.
+///
+/// The capacity is fixed, so no reclamation of a grown array is needed.  push() fails if the deque is full.
+/// @tparam T Element type.  Must be trivially copyable, and is intended to be a pointer.
+/// @tparam capacity Maximum number of elements.  Must be a power of 2.
+template <typename T, size_t capacity>
+class work_stealing_deque
+{
+private:
+	static_assert(std::is_trivially_copyable_v<T>);
+	static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+	static constexpr size_t mask = capacity - 1;
+
+	// m_top is modified by thieves, and m_bottom only by the owner.  Keep them on separate cache lines.
+	alignas(64) ptrdiff_t m_top;
+	alignas(64) ptrdiff_t m_bottom;
+	alignas(64) T m_slots[capacity];
+
+	work_stealing_deque(work_stealing_deque&&) = delete;
+	work_stealing_deque(const work_stealing_deque&) = delete;
+	work_stealing_deque& operator=(work_stealing_deque&&) = delete;
+	work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+public:
+	work_stealing_deque()
+		: m_top(0),
+		m_bottom(0)
+	{ }
+
+	/// @brief Adds an element to the bottom.  Must only be called by the owner thread.
+	/// @return False if the deque is full
+	bool push(const T& t)
+	{
+		ptrdiff_t b = atomic::load(m_bottom);
+		ptrdiff_t top = atomic::load(m_top);
+		if (b - top >= (ptrdiff_t)capacity)
+			return false;
+		atomic::store(m_slots[b & mask], t);
+		atomic::store(m_bottom, b + 1);
+		return true;
+	}
+
+	/// @brief Removes the element at the bottom (most recently pushed).  Must only be called by the owner thread.
+	/// @param[out] t Receives the element
+	/// @return False if the deque was empty
+	bool pop(T& t)
+	{
+		ptrdiff_t b = atomic::load(m_bottom) - 1;
+		atomic::store(m_bottom, b);
+		ptrdiff_t top = atomic::load(m_top);
+		if (top > b)
+		{
+			atomic::store(m_bottom, b + 1);
+			return false;
+		}
+		atomic::load(m_slots[b & mask], t);
+		if (top == b)
+		{
+			// Last element.  Race any thieves for it.
+			bool result = atomic::compare_exchange(m_top, top + 1, top);
+			atomic::store(m_bottom, b + 1);
+			return result;
+		}
+		return true;
+	}
+
+	/// @brief Removes the element at the top (least recently pushed).  May be called by any thread.
+	/// @param[out] t Receives the element
+	/// @return False if the deque was empty, or if another thread removed the element concurrently
+	bool steal(T& t)
+	{
+		ptrdiff_t top = atomic::load(m_top);
+		ptrdiff_t b = atomic::load(m_bottom);
+		if (top >= b)
+			return false;
+		atomic::load(m_slots[top & mask], t);
+		return atomic::compare_exchange(m_top, top + 1, top);
+	}
+
+	/// @brief Tests whether the deque appears empty.  May be called by any thread.
+	bool is_empty() const
+	{
+		ptrdiff_t top = atomic::load(m_top);
+		ptrdiff_t b = atomic::load(m_bottom);
+		return top >= b;
+	}
+};
+
+
+}
+
+
+#endif
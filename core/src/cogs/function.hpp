@@ -267,7 +267,12 @@ private:
 			if (m_size <= n)
 				((block_base*)&m_buffer)->~block_base();
 			else
-				default_memory_manager::destruct_deallocate_type(*(block_base**)&m_buffer);
+			{
+				// Destruct via the virtual destructor.  destruct_deallocate_type() would only destruct the block_base.
+				block_base* blk = *(block_base**)&m_buffer;
+				blk->~block_base();
+				default_memory_manager::deallocate(blk);
+			}
 		}
 	}
 
@@ -613,7 +618,12 @@ private:
 			if (m_size <= n)
 				((block_base*)&m_buffer)->~block_base();
 			else
-				default_memory_manager::destruct_deallocate_type(*(block_base**)&m_buffer);
+			{
+				// Destruct via the virtual destructor.  destruct_deallocate_type() would only destruct the block_base.
+				block_base* blk = *(block_base**)&m_buffer;
+				blk->~block_base();
+				default_memory_manager::deallocate(blk);
+			}
 		}
 	}
 
@@ -627,7 +637,7 @@ private:
 			new ((block<F_t>*)&m_buffer) block<F_t>(std::forward<F>(f));
 		else
 		{
-			block<F>* blk = default_memory_manager::allocate_type<block<F_t> >();
+			block<F_t>* blk = default_memory_manager::allocate_type<block<F_t> >();
 			*(block<F_t>**)&m_buffer = new (blk) block<F_t>(std::forward<F>(f));
 		}
 	}
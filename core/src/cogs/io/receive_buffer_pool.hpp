@@ -0,0 +1,244 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_IO_RECEIVE_BUFFER_POOL
+#define COGS_HEADER_IO_RECEIVE_BUFFER_POOL
+
+
+#include "cogs/io/buffer.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/mem/object.hpp"
+#include "cogs/operators.hpp"
+#include "cogs/sync/singleton.hpp"
+
+
+#ifndef COGS_RECEIVE_BUFFER_POOL_MAX_FREE
+
+/// @brief The maximum number of free slabs io::receive_buffer_pool retains per size class
+///
+/// Slabs released while a size class is already holding this many free slabs are returned to the memory manager.
+#define COGS_RECEIVE_BUFFER_POOL_MAX_FREE 64
+#endif
+
+
+namespace cogs {
+namespace io {
+
+
+/// @ingroup IO
+/// @brief A shared pool of receive slabs, in size classes of 4KB, 16KB, 64KB and 256KB.
+///
+/// Instead of allocating a buffer the size of the requested read up front, and holding it while waiting
+/// for data to arrive, a reader can wait for data, receive into a pooled slab, and keep only the bytes received.
+class receive_buffer_pool : public object
+{
+public:
+	static constexpr size_t size_class_count = 4;
+	static constexpr size_t min_slab_size = 4 * 1024;
+	static constexpr size_t max_slab_size = min_slab_size << ((size_class_count - 1) * 2);
+
+	static constexpr size_t get_slab_size(size_t sizeClass) { return min_slab_size << (sizeClass * 2); }
+
+	/// @brief Gets the smallest size class large enough to hold n bytes, or the largest size class.
+	static size_t get_size_class(size_t n)
+	{
+		size_t sizeClass = 0;
+		while ((sizeClass < size_class_count - 1) && (get_slab_size(sizeClass) < n))
+			sizeClass++;
+		return sizeClass;
+	}
+
+	/// @brief A slab acquired from a receive_buffer_pool.  Returned to the pool when destructed.
+	class slab
+	{
+	private:
+		receive_buffer_pool& m_pool;
+		const size_t m_sizeClass;
+		char* m_ptr;
+
+		slab() = delete;
+		slab(slab&&) = delete;
+		slab(const slab&) = delete;
+		slab& operator=(slab&&) = delete;
+		slab& operator=(const slab&) = delete;
+
+	public:
+		/// @brief Acquires a slab large enough to hold n bytes, or the largest slab size if n is larger.
+		slab(receive_buffer_pool& pool, size_t n)
+			: m_pool(pool),
+			m_sizeClass(get_size_class(n)),
+			m_ptr(pool.acquire(m_sizeClass))
+		{ }
+
+		~slab() { m_pool.release(m_ptr, m_sizeClass); }
+
+		char* get_ptr() const { return m_ptr; }
+		size_t get_size() const { return get_slab_size(m_sizeClass); }
+
+		/// @brief Copies the first n bytes of the slab into a new buffer of exactly that size.
+		buffer copy(size_t n) const { return buffer(m_ptr, n); }
+	};
+
+	/// @brief Counters describing pool occupancy and hit rate
+	struct stats
+	{
+		/// @brief Number of slabs acquired
+		size_t acquireCount;
+
+		/// @brief Number of slabs acquired that were reused from the pool rather than allocated
+		size_t hitCount;
+
+		/// @brief Number of released slabs returned to the memory manager because their size class was full
+		size_t discardCount;
+
+		/// @brief Number of slabs currently acquired
+		size_t inUseCount;
+
+		/// @brief Number of bytes in slabs currently acquired
+		size_t inUseBytes;
+
+		/// @brief Number of free slabs currently retained by the pool
+		size_t freeCount;
+
+		/// @brief Number of bytes in free slabs currently retained by the pool
+		size_t freeBytes;
+
+		double get_hit_rate() const { return !acquireCount ? 0.0 : ((double)hitCount / (double)acquireCount); }
+	};
+
+private:
+	static constexpr size_t max_free = COGS_RECEIVE_BUFFER_POOL_MAX_FREE;
+
+	// Free slabs are kept in a fixed array of slots, claimed and filled with compare_exchange.
+	// This is lock-free and not subject to ABA, and the pool retains at most max_free slabs per size class.
+	class size_class
+	{
+	public:
+		void* volatile m_slots[max_free];
+		volatile size_t m_freeCount alignas(atomic::get_alignment_v<size_t>);
+		volatile size_t m_inUseCount alignas(atomic::get_alignment_v<size_t>);
+
+		size_class()
+			: m_freeCount(0),
+			m_inUseCount(0)
+		{
+			for (size_t i = 0; i < max_free; i++)
+				m_slots[i] = nullptr;
+		}
+
+		~size_class()
+		{
+			for (size_t i = 0; i < max_free; i++)
+			{
+				if (!!m_slots[i])
+					default_memory_manager::deallocate(m_slots[i]);
+			}
+		}
+
+		void* pop()
+		{
+			if (!!atomic::load(m_freeCount))
+			{
+				for (size_t i = 0; i < max_free; i++)
+				{
+					void* p = atomic::load(m_slots[i]);
+					if (!!p && atomic::compare_exchange(m_slots[i], (void*)nullptr, p))
+					{
+						assign_prev(m_freeCount);
+						return p;
+					}
+				}
+			}
+			return nullptr;
+		}
+
+		bool push(void* p)
+		{
+			for (size_t i = 0; i < max_free; i++)
+			{
+				if (!atomic::load(m_slots[i]) && atomic::compare_exchange(m_slots[i], p, (void*)nullptr))
+				{
+					assign_next(m_freeCount);
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	size_class m_sizeClasses[size_class_count];
+
+	volatile size_t m_acquireCount alignas(atomic::get_alignment_v<size_t>);
+	volatile size_t m_hitCount alignas(atomic::get_alignment_v<size_t>);
+	volatile size_t m_discardCount alignas(atomic::get_alignment_v<size_t>);
+
+	char* acquire(size_t sizeClass)
+	{
+		size_class& sc = m_sizeClasses[sizeClass];
+		assign_next(m_acquireCount);
+		assign_next(sc.m_inUseCount);
+		void* p = sc.pop();
+		if (!!p)
+			assign_next(m_hitCount);
+		else
+			p = default_memory_manager::allocate(get_slab_size(sizeClass));
+		return (char*)p;
+	}
+
+	void release(char* p, size_t sizeClass)
+	{
+		size_class& sc = m_sizeClasses[sizeClass];
+		assign_prev(sc.m_inUseCount);
+		if (!sc.push(p))
+		{
+			assign_next(m_discardCount);
+			default_memory_manager::deallocate(p);
+		}
+	}
+
+protected:
+	receive_buffer_pool()
+		: m_acquireCount(0),
+		m_hitCount(0),
+		m_discardCount(0)
+	{ }
+
+public:
+	static rcref<receive_buffer_pool> get()
+	{
+		return singleton<receive_buffer_pool>::get();
+	}
+
+	stats get_stats() const
+	{
+		stats result;
+		result.acquireCount = atomic::load(m_acquireCount);
+		result.hitCount = atomic::load(m_hitCount);
+		result.discardCount = atomic::load(m_discardCount);
+		result.inUseCount = 0;
+		result.inUseBytes = 0;
+		result.freeCount = 0;
+		result.freeBytes = 0;
+		for (size_t i = 0; i < size_class_count; i++)
+		{
+			size_t inUseCount = atomic::load(m_sizeClasses[i].m_inUseCount);
+			size_t freeCount = atomic::load(m_sizeClasses[i].m_freeCount);
+			result.inUseCount += inUseCount;
+			result.inUseBytes += inUseCount * get_slab_size(i);
+			result.freeCount += freeCount;
+			result.freeBytes += freeCount * get_slab_size(i);
+		}
+		return result;
+	}
+};
+
+
+}
+}
+
+
+#endif
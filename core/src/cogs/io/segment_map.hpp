@@ -0,0 +1,330 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_IO_SEGMENT_MAP
+#define COGS_HEADER_IO_SEGMENT_MAP
+
+
+#include "cogs/collections/map.hpp"
+#include "cogs/io/composite_buffer.hpp"
+
+
+namespace cogs {
+namespace io {
+
+
+/// @ingroup IO
+/// @brief A segment combines a file position and a length.
+template <typename file_size_t = uint64_t>
+class segment
+{
+private:
+	file_size_t m_start;
+	file_size_t m_length;
+
+public:
+	segment()
+		: m_start(0),
+		m_length(0)
+	{ }
+
+	segment(const file_size_t& start, const file_size_t& length)
+		: m_start(start),
+		m_length(length)
+	{ }
+
+	const file_size_t& get_start() const { return m_start; }
+	const file_size_t& get_length() const { return m_length; }
+	file_size_t get_end() const { return m_start + m_length; }
+
+	void set_start(const file_size_t& s) { m_start = s; }
+	void set_length(const file_size_t& l) { m_length = l; }
+
+	void advance(file_size_t n)
+	{
+		if (n > m_length)
+			n = m_length;
+		m_length -= n;
+		m_start += n;
+	}
+
+	void truncate_to(file_size_t n)
+	{
+		if (n < m_length)
+			m_length = n;
+	}
+
+	// merge() stores the union of both segments.  It's likely an error to use merge() with
+	// segments that are not overlaping or adjacent.
+	void merge(const segment& s)
+	{
+		file_size_t end = get_end();
+		file_size_t sEnd = s.get_end();
+		if (s.m_start < m_start)
+			m_start = s.m_start;
+		m_length = ((end < sEnd) ? sEnd : end) - m_start;
+	}
+
+	bool does_overlap(const segment& s) const
+	{
+		if (m_start <= s.m_start)
+			return s.m_start < get_end();
+		return m_start < s.get_end();
+	}
+
+	bool operator<(const segment& s2) const { return m_start < s2.m_start; }
+};
+
+
+/// @ingroup IO
+/// @brief A sorted set of non-overlapping segments.
+///
+/// When adjacent or overlapping segments are added to a segment_map, they are coalesced into a
+/// single segment, such that all segments are adjacent only to gaps.  A segment_map is useful to
+/// identify a non-contiguous area (multiple contiguous areas) within a file.
+template <typename file_size_t = uint64_t>
+class segment_map
+{
+private:
+	typedef nonvolatile_map<file_size_t, file_size_t> map_t;
+
+	map_t m_map; // key is start, value is length
+
+public:
+	/// @brief An iterator of segments.  i->key is the start of the segment, and i->value is its length.
+	typedef typename map_t::iterator iterator;
+
+	segment_map() { }
+
+	segment_map(const segment<file_size_t>& s) { add(s); }
+
+	segment_map(const file_size_t& start, const file_size_t& length) { add(start, length); }
+
+	void add(const file_size_t& start, const file_size_t& length) { add(segment<file_size_t>(start, length)); }
+
+	void add(const segment<file_size_t>& s)
+	{
+		if (!s.get_length())
+			return;
+		segment<file_size_t> merged = s;
+		iterator i = m_map.find_equal_or_nearest_less_than(s.get_start());
+		if (!!i && (i->key + i->value >= s.get_start()))
+		{
+			merged.merge(segment<file_size_t>(i->key, i->value));
+			m_map.remove(i);
+		}
+		for (;;)
+		{
+			i = m_map.find_equal_or_nearest_greater_than(merged.get_start());
+			if (!i || (i->key > merged.get_end()))
+				break;
+			merged.merge(segment<file_size_t>(i->key, i->value));
+			m_map.remove(i);
+		}
+		m_map.insert_replace(merged.get_start(), merged.get_length());
+	}
+
+	void add(const segment_map& src)
+	{
+		for (iterator i = src.get_first(); !!i; ++i)
+			add(i->key, i->value);
+	}
+
+	void remove(const file_size_t& start, const file_size_t& length) { remove(segment<file_size_t>(start, length)); }
+
+	/// @brief Removes a segment, splitting or truncating any segments it partially overlaps.
+	void remove(const segment<file_size_t>& s)
+	{
+		if (!s.get_length())
+			return;
+		file_size_t end = s.get_end();
+		iterator i = m_map.find_nearest_less_than(s.get_start());
+		if (!!i)
+		{
+			file_size_t iEnd = i->key + i->value;
+			if (iEnd > s.get_start())
+			{
+				i->value = s.get_start() - i->key;
+				if (iEnd > end)
+				{
+					m_map.insert_replace(end, iEnd - end);
+					return;
+				}
+			}
+		}
+		for (;;)
+		{
+			i = m_map.find_equal_or_nearest_greater_than(s.get_start());
+			if (!i || (i->key >= end))
+				break;
+			file_size_t iEnd = i->key + i->value;
+			m_map.remove(i);
+			if (iEnd > end)
+			{
+				m_map.insert_replace(end, iEnd - end);
+				break;
+			}
+		}
+	}
+
+	/// @brief Tests whether a segment is entirely contained in the segment_map
+	bool contains(const segment<file_size_t>& s) const
+	{
+		iterator i = m_map.find_equal_or_nearest_less_than(s.get_start());
+		return !!i && (i->key + i->value >= s.get_end());
+	}
+
+	void clear() { m_map.clear(); }
+
+	size_t get_count() const { return m_map.size(); }
+	bool is_empty() const { return m_map.is_empty(); }
+	bool operator!() const { return is_empty(); }
+
+	/// @brief Gets the sum of the lengths of all segments
+	file_size_t get_total_length() const
+	{
+		file_size_t result = 0;
+		for (iterator i = m_map.get_first(); !!i; ++i)
+			result += i->value;
+		return result;
+	}
+
+	iterator get_first() const { return m_map.get_first(); }
+	iterator get_last() const { return m_map.get_last(); }
+};
+
+
+/// @ingroup IO
+/// @brief A sorted set of non-overlapping segments, each associated with a composite_buffer containing its data.
+///
+/// When a buffer is added that overlaps existing segments, they are overwritten.  Wholly overlapped
+/// segments are removed, and partially overlapped segments are truncated or split.  Adjacent segments
+/// are not coalesced.
+template <typename file_size_t = uint64_t>
+class segment_buffer_map
+{
+private:
+	typedef nonvolatile_map<file_size_t, composite_buffer> map_t;
+
+	map_t m_map; // key is start, value is the data.  Length is the length of the data.
+
+	void clear_range(const file_size_t& start, const file_size_t& end)
+	{
+		iterator i = m_map.find_nearest_less_than(start);
+		if (!!i)
+		{
+			file_size_t iEnd = i->key + i->value.get_length();
+			if (iEnd > start)
+			{
+				size_t keepLength = (size_t)(start - i->key);
+				if (iEnd > end)
+					m_map.insert_replace(end, composite_buffer(i->value, (size_t)(end - i->key)));
+				i->value.truncate_to(keepLength);
+			}
+		}
+		for (;;)
+		{
+			i = m_map.find_equal_or_nearest_greater_than(start);
+			if (!i || (i->key >= end))
+				break;
+			file_size_t iEnd = i->key + i->value.get_length();
+			if (iEnd <= end)
+				m_map.remove(i);
+			else
+			{
+				composite_buffer remaining(i->value, (size_t)(end - i->key));
+				m_map.remove(i);
+				m_map.insert_replace(end, std::move(remaining));
+				break;
+			}
+		}
+	}
+
+public:
+	/// @brief An iterator of segment buffers.  i->key is the start of the segment, and i->value is its data.
+	typedef typename map_t::iterator iterator;
+
+	segment_buffer_map() { }
+
+	/// @brief Adds a buffer, overwriting any existing data it overlaps
+	void write(const file_size_t& start, const composite_buffer& b)
+	{
+		size_t n = b.get_length();
+		if (!n)
+			return;
+		clear_range(start, start + n);
+		m_map.insert_replace(start, b);
+	}
+
+	/// @brief Adds a buffer, overwriting any existing data it overlaps
+	void write(const file_size_t& start, const buffer& b) { write(start, composite_buffer(b)); }
+
+	void remove(const segment<file_size_t>& s)
+	{
+		if (!!s.get_length())
+			clear_range(s.get_start(), s.get_end());
+	}
+
+	void clear() { m_map.clear(); }
+
+	size_t get_count() const { return m_map.size(); }
+	bool is_empty() const { return m_map.is_empty(); }
+	bool operator!() const { return is_empty(); }
+
+	/// @brief Gets the sum of the lengths of all buffers
+	file_size_t get_total_length() const
+	{
+		file_size_t result = 0;
+		for (iterator i = m_map.get_first(); !!i; ++i)
+			result += i->value.get_length();
+		return result;
+	}
+
+	/// @brief Gets a segment_map describing the areas covered by buffers
+	segment_map<file_size_t> get_segments() const
+	{
+		segment_map<file_size_t> result;
+		for (iterator i = m_map.get_first(); !!i; ++i)
+			result.add(i->key, i->value.get_length());
+		return result;
+	}
+
+	/// @brief Gets the contiguous data starting at a position, up to n bytes.
+	///
+	/// The result is shorter than n if a gap in the segment_buffer_map is encountered.
+	composite_buffer read(const file_size_t& start, size_t n = const_max_int_v<size_t>) const
+	{
+		composite_buffer result;
+		file_size_t pos = start;
+		iterator i = m_map.find_equal_or_nearest_less_than(start);
+		while (!!i && !!n)
+		{
+			file_size_t iEnd = i->key + i->value.get_length();
+			if ((i->key > pos) || (iEnd <= pos))
+				break;
+			size_t offset = (size_t)(pos - i->key);
+			size_t available = (size_t)(iEnd - pos);
+			if (available > n)
+				available = n;
+			result.append(composite_buffer(i->value, offset, available));
+			pos += available;
+			n -= available;
+			++i;
+		}
+		return result;
+	}
+
+	iterator get_first() const { return m_map.get_first(); }
+	iterator get_last() const { return m_map.get_last(); }
+};
+
+
+}
+}
+
+
+#endif
@@ -28,6 +28,11 @@
 #include "cogs/sync/hazard.hpp"
 
 
+#ifndef COGS_DYNAMIC_INTEGER_INLINE_DIGITS
+
+/// @brief The number of digits a dynamic_integer stores inline, without allocating
+#define COGS_DYNAMIC_INTEGER_INLINE_DIGITS 2
+#endif
 
 
 namespace cogs {
@@ -50,7 +55,7 @@ class dynamic_integer_content
 {
 public:
 	typedef vector_descriptor<ulongest> desc_t;
-	typedef vector_content<ulongest> vector_content_t;
+	typedef vector_content<ulongest, COGS_DYNAMIC_INTEGER_INLINE_DIGITS> vector_content_t;
 
 	vector_content_t m_digits;
 	bool m_isNegative;
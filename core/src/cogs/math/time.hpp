@@ -264,6 +264,93 @@ public:
 	typedef decltype(std::declval<unsigned_fixed_integer_const<3600>>() / std::declval<one_t>()) ratio_const_t;
 };
 
+// Conversions between sub-second units are specialized directly.  Deriving them relative to seconds requires
+// reducing a constant fraction with a large denominator, which is not supported by the constant integer types.
+
+template<>
+class unit_conversion<nanoseconds, nano100s>
+{
+public:
+	typedef decltype(std::declval<one_t>() / std::declval<unsigned_fixed_integer_const<100>>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<nanoseconds, microseconds>
+{
+public:
+	typedef decltype(std::declval<one_t>() / std::declval<unsigned_fixed_integer_const<1000>>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<nanoseconds, milliseconds>
+{
+public:
+	typedef decltype(std::declval<one_t>() / std::declval<unsigned_fixed_integer_const<1000000>>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<nano100s, nanoseconds>
+{
+public:
+	typedef decltype(std::declval<unsigned_fixed_integer_const<100>>() / std::declval<one_t>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<nano100s, microseconds>
+{
+public:
+	typedef decltype(std::declval<one_t>() / std::declval<unsigned_fixed_integer_const<10>>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<nano100s, milliseconds>
+{
+public:
+	typedef decltype(std::declval<one_t>() / std::declval<unsigned_fixed_integer_const<10000>>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<microseconds, nanoseconds>
+{
+public:
+	typedef decltype(std::declval<unsigned_fixed_integer_const<1000>>() / std::declval<one_t>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<microseconds, nano100s>
+{
+public:
+	typedef decltype(std::declval<unsigned_fixed_integer_const<10>>() / std::declval<one_t>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<microseconds, milliseconds>
+{
+public:
+	typedef decltype(std::declval<one_t>() / std::declval<unsigned_fixed_integer_const<1000>>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<milliseconds, nanoseconds>
+{
+public:
+	typedef decltype(std::declval<unsigned_fixed_integer_const<1000000>>() / std::declval<one_t>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<milliseconds, nano100s>
+{
+public:
+	typedef decltype(std::declval<unsigned_fixed_integer_const<10000>>() / std::declval<one_t>()) ratio_const_t;
+};
+
+template<>
+class unit_conversion<milliseconds, microseconds>
+{
+public:
+	typedef decltype(std::declval<unsigned_fixed_integer_const<1000>>() / std::declval<one_t>()) ratio_const_t;
+};
+
 
 static_assert(is_courser_v<hours, seconds>);
 static_assert(is_finer_v<seconds, hours>);
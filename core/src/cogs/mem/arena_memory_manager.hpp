@@ -0,0 +1,207 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_MEM_ARENA_MEMORY_MANAGER
+#define COGS_HEADER_MEM_ARENA_MEMORY_MANAGER
+
+#include "cogs/env.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/mem/memory_manager_base.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup Mem
+/// @brief A memory manager that allocates blocks by advancing a pointer within chunks, and releases them all at once.
+///
+/// Allocation is lock-free, and consists of a single compare-exchange in the common case.  deallocate() has no effect.
+/// All blocks are released together by reset(), or when the arena_memory_manager is destroyed.
+///
+/// When used as the memory_manager_t of a container (i.e. map, set, multimap, container_dlist), each container
+/// has its own arena, and all of its elements are released at once when the container is destroyed.
+/// An arena_memory_manager may also be passed to rcnew_with(), to allocate reference-counted objects that
+/// can all be torn down with a single reset.  The arena must outlive all objects allocated from it.
+/// @tparam chunk_size Size of each chunk.  Blocks larger than a quarter of chunk_size are allocated individually.  Default: 64KB
+/// @tparam large_block_memory_manager_type Memory manager to use to allocate chunks.  Default: default_memory_manager
+template <size_t chunk_size = 1024 * 64, class large_block_memory_manager_type = default_memory_manager>
+class arena_memory_manager : public memory_manager_base<arena_memory_manager<chunk_size, large_block_memory_manager_type>, false>
+{
+public:
+	typedef arena_memory_manager<chunk_size, large_block_memory_manager_type> this_t;
+
+private:
+	class chunk
+	{
+	public:
+		chunk* m_next;
+		unsigned char* m_end;
+		unsigned char* m_cursor alignas(atomic::get_alignment_v<unsigned char*>);
+
+		unsigned char* get_start() { return (unsigned char*)this + sizeof(chunk); }
+	};
+
+	static_assert(chunk_size > sizeof(chunk) * 4);
+
+	static constexpr size_t max_chunk_block_size = chunk_size / 4;
+
+	large_block_memory_manager_type m_largeBlockMemoryManager;
+	chunk* m_current alignas(atomic::get_alignment_v<chunk*>); // Chunk being allocated from, linked to previously filled chunks
+	chunk* m_largeChunks alignas(atomic::get_alignment_v<chunk*>); // Chunks containing a single large block
+
+	this_t* get_this() const volatile { return const_cast<this_t*>(this); }
+
+	large_block_memory_manager_type& get_large_block_memory_manager() const volatile
+	{
+		return get_this()->m_largeBlockMemoryManager;
+	}
+
+	static unsigned char* align_up(unsigned char* p, size_t align)
+	{
+		return (unsigned char*)(((size_t)p + (align - 1)) & ~(align - 1));
+	}
+
+	chunk* new_chunk(size_t n)
+	{
+		chunk* c = (chunk*)get_large_block_memory_manager().allocate(n, cogs::largest_alignment);
+		if (!c)
+		{
+			COGS_ASSERT(false); // For now, let's consider out of memory to be a fatal error
+			return nullptr; // TBD ?
+		}
+		c->m_end = (unsigned char*)c + n;
+		c->m_cursor = c->get_start();
+		return c;
+	}
+
+	void release_chunks(chunk* c)
+	{
+		while (!!c)
+		{
+			chunk* next = c->m_next;
+			m_largeBlockMemoryManager.deallocate(c);
+			c = next;
+		}
+	}
+
+	void* allocate_large(size_t n, size_t align)
+	{
+		chunk* c = new_chunk(sizeof(chunk) + n + align);
+		if (!c)
+			return nullptr;
+		chunk* oldHead = atomic::load(m_largeChunks);
+		do {
+			c->m_next = oldHead;
+		} while (!atomic::compare_exchange(m_largeChunks, c, oldHead, oldHead));
+		return align_up(c->get_start(), align);
+	}
+
+	arena_memory_manager(const this_t&) = delete;
+	this_t& operator=(const this_t&) = delete;
+
+public:
+	arena_memory_manager()
+		: m_current(nullptr),
+		m_largeChunks(nullptr)
+	{ }
+
+	arena_memory_manager(this_t&& src)
+		: m_current(src.m_current),
+		m_largeChunks(src.m_largeChunks)
+	{
+		src.m_current = nullptr;
+		src.m_largeChunks = nullptr;
+	}
+
+	~arena_memory_manager()
+	{
+		release_chunks(m_current);
+		release_chunks(m_largeChunks);
+	}
+
+	this_t& operator=(this_t&& src)
+	{
+		release_chunks(m_current);
+		release_chunks(m_largeChunks);
+		m_current = src.m_current;
+		m_largeChunks = src.m_largeChunks;
+		src.m_current = nullptr;
+		src.m_largeChunks = nullptr;
+		return *this;
+	}
+
+	/// @brief Releases all blocks.  Must not be called concurrently with any other use of the arena_memory_manager.
+	///
+	/// The most recent chunk is retained, to be reused by subsequent allocations.
+	void reset()
+	{
+		release_chunks(m_largeChunks);
+		m_largeChunks = nullptr;
+		chunk* c = m_current;
+		if (!!c)
+		{
+			release_chunks(c->m_next);
+			c->m_next = nullptr;
+			c->m_cursor = c->get_start();
+		}
+	}
+
+	void* allocate(size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		if (!n)
+			n = 1;
+		if (usableSize)
+			*usableSize = n;
+		if (n + align > max_chunk_block_size)
+			return nonVolatileThis->allocate_large(n, align);
+
+		chunk* c = atomic::load(nonVolatileThis->m_current);
+		for (;;)
+		{
+			if (!!c)
+			{
+				unsigned char* oldCursor = atomic::load(c->m_cursor);
+				for (;;)
+				{
+					unsigned char* p = align_up(oldCursor, align);
+					unsigned char* newCursor = p + n;
+					if (newCursor > c->m_end)
+						break;
+					if (atomic::compare_exchange(c->m_cursor, newCursor, oldCursor, oldCursor))
+						return p;
+				}
+			}
+
+			// The current chunk is full.  Allocate the block from a new chunk, then make it current.
+			chunk* newChunk = nonVolatileThis->new_chunk(chunk_size);
+			if (!newChunk)
+				return nullptr;
+			unsigned char* p = align_up(newChunk->get_start(), align);
+			newChunk->m_cursor = p + n;
+			newChunk->m_next = c;
+			if (atomic::compare_exchange(nonVolatileThis->m_current, newChunk, c, c))
+				return p;
+
+			// Another thread added a chunk first.  Use it instead.
+			get_large_block_memory_manager().deallocate(newChunk);
+		}
+	}
+
+	/// @brief Has no effect.  Blocks are released by reset(), or when the arena_memory_manager is destroyed.
+	void deallocate(void*) volatile { }
+
+	bool try_reallocate(void*, size_t, size_t = cogs::largest_alignment, size_t* = nullptr) volatile { return false; }
+};
+
+
+}
+
+
+#endif
@@ -24,7 +24,7 @@ namespace cogs {
 constexpr size_t default_minimum_batch_size = 32;
 
 template <typename T, size_t minimum_batch_size = default_minimum_batch_size, class memory_manager_t = default_memory_manager>
-class batch_allocator : public allocator_base<T, batch_allocator<T, minimum_batch_size>, false>
+class batch_allocator : public allocator_base<T, batch_allocator<T, minimum_batch_size, memory_manager_t>, false>
 {
 public:
 	static_assert(minimum_batch_size > 0);
@@ -32,7 +32,7 @@ public:
 	typedef T type;
 
 private:
-	typedef batch_allocator<T, minimum_batch_size> this_t;
+	typedef batch_allocator<T, minimum_batch_size, memory_manager_t> this_t;
 
 	mutable memory_manager_t m_memoryManager;
 
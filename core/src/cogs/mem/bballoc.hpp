@@ -140,7 +140,7 @@ private:
 		return !z ? 0 : (bit_scan_reverse(z) + 1);
 	}
 
-	static size_t IndexToSize(size_t index)
+	static constexpr size_t IndexToSize(size_t index)
 	{
 		return (((size_t)((size_t)1 << index))*(smallest_block_size + (overhead * 2))) - (overhead * 2);
 	}
@@ -529,6 +529,28 @@ private:
 			m_freeLists[i].get_memory_manager() = this;
 	}
 
+	// Splits an allocated block at index i into blocks at targetIndex, all of which remain allocated.
+	static void split_all(link* lnk, size_t i, size_t targetIndex, void**& blocks)
+	{
+		if (i == targetIndex)
+		{
+			*blocks++ = lnk->get_block();
+			return;
+		}
+		i--;
+		link* leftBuddy = (link*)lnk->get_block();
+		leftBuddy->set_selector(i, true);
+		leftBuddy->m_prev.set_to_mark((int)link_state::allocated);
+
+		link* rightBuddy = leftBuddy->get_right_buddy();
+		rightBuddy->set_selector(i, false);
+		rightBuddy->m_prev.set_to_mark((int)link_state::allocated);
+		COGS_ASSERT(rightBuddy->get_buddy() == leftBuddy);
+
+		split_all(leftBuddy, i, targetIndex, blocks);
+		split_all(rightBuddy, i, targetIndex, blocks);
+	}
+
 public:
 	buddy_block_memory_manager()
 	{
@@ -638,6 +660,85 @@ public:
 			m_freeLists[i].insert(*lnk);
 	}
 
+	/// @brief The number of size classes of blocks managed by the buddy_block_memory_manager
+	static constexpr size_t size_class_count = index_count;
+
+	/// @brief Gets the size class used to allocate a block of n bytes.  Returns size_class_count if too large to manage.
+	static size_t get_size_class(size_t n, size_t = cogs::largest_alignment)
+	{
+		if (n > largest_block_size)
+			return size_class_count;
+		if (!n)
+			n = 1;
+		return SizeToIndex(n);
+	}
+
+	/// @brief Gets the usable size of blocks of a size class
+	static constexpr size_t get_size_class_block_size(size_t sizeClass) { return IndexToSize(sizeClass); }
+
+	/// @brief Gets the size class of an allocated block.  Returns size_class_count if it was too large to manage.
+	static size_t get_block_size_class(void* p) { return link::from_block(p)->get_selector(); }
+
+	/// @brief Allocates multiple blocks of the same size class.
+	///
+	/// A single larger free block is removed and split into blocks of the requested size class, so blocks are
+	/// allocated at the cost of a single allocation.  Fewer than n blocks may be returned, if a large enough
+	/// free block is not available.  Each block is deallocated individually, with deallocate().
+	/// @param sizeClass Size class of blocks to allocate, as returned by get_size_class().  Must be less than size_class_count.
+	/// @param blocks Receives pointers to the allocated blocks
+	/// @param n Maximum number of blocks to allocate
+	/// @return The number of blocks allocated, at least 1
+	size_t allocate_batch(size_t sizeClass, void** blocks, size_t n) volatile
+	{
+		COGS_ASSERT(sizeClass < size_class_count);
+		COGS_ASSERT(n > 0);
+		size_t targetIndex = sizeClass + bit_scan_reverse(n);
+		if (targetIndex > last_index)
+			targetIndex = last_index;
+
+		// Prefer the smallest available block, to avoid splitting larger blocks unnecessarily.
+		size_t i = sizeClass;
+		link* lnk;
+		for (;;)
+		{
+			lnk = m_freeLists[i].remove();
+			if (!!lnk)
+				break;
+
+			if (i == last_index)
+			{
+				lnk = (link*)(get_large_block_memory_manager().allocate(largest_block_size + overhead, largest_alignment));
+				if (!lnk)
+				{
+					COGS_ASSERT(false); // For now, let's consider out of memory to be a fatal error
+					return 0; // TBD ?
+				}
+				lnk->set_selector(last_index, false);
+				break;
+			}
+			++i;
+		}
+		while (i > targetIndex)
+		{ // Split off blocks larger than needed
+			i--;
+			link* leftBuddy = (link*)lnk->get_block();
+			leftBuddy->set_selector(i, true);
+			leftBuddy->m_prev.set_to_mark((int)link_state::allocated);
+
+			link* rightBuddy = leftBuddy->get_right_buddy();
+			rightBuddy->set_selector(i, false);
+			rightBuddy->m_prev.set_to_mark((int)link_state::allocated);
+			COGS_ASSERT(rightBuddy->get_buddy() == leftBuddy);
+
+			m_freeLists[i].insert(*rightBuddy);
+
+			lnk = leftBuddy;
+		}
+		void** blocksEnd = blocks;
+		split_all(lnk, i, sizeClass, blocksEnd);
+		return blocksEnd - blocks;
+	}
+
 	bool try_reallocate(void* p, size_t newSize, size_t = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
 	{
 		if (!p)
@@ -15,8 +15,52 @@
 #include "cogs/math/const_lcm.hpp"
 #include "cogs/math/least_multiple_of.hpp"
 #include "cogs/mem/bballoc.hpp"
+#include "cogs/mem/magazine_memory_manager.hpp"
 #include "cogs/mem/placement.hpp"
+#include "cogs/mem/profiling_memory_manager.hpp"
 #include "cogs/mem/ptr.hpp"
+#include "cogs/mem/slab_memory_manager.hpp"
+
+
+// If COGS_USE_SLAB_MEMORY_MANAGER is defined, the default memory manager allocates small blocks from slabs of
+// fine-grained size classes, using a slab_memory_manager, in place of a buddy_block_memory_manager.  Slab size
+// classes waste less memory for block sizes that are not powers of 2.
+// If COGS_USE_NATIVE_MEMORY_MANAGER is defined, the default memory manager uses env::memory_manager directly.
+
+
+#ifndef COGS_MEMORY_MANAGER_MAGAZINE_SIZE
+
+/// @brief The number of blocks per size class moved at once between a thread's cache and the default memory manager.
+///
+/// Small blocks are cached per thread by the default memory manager, using a magazine_memory_manager.
+/// If 0, blocks are not cached per thread.  Not used with COGS_USE_NATIVE_MEMORY_MANAGER or COGS_USE_DEBUG_DEFAULT_ALLOCATOR.
+#define COGS_MEMORY_MANAGER_MAGAZINE_SIZE 32
+#endif
+
+
+#ifndef COGS_MEMORY_MANAGER_PROFILING
+
+/// @brief If nonzero, the default memory manager records allocation statistics, and samples call stacks of allocations.
+///
+/// Statistics and sampled call stacks are retrieved using default_memory_manager::get_allocation_stats(),
+/// default_memory_manager::for_each_thread_allocation_stats() and default_memory_manager::dump_heap_profile().
+/// Not used with COGS_USE_DEBUG_DEFAULT_ALLOCATOR.
+#define COGS_MEMORY_MANAGER_PROFILING 0
+#endif
+
+
+#ifndef COGS_MEMORY_MANAGER_PROFILING_SAMPLE_INTERVAL
+
+/// @brief The average number of bytes allocated between call stacks sampled by the default memory manager
+#define COGS_MEMORY_MANAGER_PROFILING_SAMPLE_INTERVAL (1024 * 512)
+#endif
+
+
+#ifndef COGS_MEMORY_MANAGER_MAGAZINE_MAX_BLOCK_SIZE
+
+/// @brief Blocks larger than this are not cached per thread by the default memory manager
+#define COGS_MEMORY_MANAGER_MAGAZINE_MAX_BLOCK_SIZE 4096
+#endif
 
 
 namespace cogs {
@@ -46,6 +90,8 @@ inline volatile unsigned long g_allocLogCount alignas(atomic::get_alignment_v<un
 #if COGS_USE_DEBUG_DEFAULT_ALLOCATOR
 #ifdef COGS_USE_NATIVE_MEMORY_MANAGER
 typedef env::memory_manager default_memory_manager_inner;
+#elif defined(COGS_USE_SLAB_MEMORY_MANAGER)
+typedef slab_memory_manager<> default_memory_manager_inner;
 #else
 typedef buddy_block_memory_manager<sizeof(void*), 1024 * 1024 * 4> default_memory_manager_inner;
 #endif
@@ -329,9 +375,28 @@ public:
 typedef debug_default_memory_manager default_memory_manager_impl;
 #else
 #ifdef COGS_USE_NATIVE_MEMORY_MANAGER
-typedef env::memory_manager default_memory_manager_impl;
+typedef env::memory_manager default_memory_manager_unprofiled_impl;
+#elif defined(COGS_USE_SLAB_MEMORY_MANAGER)
+#if COGS_MEMORY_MANAGER_MAGAZINE_SIZE
+typedef magazine_memory_manager<slab_memory_manager<>, COGS_MEMORY_MANAGER_MAGAZINE_SIZE, COGS_MEMORY_MANAGER_MAGAZINE_MAX_BLOCK_SIZE> default_memory_manager_unprofiled_impl;
 #else
-typedef buddy_block_memory_manager<sizeof(void*), 1024 * 1024 * 4> default_memory_manager_impl;
+typedef slab_memory_manager<> default_memory_manager_unprofiled_impl;
+#endif
+#elif COGS_MEMORY_MANAGER_MAGAZINE_SIZE
+typedef magazine_memory_manager<buddy_block_memory_manager<sizeof(void*), 1024 * 1024 * 4>, COGS_MEMORY_MANAGER_MAGAZINE_SIZE, COGS_MEMORY_MANAGER_MAGAZINE_MAX_BLOCK_SIZE> default_memory_manager_unprofiled_impl;
+#else
+typedef buddy_block_memory_manager<sizeof(void*), 1024 * 1024 * 4> default_memory_manager_unprofiled_impl;
+#endif
+#if COGS_MEMORY_MANAGER_PROFILING
+class default_memory_manager_impl : public profiling_memory_manager<default_memory_manager_unprofiled_impl>
+{
+public:
+	default_memory_manager_impl()
+		: profiling_memory_manager<default_memory_manager_unprofiled_impl>(COGS_MEMORY_MANAGER_PROFILING_SAMPLE_INTERVAL)
+	{ }
+};
+#else
+typedef default_memory_manager_unprofiled_impl default_memory_manager_impl;
 #endif
 #endif
 
@@ -468,6 +533,22 @@ public:
 		inner_t::assert_no_overflows();
 	}
 #endif
+
+#if COGS_MEMORY_MANAGER_PROFILING && !COGS_USE_DEBUG_DEFAULT_ALLOCATOR
+	/// @brief Gets allocation statistics totaled across all threads.  Requires COGS_MEMORY_MANAGER_PROFILING.
+	static void get_allocation_stats(allocation_stats& stats) { inner_t::get().get_stats(stats); }
+
+	/// @brief Gets allocation statistics of each running thread.  Requires COGS_MEMORY_MANAGER_PROFILING.
+	/// @param f Called with each thread's index and allocation_counters
+	template <typename F>
+	static void for_each_thread_allocation_stats(F&& f) { inner_t::get().for_each_thread(std::forward<F>(f)); }
+
+	/// @brief Sets the average number of bytes allocated between sampled call stacks.  0 disables sampling.
+	static void set_allocation_sample_interval(size_t n) { inner_t::get().set_sample_interval(n); }
+
+	/// @brief Writes sampled call stacks to a file, in the legacy heap profile format read by pprof.  Requires COGS_MEMORY_MANAGER_PROFILING.
+	static bool dump_heap_profile(const char* path) { return inner_t::get().dump_heap_profile(path); }
+#endif
 };
 
 
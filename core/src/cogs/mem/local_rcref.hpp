@@ -0,0 +1,193 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_MEM_LOCAL_RCREF
+#define COGS_HEADER_MEM_LOCAL_RCREF
+
+
+#include <new>
+#include <type_traits>
+
+#include "cogs/env.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/mem/rc_obj_base.hpp"
+#include "cogs/mem/rcref.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup ReferenceCountedReferenceContainerTypes
+/// @brief A non-nullable reference-counted reference container, confined to a single thread.
+///
+/// A local_rcref holds a single strong reference to a reference-counted object, shared by all copies of the
+/// local_rcref using a non-atomic count.  Copying and destroying a local_rcref does not use atomic operations.
+/// The strong reference is released when the last copy goes out of scope.
+///
+/// A local_rcref and all of its copies must only be used by one thread at a time.  To share the object with
+/// another thread, use get_rcref() to get a rcref.  Thread-safe (volatile) access is not supported.
+/// @tparam T Data type pointed to
+template <typename T>
+class local_rcref
+{
+public:
+	/// @brief Alias to the type pointed to
+	typedef T type;
+
+	/// @brief Alias to this type.
+	typedef local_rcref<type> this_t;
+
+private:
+	class local_counts
+	{
+	public:
+		rc_obj_base* m_desc;
+		size_t m_count;
+
+		explicit local_counts(rc_obj_base* desc)
+			: m_desc(desc),
+			m_count(1)
+		{ }
+	};
+
+	type* m_obj;
+	local_counts* m_counts; // nullptr if the object is not reference-counted
+
+	void acquire_local()
+	{
+		if (!!m_counts)
+			++(m_counts->m_count);
+	}
+
+	void release_local()
+	{
+		if (!!m_counts && !--(m_counts->m_count))
+		{
+			rc_obj_base* desc = m_counts->m_desc;
+			default_memory_manager::destruct_deallocate_type(m_counts);
+			desc->release();
+		}
+	}
+
+	void adopt(type* obj, rc_obj_base* desc)
+	{
+		m_obj = obj;
+		if (!desc)
+			m_counts = nullptr;
+		else
+		{
+			m_counts = default_memory_manager::allocate_type<local_counts>();
+			new (m_counts) local_counts(desc);
+		}
+	}
+
+public:
+	/// @{
+	/// @brief Initializes a local_rcref to refer to the same object as a rcref.
+	///
+	/// A single strong reference is acquired, which is shared by all copies of this local_rcref.
+	/// @param src Initial value
+	template <typename type2, typename enable = std::enable_if_t<std::is_convertible_v<type2*, type*> > >
+	explicit local_rcref(const rcref<type2>& src)
+	{
+		rcref<type2> tmp(src);
+		type* obj = tmp.get_obj();
+		adopt(obj, tmp.disown());
+	}
+
+	/// @brief Initializes a local_rcref to refer to the same object as a rcref, taking over its reference.
+	/// @param src Initial value.  src is left in an undefined state.
+	template <typename type2, typename enable = std::enable_if_t<std::is_convertible_v<type2*, type*> > >
+	explicit local_rcref(rcref<type2>&& src)
+	{
+		type* obj = src.get_obj();
+		adopt(obj, src.disown());
+	}
+	/// @}
+
+	local_rcref(const this_t& src)
+		: m_obj(src.m_obj),
+		m_counts(src.m_counts)
+	{
+		acquire_local();
+	}
+
+	local_rcref(this_t&& src)
+		: m_obj(src.m_obj),
+		m_counts(src.m_counts)
+	{
+		src.m_counts = nullptr;
+	}
+
+	~local_rcref() { release_local(); }
+
+	this_t& operator=(const this_t& src)
+	{
+		this_t tmp(src);
+		swap(tmp);
+		return *this;
+	}
+
+	this_t& operator=(this_t&& src)
+	{
+		std::swap(m_obj, src.m_obj);
+		std::swap(m_counts, src.m_counts);
+		return *this;
+	}
+
+	void swap(this_t& wth)
+	{
+		std::swap(m_obj, wth.m_obj);
+		std::swap(m_counts, wth.m_counts);
+	}
+
+	/// @brief Gets a pointer to the encapsulated object
+	/// @return A pointer to the encapsulated object
+	type* get_ptr() const { return m_obj; }
+	type* get_obj() const { return m_obj; }
+
+	/// @brief Gets the associated reference-counted descriptor, if any
+	/// @return Descriptor associated with this reference-counted object, if any
+	rc_obj_base* get_desc() const { return !m_counts ? nullptr : m_counts->m_desc; }
+
+	/// @brief Gets the number of local_rcref's sharing the strong reference held by this local_rcref
+	/// @return The number of local_rcref's sharing the strong reference.  0 if the object is not reference-counted.
+	size_t get_local_count() const { return !m_counts ? 0 : m_counts->m_count; }
+
+	/// @brief Gets a rcref to the object, which may be passed to another thread.  A strong reference is acquired.
+	/// @return A rcref to the object
+	rcref<type> get_rcref() const
+	{
+		rc_obj_base* desc = get_desc();
+		if (!!desc)
+			desc->acquire();
+		return rcref<type>(m_obj, desc);
+	}
+
+	template <typename U = type, typename enable = std::enable_if_t<!std::is_void_v<U> > >
+	U& operator*() const { return *m_obj; }
+
+	type* operator->() const { return m_obj; }
+
+	template <typename type2>
+	bool operator==(const local_rcref<type2>& cmp) const { return m_obj == cmp.get_ptr(); }
+
+	template <typename type2>
+	bool operator!=(const local_rcref<type2>& cmp) const { return m_obj != cmp.get_ptr(); }
+
+	template <typename type2>
+	bool operator==(const rcref<type2>& cmp) const { return m_obj == cmp.get_ptr(); }
+
+	template <typename type2>
+	bool operator!=(const rcref<type2>& cmp) const { return m_obj != cmp.get_ptr(); }
+};
+
+
+}
+
+
+#endif
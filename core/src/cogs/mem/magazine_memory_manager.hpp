@@ -0,0 +1,241 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_MEM_MAGAZINE_MEMORY_MANAGER
+#define COGS_HEADER_MEM_MAGAZINE_MEMORY_MANAGER
+
+#include <new>
+
+#include "cogs/env.hpp"
+#include "cogs/env/mem/memory_manager.hpp"
+#include "cogs/mem/memory_manager_base.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup Mem
+/// @brief A memory manager that caches small blocks per thread, in front of a memory manager with size classes.
+///
+/// Each thread has a magazine of blocks per size class.  Allocations and deallocations of cached size classes
+/// are satisfied from the calling thread's magazine, without contending with other threads.  An empty
+/// magazine is refilled with magazine_size blocks using a single batch allocation, and when a magazine
+/// holds twice magazine_size blocks, the oldest magazine_size blocks are returned to the inner memory manager.
+///
+/// A block is cached by the thread that deallocates it, which is usually the thread that allocated it.
+/// Blocks deallocated by other threads are reused by those threads, or returned to the inner memory manager
+/// in bulk.  When a thread exits, the blocks cached by it are returned to the inner memory manager.
+///
+/// Only one magazine_memory_manager of each type uses per-thread caches.  Other instances of the same type
+/// pass all requests to their inner memory manager.
+/// @tparam inner_memory_manager_t A memory manager providing size classes and batch allocation.
+/// i.e. buddy_block_memory_manager or slab_memory_manager
+/// @tparam magazine_size Number of blocks moved between a thread's cache and the inner memory manager at once
+/// @tparam max_cached_block_size Blocks larger than this are not cached
+template <class inner_memory_manager_t, size_t magazine_size = 32, size_t max_cached_block_size = 4096>
+class magazine_memory_manager : public memory_manager_base<magazine_memory_manager<inner_memory_manager_t, magazine_size, max_cached_block_size>, false>
+{
+public:
+	typedef magazine_memory_manager<inner_memory_manager_t, magazine_size, max_cached_block_size> this_t;
+
+private:
+	static_assert(magazine_size > 0);
+
+	static constexpr size_t get_cached_class_count()
+	{
+		size_t i = 0;
+		while (i < inner_memory_manager_t::size_class_count && inner_memory_manager_t::get_size_class_block_size(i) <= max_cached_block_size)
+			i++;
+		return i;
+	}
+
+	static constexpr size_t cached_class_count = get_cached_class_count();
+	static constexpr size_t magazine_capacity = magazine_size * 2;
+
+	class magazine
+	{
+	public:
+		size_t m_count;
+		void* m_blocks[magazine_capacity];
+	};
+
+	class thread_cache
+	{
+	public:
+		this_t* m_owner;
+		thread_cache* m_nextCache; // Registry link.  Caches are not removed from the registry until the memory manager is destroyed.
+		int m_inUse alignas(atomic::get_alignment_v<int>);
+		magazine m_magazines[cached_class_count];
+
+		explicit thread_cache(this_t* owner)
+			: m_owner(owner),
+			m_nextCache(nullptr),
+			m_inUse(1)
+		{
+			for (size_t i = 0; i < cached_class_count; i++)
+				m_magazines[i].m_count = 0;
+		}
+
+		void flush()
+		{
+			for (size_t i = 0; i < cached_class_count; i++)
+			{
+				magazine& m = m_magazines[i];
+				for (size_t j = 0; j < m.m_count; j++)
+					m_owner->m_inner.deallocate(m.m_blocks[j]);
+				m.m_count = 0;
+			}
+		}
+	};
+
+	// Returns a thread's cache to the registry when the thread exits
+	class thread_cache_holder
+	{
+	public:
+		thread_cache* m_cache = nullptr;
+
+		~thread_cache_holder()
+		{
+			thread_cache* c = m_cache;
+			m_cache = exited_cache();
+			if (!!c && (c != exited_cache()))
+			{
+				c->flush();
+				atomic::store(c->m_inUse, 0);
+			}
+		}
+	};
+
+	// Marks a thread whose cache has been released.  Requests from it are passed to the inner memory manager.
+	static thread_cache* exited_cache() { return (thread_cache*)(size_t)1; }
+
+	inline static thread_local thread_cache_holder s_threadCache;
+
+	inner_memory_manager_t m_inner;
+	thread_cache* m_caches alignas(atomic::get_alignment_v<thread_cache*>);
+
+	this_t* get_this() const volatile { return const_cast<this_t*>(this); }
+
+	thread_cache* get_thread_cache()
+	{
+		thread_cache* c = s_threadCache.m_cache;
+		if (!!c)
+		{
+			if ((c == exited_cache()) || (c->m_owner != this))
+				return nullptr;
+			return c;
+		}
+
+		// Reuse a cache released by an exited thread, if there is one
+		for (c = atomic::load(m_caches); !!c; c = c->m_nextCache)
+		{
+			int oldInUse = 0;
+			if (atomic::load(c->m_inUse) == 0 && atomic::compare_exchange(c->m_inUse, 1, oldInUse))
+				break;
+		}
+		if (!c)
+		{
+			c = (thread_cache*)env::memory_manager::allocate(sizeof(thread_cache), alignof(thread_cache));
+			if (!c)
+				return nullptr;
+			new (c) thread_cache(this);
+			thread_cache* oldHead = atomic::load(m_caches);
+			do {
+				c->m_nextCache = oldHead;
+			} while (!atomic::compare_exchange(m_caches, c, oldHead, oldHead));
+		}
+		s_threadCache.m_cache = c;
+		return c;
+	}
+
+public:
+	magazine_memory_manager()
+		: m_caches(nullptr)
+	{ }
+
+	~magazine_memory_manager()
+	{
+		// All other threads are expected to have exited.  Blocks cached for the current thread are returned.
+		thread_cache* c = s_threadCache.m_cache;
+		if (!!c && (c != exited_cache()) && (c->m_owner == this))
+			s_threadCache.m_cache = nullptr;
+		c = m_caches;
+		while (!!c)
+		{
+			thread_cache* next = c->m_nextCache;
+			c->flush();
+			c->thread_cache::~thread_cache();
+			env::memory_manager::deallocate(c);
+			c = next;
+		}
+	}
+
+	void* allocate(size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		size_t sizeClass = inner_memory_manager_t::get_size_class(n, align);
+		if (sizeClass < cached_class_count)
+		{
+			thread_cache* c = nonVolatileThis->get_thread_cache();
+			if (!!c)
+			{
+				magazine& m = c->m_magazines[sizeClass];
+				if (!m.m_count)
+					m.m_count = nonVolatileThis->m_inner.allocate_batch(sizeClass, m.m_blocks, magazine_size);
+				if (!!m.m_count)
+				{
+					if (usableSize)
+						*usableSize = inner_memory_manager_t::get_size_class_block_size(sizeClass);
+					return m.m_blocks[--m.m_count];
+				}
+			}
+		}
+		return nonVolatileThis->m_inner.allocate(n, align, usableSize);
+	}
+
+	void deallocate(void* p) volatile
+	{
+		if (!p)
+			return;
+		this_t* nonVolatileThis = get_this();
+		size_t sizeClass = nonVolatileThis->m_inner.get_block_size_class(p);
+		if (sizeClass < cached_class_count)
+		{
+			thread_cache* c = nonVolatileThis->get_thread_cache();
+			if (!!c)
+			{
+				magazine& m = c->m_magazines[sizeClass];
+				if (m.m_count == magazine_capacity)
+				{
+					// Return the oldest blocks, keeping the most recently used
+					for (size_t i = 0; i < magazine_size; i++)
+						nonVolatileThis->m_inner.deallocate(m.m_blocks[i]);
+					for (size_t i = magazine_size; i < magazine_capacity; i++)
+						m.m_blocks[i - magazine_size] = m.m_blocks[i];
+					m.m_count = magazine_capacity - magazine_size;
+				}
+				m.m_blocks[m.m_count++] = p;
+				return;
+			}
+		}
+		nonVolatileThis->m_inner.deallocate(p);
+	}
+
+	bool try_reallocate(void* p, size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		return get_this()->m_inner.try_reallocate(p, n, align, usableSize);
+	}
+};
+
+
+}
+
+
+#endif
@@ -106,6 +106,9 @@ public:
 template <class memory_manager_t>
 class memory_manager_base<memory_manager_t, false>
 {
+private:
+	memory_manager_t* get_memory_manager() const volatile { return const_cast<memory_manager_t*>(static_cast<const volatile memory_manager_t*>(this)); }
+
 public:
 	static constexpr bool is_static = false;
 
@@ -115,7 +118,7 @@ public:
 	type* allocate_type(size_t n = 1, size_t* usableCount = nullptr)
 	{
 		static_assert(sizeof(type) % alignof(type) == 0);
-		type* result = reinterpret_cast<type*>(static_cast<memory_manager_t*>(this)->allocate(sizeof(type) * n, alignof(type), usableCount));
+		type* result = reinterpret_cast<type*>(get_memory_manager()->allocate(sizeof(type) * n, alignof(type), usableCount));
 		if (usableCount)
 			*usableCount /= sizeof(type);
 		return result;
@@ -125,7 +128,7 @@ public:
 	type* allocate_type(size_t n = 1, size_t* usableCount = nullptr) const
 	{
 		static_assert(sizeof(type) % alignof(type) == 0);
-		type* result = reinterpret_cast<type*>(static_cast<memory_manager_t*>(this)->allocate(sizeof(type) * n, alignof(type), usableCount));
+		type* result = reinterpret_cast<type*>(get_memory_manager()->allocate(sizeof(type) * n, alignof(type), usableCount));
 		if (usableCount)
 			*usableCount /= sizeof(type);
 		return result;
@@ -135,7 +138,7 @@ public:
 	type* allocate_type(size_t n = 1, size_t* usableCount = nullptr) volatile
 	{
 		static_assert(sizeof(type) % alignof(type) == 0);
-		type* result = reinterpret_cast<type*>(static_cast<memory_manager_t*>(this)->allocate(sizeof(type) * n, alignof(type), usableCount));
+		type* result = reinterpret_cast<type*>(get_memory_manager()->allocate(sizeof(type) * n, alignof(type), usableCount));
 		if (usableCount)
 			*usableCount /= sizeof(type);
 		return result;
@@ -145,7 +148,7 @@ public:
 	type* allocate_type(size_t n = 1, size_t* usableCount = nullptr) const volatile
 	{
 		static_assert(sizeof(type) % alignof(type) == 0);
-		type* result = reinterpret_cast<type*>(static_cast<memory_manager_t*>(this)->allocate(sizeof(type) * n, alignof(type), usableCount));
+		type* result = reinterpret_cast<type*>(get_memory_manager()->allocate(sizeof(type) * n, alignof(type), usableCount));
 		if (usableCount)
 			*usableCount /= sizeof(type);
 		return result;
@@ -157,7 +160,7 @@ public:
 		if (!!p)
 		{
 			placement_destruct_multiple(p, n);
-			static_cast<memory_manager_t*>(this)->deallocate((void*)p);
+			get_memory_manager()->deallocate((void*)p);
 		}
 	}
 
@@ -167,7 +170,7 @@ public:
 		if (!!p)
 		{
 			placement_destruct_multiple(p, n);
-			static_cast<memory_manager_t*>(this)->deallocate((void*)p);
+			get_memory_manager()->deallocate((void*)p);
 		}
 	}
 
@@ -177,7 +180,7 @@ public:
 		if (!!p)
 		{
 			placement_destruct_multiple(p, n);
-			static_cast<memory_manager_t*>(this)->deallocate((void*)p);
+			get_memory_manager()->deallocate((void*)p);
 		}
 	}
 
@@ -187,14 +190,14 @@ public:
 		if (!!p)
 		{
 			placement_destruct_multiple(p, n);
-			static_cast<memory_manager_t*>(this)->deallocate((void*)p);
+			get_memory_manager()->deallocate((void*)p);
 		}
 	}
 
 	template <typename type>
 	bool try_reallocate_type(type* p, size_t n, size_t* usableCount = nullptr)
 	{
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n * sizeof(type));
+		bool b = get_memory_manager()->try_reallocate((void*)p, n * sizeof(type));
 		if (usableCount && b)
 			*usableCount -= *usableCount % sizeof(type);
 		return b;
@@ -204,7 +207,7 @@ public:
 	template <typename type>
 	bool try_reallocate_type(type* p, size_t n, size_t* usableCount = nullptr) const
 	{
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n * sizeof(type));
+		bool b = get_memory_manager()->try_reallocate((void*)p, n * sizeof(type));
 		if (usableCount && b)
 			*usableCount -= *usableCount % sizeof(type);
 		return b;
@@ -214,7 +217,7 @@ public:
 	template <typename type>
 	bool try_reallocate_type(type* p, size_t n, size_t* usableCount = nullptr) volatile
 	{
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n * sizeof(type));
+		bool b = get_memory_manager()->try_reallocate((void*)p, n * sizeof(type));
 		if (usableCount && b)
 			*usableCount -= *usableCount % sizeof(type);
 		return b;
@@ -224,7 +227,7 @@ public:
 	template <typename type>
 	bool try_reallocate_type(type* p, size_t n, size_t* usableCount = nullptr) const volatile
 	{
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n * sizeof(type));
+		bool b = get_memory_manager()->try_reallocate((void*)p, n * sizeof(type));
 		if (usableCount && b)
 			*usableCount -= *usableCount % sizeof(type);
 		return b;
@@ -235,7 +238,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		header_t* result = static_cast<memory_manager_t*>(this)->allocate(n + headerSize, commonAlignment, usableSize).template reinterpret_cast_to<header_t>();
+		header_t* result = (header_t*)get_memory_manager()->allocate(n + headerSize, commonAlignment, usableSize);
 		if (usableSize)
 			*usableSize -= headerSize;
 		return result;
@@ -246,7 +249,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		header_t* result = static_cast<memory_manager_t*>(this)->allocate(n + headerSize, commonAlignment, usableSize).template reinterpret_cast_to<header_t>();
+		header_t* result = (header_t*)get_memory_manager()->allocate(n + headerSize, commonAlignment, usableSize);
 		if (usableSize)
 			*usableSize -= headerSize;
 		return result;
@@ -257,7 +260,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		header_t* result = static_cast<memory_manager_t*>(this)->allocate(n + headerSize, commonAlignment, usableSize).template reinterpret_cast_to<header_t>();
+		header_t* result = (header_t*)get_memory_manager()->allocate(n + headerSize, commonAlignment, usableSize);
 		if (usableSize)
 			*usableSize -= headerSize;
 		return result;
@@ -268,7 +271,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		header_t* result = static_cast<memory_manager_t*>(this)->allocate(n + headerSize, commonAlignment, usableSize).template reinterpret_cast_to<header_t>();
+		header_t* result = (header_t*)get_memory_manager()->allocate(n + headerSize, commonAlignment, usableSize);
 		if (usableSize)
 			*usableSize -= headerSize;
 		return result;
@@ -315,7 +318,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n + headerSize, usableSize);
+		bool b = get_memory_manager()->try_reallocate((void*)p, n + headerSize, usableSize);
 		if (usableSize && b)
 			*usableSize -= headerSize;
 		return b;
@@ -326,7 +329,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n + headerSize, usableSize);
+		bool b = get_memory_manager()->try_reallocate((void*)p, n + headerSize, usableSize);
 		if (usableSize && b)
 			*usableSize -= headerSize;
 		return b;
@@ -337,7 +340,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n + headerSize, usableSize);
+		bool b = get_memory_manager()->try_reallocate((void*)p, n + headerSize, usableSize);
 		if (usableSize && b)
 			*usableSize -= headerSize;
 		return b;
@@ -348,7 +351,7 @@ public:
 	{
 		static constexpr size_t commonAlignment = const_lcm_v<alignof(header_t), align>;
 		static constexpr size_t headerSize = least_multiple_of_v<sizeof(header_t), commonAlignment>; // header_t must be padded out to next multiple of commonAlignment that is greater than or equal to sizeof(header_t)
-		bool b = static_cast<memory_manager_t*>(this)->try_reallocate((void*)p, n + headerSize, usableSize);
+		bool b = get_memory_manager()->try_reallocate((void*)p, n + headerSize, usableSize);
 		if (usableSize && b)
 			*usableSize -= headerSize;
 		return b;
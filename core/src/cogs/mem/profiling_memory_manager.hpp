@@ -0,0 +1,571 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_MEM_PROFILING_MEMORY_MANAGER
+#define COGS_HEADER_MEM_PROFILING_MEMORY_MANAGER
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+
+#include "cogs/env.hpp"
+#include "cogs/env/mem/call_stack.hpp"
+#include "cogs/env/mem/memory_manager.hpp"
+#include "cogs/mem/memory_manager_base.hpp"
+#include "cogs/operators.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup Mem
+/// @brief Allocation counters, as reported by a profiling_memory_manager
+class allocation_counters
+{
+public:
+	size_t m_allocCount = 0;
+	size_t m_allocBytes = 0;
+	size_t m_freeCount = 0;
+	size_t m_freeBytes = 0;
+
+	size_t get_live_count() const { return m_allocCount - m_freeCount; }
+	size_t get_live_bytes() const { return m_allocBytes - m_freeBytes; }
+
+	allocation_counters& operator+=(const allocation_counters& src)
+	{
+		m_allocCount += src.m_allocCount;
+		m_allocBytes += src.m_allocBytes;
+		m_freeCount += src.m_freeCount;
+		m_freeBytes += src.m_freeBytes;
+		return *this;
+	}
+};
+
+
+/// @ingroup Mem
+/// @brief Allocation statistics, as reported by a profiling_memory_manager
+class allocation_stats
+{
+public:
+	/// @brief The number of size classes.  Size class i contains requested sizes in the range [2^i, 2^(i+1)).
+	static constexpr size_t size_class_count = sizeof(size_t) * 8;
+
+	allocation_counters m_total;
+	allocation_counters m_sizeClasses[size_class_count];
+
+	/// @brief Gets the size class of a requested size
+	static size_t get_size_class(size_t n) { return (n <= 1) ? 0 : bit_scan_reverse(n); }
+};
+
+
+/// @ingroup Mem
+/// @brief A memory manager that records allocation statistics, and samples the call stacks of allocations.
+///
+/// Each block is prefixed with a small header recording its requested size.  Counts and byte totals of
+/// allocations and deallocations are kept per thread and per size class, without contention between threads.
+///
+/// Call stacks are sampled on average once per sample interval bytes allocated, at randomized intervals, so
+/// large and frequent allocations are proportionally represented.  Sampled call stacks can be written in the
+/// legacy heap profile format read by pprof, using write_heap_profile() or dump_heap_profile().
+///
+/// Only one profiling_memory_manager of each type records per-thread statistics.  Other instances of the same
+/// type attribute all allocations to a single shared set of counters.
+/// @tparam inner_memory_manager_t Memory manager to allocate blocks from
+/// @tparam max_frames Maximum number of return addresses recorded per sampled call stack
+/// @tparam max_stacks Maximum number of distinct sampled call stacks.  Must be a power of 2.
+///   Samples of additional call stacks are attributed to a single call stack with no frames.
+template <class inner_memory_manager_t, size_t max_frames = 32, size_t max_stacks = 4096>
+class profiling_memory_manager : public memory_manager_base<profiling_memory_manager<inner_memory_manager_t, max_frames, max_stacks>, false>
+{
+public:
+	typedef profiling_memory_manager<inner_memory_manager_t, max_frames, max_stacks> this_t;
+
+	static constexpr size_t default_sample_interval = 1024 * 512;
+
+private:
+	static_assert((max_stacks & (max_stacks - 1)) == 0);
+
+	static constexpr size_t size_class_count = allocation_stats::size_class_count;
+
+	// Counters are only modified atomically, so they can be read while in use
+	class counters
+	{
+	public:
+		size_t m_allocCount alignas(atomic::get_alignment_v<size_t>);
+		size_t m_allocBytes alignas(atomic::get_alignment_v<size_t>);
+		size_t m_freeCount alignas(atomic::get_alignment_v<size_t>);
+		size_t m_freeBytes alignas(atomic::get_alignment_v<size_t>);
+
+		void clear()
+		{
+			atomic::store(m_allocCount, 0);
+			atomic::store(m_allocBytes, 0);
+			atomic::store(m_freeCount, 0);
+			atomic::store(m_freeBytes, 0);
+		}
+
+		void add_alloc(size_t n)
+		{
+			assign_next(*(volatile size_t*)&m_allocCount);
+			assign_add(*(volatile size_t*)&m_allocBytes, n);
+		}
+
+		void add_free(size_t n)
+		{
+			assign_next(*(volatile size_t*)&m_freeCount);
+			assign_add(*(volatile size_t*)&m_freeBytes, n);
+		}
+
+		void add(const counters& src)
+		{
+			assign_add(*(volatile size_t*)&m_allocCount, atomic::load(src.m_allocCount));
+			assign_add(*(volatile size_t*)&m_allocBytes, atomic::load(src.m_allocBytes));
+			assign_add(*(volatile size_t*)&m_freeCount, atomic::load(src.m_freeCount));
+			assign_add(*(volatile size_t*)&m_freeBytes, atomic::load(src.m_freeBytes));
+		}
+
+		void get(allocation_counters& dst) const
+		{
+			dst.m_allocCount += atomic::load(m_allocCount);
+			dst.m_allocBytes += atomic::load(m_allocBytes);
+			dst.m_freeCount += atomic::load(m_freeCount);
+			dst.m_freeBytes += atomic::load(m_freeBytes);
+		}
+	};
+
+	class stack_bucket
+	{
+	public:
+		size_t m_hash;
+		size_t m_depth;
+		void* m_frames[max_frames];
+		counters m_counters;
+	};
+
+	// Immediately precedes each block
+	class header
+	{
+	public:
+		stack_bucket* m_bucket; // Null if the allocation was not sampled
+		size_t m_size;
+		size_t m_offset; // Offset of the block from the start of the allocation
+	};
+
+	class thread_record
+	{
+	public:
+		this_t* m_owner;
+		thread_record* m_next; // Registry link.  Records are not removed from the registry until the memory manager is destroyed.
+		int m_inUse alignas(atomic::get_alignment_v<int>);
+		size_t m_threadIndex alignas(atomic::get_alignment_v<size_t>);
+		ptrdiff_t m_bytesUntilSample;
+		uint64_t m_random;
+		counters m_sizeClasses[size_class_count];
+
+		void clear()
+		{
+			for (size_t i = 0; i < size_class_count; i++)
+				m_sizeClasses[i].clear();
+		}
+	};
+
+	// Releases a thread's record when the thread exits
+	class thread_record_holder
+	{
+	public:
+		thread_record* m_record = nullptr;
+
+		~thread_record_holder()
+		{
+			thread_record* r = m_record;
+			m_record = exited_record();
+			if (!!r && (r != exited_record()))
+				r->m_owner->release_thread_record(r);
+		}
+	};
+
+	// Marks a thread whose record has been released.  Its requests are counted in m_unattributed.
+	static thread_record* exited_record() { return (thread_record*)(size_t)1; }
+
+	inline static thread_local thread_record_holder s_threadRecord;
+
+	inner_memory_manager_t m_inner;
+	thread_record* m_threadRecords alignas(atomic::get_alignment_v<thread_record*>);
+	size_t m_nextThreadIndex alignas(atomic::get_alignment_v<size_t>);
+	size_t m_sampleInterval alignas(atomic::get_alignment_v<size_t>);
+	counters m_unattributed[size_class_count]; // Requests from exited threads, and from threads of other instances
+	stack_bucket* m_buckets[max_stacks];
+	stack_bucket m_overflowBucket;
+
+	this_t* get_this() const volatile { return const_cast<this_t*>(this); }
+
+	static size_t get_header_offset(size_t align)
+	{
+		if (align < alignof(header))
+			align = alignof(header);
+		return (sizeof(header) + (align - 1)) & ~(align - 1);
+	}
+
+	static header* get_header(void* p) { return (header*)p - 1; }
+
+	thread_record* get_thread_record()
+	{
+		thread_record* r = s_threadRecord.m_record;
+		if (!!r)
+		{
+			if ((r == exited_record()) || (r->m_owner != this))
+				return nullptr;
+			return r;
+		}
+
+		// Reuse a record released by an exited thread, if there is one
+		for (r = atomic::load(m_threadRecords); !!r; r = r->m_next)
+		{
+			int oldInUse = 0;
+			if (atomic::load(r->m_inUse) == 0 && atomic::compare_exchange(r->m_inUse, 1, oldInUse))
+				break;
+		}
+		if (!r)
+		{
+			r = (thread_record*)env::memory_manager::allocate(sizeof(thread_record), alignof(thread_record));
+			if (!r)
+				return nullptr;
+			new (r) thread_record;
+			r->m_owner = this;
+			r->m_inUse = 1;
+			r->clear();
+			thread_record* oldHead = atomic::load(m_threadRecords);
+			do {
+				r->m_next = oldHead;
+			} while (!atomic::compare_exchange(m_threadRecords, r, oldHead, oldHead));
+		}
+		atomic::store(r->m_threadIndex, post_assign_next(*(volatile size_t*)&m_nextThreadIndex));
+		r->m_random = ((uint64_t)(size_t)r ^ ((uint64_t)r->m_threadIndex << 32)) | 1;
+		r->m_bytesUntilSample = get_next_sample_distance(*r);
+		s_threadRecord.m_record = r;
+		return r;
+	}
+
+	void release_thread_record(thread_record* r)
+	{
+		// Retain the exiting thread's counts in the totals
+		for (size_t i = 0; i < size_class_count; i++)
+			m_unattributed[i].add(r->m_sizeClasses[i]);
+		r->clear();
+		atomic::store(r->m_inUse, 0);
+	}
+
+	// Exponentially distributed, with a mean of the sample interval
+	ptrdiff_t get_next_sample_distance(thread_record& r)
+	{
+		size_t interval = atomic::load(m_sampleInterval);
+		if (!interval)
+			return PTRDIFF_MAX;
+		uint64_t x = r.m_random;
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		r.m_random = x;
+		double u = ((double)(x >> 11) + 1.0) / 9007199254740992.0; // (0, 1]
+		double d = -std::log(u) * (double)interval;
+		if (d < 1.0)
+			return 1;
+		if (d > (double)(PTRDIFF_MAX / 2))
+			return PTRDIFF_MAX / 2;
+		return (ptrdiff_t)d;
+	}
+
+	stack_bucket* get_stack_bucket()
+	{
+		void* frames[max_frames];
+		size_t depth = env::get_call_stack(frames, max_frames, 1);
+		size_t hash = depth;
+		for (size_t i = 0; i < depth; i++)
+			hash = (hash * 1099511628211ULL) ^ (size_t)frames[i];
+		hash ^= hash >> 17;
+
+		stack_bucket* newBucket = nullptr;
+		stack_bucket* result = &m_overflowBucket;
+		for (size_t i = 0; i < max_stacks; i++)
+		{
+			size_t slot = (hash + i) & (max_stacks - 1);
+			stack_bucket* b = atomic::load(m_buckets[slot]);
+			if (!b)
+			{
+				if (!newBucket)
+				{
+					newBucket = (stack_bucket*)env::memory_manager::allocate(sizeof(stack_bucket), alignof(stack_bucket));
+					if (!newBucket)
+						break;
+					newBucket->m_hash = hash;
+					newBucket->m_depth = depth;
+					for (size_t j = 0; j < depth; j++)
+						newBucket->m_frames[j] = frames[j];
+					newBucket->m_counters.clear();
+				}
+				if (atomic::compare_exchange(m_buckets[slot], newBucket, b, b))
+				{
+					result = newBucket;
+					newBucket = nullptr;
+					break;
+				}
+			}
+			if (b->m_hash == hash && b->m_depth == depth)
+			{
+				size_t j = 0;
+				while (j < depth && b->m_frames[j] == frames[j])
+					j++;
+				if (j == depth)
+				{
+					result = b;
+					break;
+				}
+			}
+		}
+		if (!!newBucket)
+			env::memory_manager::deallocate(newBucket);
+		return result;
+	}
+
+	void count_alloc(header* hdr, size_t n)
+	{
+		size_t sizeClass = allocation_stats::get_size_class(n);
+		thread_record* r = get_thread_record();
+		if (!r)
+		{
+			m_unattributed[sizeClass].add_alloc(n);
+			return;
+		}
+		r->m_sizeClasses[sizeClass].add_alloc(n);
+		r->m_bytesUntilSample -= (ptrdiff_t)n;
+		if (r->m_bytesUntilSample <= 0)
+		{
+			r->m_bytesUntilSample = get_next_sample_distance(*r);
+			if (atomic::load(m_sampleInterval) != 0)
+			{
+				stack_bucket* b = get_stack_bucket();
+				b->m_counters.add_alloc(n);
+				hdr->m_bucket = b;
+			}
+		}
+	}
+
+	void count_free(header* hdr)
+	{
+		size_t n = hdr->m_size;
+		size_t sizeClass = allocation_stats::get_size_class(n);
+		thread_record* r = get_thread_record();
+		if (!r)
+			m_unattributed[sizeClass].add_free(n);
+		else
+			r->m_sizeClasses[sizeClass].add_free(n);
+		if (!!hdr->m_bucket)
+			hdr->m_bucket->m_counters.add_free(n);
+	}
+
+	profiling_memory_manager(const this_t&) = delete;
+	this_t& operator=(const this_t&) = delete;
+
+public:
+	explicit profiling_memory_manager(size_t sampleInterval = default_sample_interval)
+		: m_threadRecords(nullptr),
+		m_nextThreadIndex(0),
+		m_sampleInterval(sampleInterval)
+	{
+		for (size_t i = 0; i < size_class_count; i++)
+			m_unattributed[i].clear();
+		for (size_t i = 0; i < max_stacks; i++)
+			m_buckets[i] = nullptr;
+		m_overflowBucket.m_hash = 0;
+		m_overflowBucket.m_depth = 0;
+		m_overflowBucket.m_counters.clear();
+	}
+
+	~profiling_memory_manager()
+	{
+		// All other threads are expected to have exited
+		thread_record* r = s_threadRecord.m_record;
+		if (!!r && (r != exited_record()) && (r->m_owner == this))
+			s_threadRecord.m_record = nullptr;
+		r = m_threadRecords;
+		while (!!r)
+		{
+			thread_record* next = r->m_next;
+			env::memory_manager::deallocate(r);
+			r = next;
+		}
+		for (size_t i = 0; i < max_stacks; i++)
+		{
+			if (!!m_buckets[i])
+				env::memory_manager::deallocate(m_buckets[i]);
+		}
+	}
+
+	void* allocate(size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		size_t offset = get_header_offset(align);
+		unsigned char* base = (unsigned char*)nonVolatileThis->m_inner.allocate(n + offset, (align < alignof(header)) ? alignof(header) : align, usableSize);
+		if (!base)
+			return nullptr;
+		if (usableSize)
+			*usableSize -= offset;
+		unsigned char* p = base + offset;
+		header* hdr = get_header(p);
+		hdr->m_bucket = nullptr;
+		hdr->m_size = n;
+		hdr->m_offset = offset;
+		nonVolatileThis->count_alloc(hdr, n);
+		return p;
+	}
+
+	void deallocate(void* p) volatile
+	{
+		if (!p)
+			return;
+		this_t* nonVolatileThis = get_this();
+		header* hdr = get_header(p);
+		nonVolatileThis->count_free(hdr);
+		nonVolatileThis->m_inner.deallocate((unsigned char*)p - hdr->m_offset);
+	}
+
+	/// @brief Resizes a block in place.  In the statistics, a resize is counted as a deallocation and an allocation.
+	bool try_reallocate(void* p, size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		if (!p)
+			return false;
+		this_t* nonVolatileThis = get_this();
+		header* hdr = get_header(p);
+		size_t offset = hdr->m_offset;
+		if (!nonVolatileThis->m_inner.try_reallocate((unsigned char*)p - offset, n + offset, (align < alignof(header)) ? alignof(header) : align, usableSize))
+			return false;
+		if (usableSize)
+			*usableSize -= offset;
+		nonVolatileThis->count_free(hdr);
+		hdr->m_bucket = nullptr;
+		hdr->m_size = n;
+		nonVolatileThis->count_alloc(hdr, n);
+		return true;
+	}
+
+	/// @brief Sets the average number of bytes allocated between sampled call stacks.  0 disables sampling.
+	void set_sample_interval(size_t n) volatile { atomic::store(get_this()->m_sampleInterval, n); }
+
+	size_t get_sample_interval() const volatile { return atomic::load(get_this()->m_sampleInterval); }
+
+	/// @brief Gets allocation statistics totaled across all threads
+	void get_stats(allocation_stats& stats) const volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		stats = allocation_stats();
+		for (size_t i = 0; i < size_class_count; i++)
+			nonVolatileThis->m_unattributed[i].get(stats.m_sizeClasses[i]);
+		for (thread_record* r = atomic::load(nonVolatileThis->m_threadRecords); !!r; r = r->m_next)
+		{
+			if (atomic::load(r->m_inUse) != 0)
+			{
+				for (size_t i = 0; i < size_class_count; i++)
+					r->m_sizeClasses[i].get(stats.m_sizeClasses[i]);
+			}
+		}
+		for (size_t i = 0; i < size_class_count; i++)
+			stats.m_total += stats.m_sizeClasses[i];
+	}
+
+	/// @brief Gets allocation statistics of each running thread.
+	///
+	/// Threads count the blocks they deallocate, which may have been allocated by other threads.
+	/// To determine allocation rates, compare counts retrieved at different times.
+	/// @param f Called with each thread's index and allocation_counters.  A thread's index is assigned in
+	/// the order in which threads first allocate, and is not reused.
+	template <typename F>
+	void for_each_thread(F&& f) const volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		for (thread_record* r = atomic::load(nonVolatileThis->m_threadRecords); !!r; r = r->m_next)
+		{
+			if (atomic::load(r->m_inUse) != 0)
+			{
+				allocation_counters c;
+				for (size_t i = 0; i < size_class_count; i++)
+					r->m_sizeClasses[i].get(c);
+				f(atomic::load(r->m_threadIndex), c);
+			}
+		}
+	}
+
+	/// @brief Writes sampled call stacks in the legacy heap profile format read by pprof
+	/// @param f File to write to
+	/// @return False if a write failed
+	bool write_heap_profile(FILE* f) const volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		allocation_counters total;
+		for (size_t i = 0; i < max_stacks; i++)
+		{
+			stack_bucket* b = atomic::load(nonVolatileThis->m_buckets[i]);
+			if (!!b)
+				b->m_counters.get(total);
+		}
+		nonVolatileThis->m_overflowBucket.m_counters.get(total);
+		fprintf(f, "heap profile: %zu: %zu [%zu: %zu] @ heap_v2/%zu\n", total.get_live_count(), total.get_live_bytes(), total.m_allocCount, total.m_allocBytes, get_sample_interval());
+
+		auto write_bucket = [&](stack_bucket* b)
+		{
+			allocation_counters c;
+			b->m_counters.get(c);
+			if (!c.m_allocCount)
+				return;
+			fprintf(f, "%zu: %zu [%zu: %zu] @", c.get_live_count(), c.get_live_bytes(), c.m_allocCount, c.m_allocBytes);
+			for (size_t j = 0; j < b->m_depth; j++)
+				fprintf(f, " 0x%zx", (size_t)b->m_frames[j]);
+			fprintf(f, "\n");
+		};
+		for (size_t i = 0; i < max_stacks; i++)
+		{
+			stack_bucket* b = atomic::load(nonVolatileThis->m_buckets[i]);
+			if (!!b)
+				write_bucket(b);
+		}
+		write_bucket(&nonVolatileThis->m_overflowBucket);
+
+		// pprof uses the memory map to symbolize addresses
+		FILE* maps = fopen("/proc/self/maps", "r");
+		if (!!maps)
+		{
+			fprintf(f, "\nMAPPED_LIBRARIES:\n");
+			char buf[4096];
+			size_t n;
+			while ((n = fread(buf, 1, sizeof(buf), maps)) > 0)
+				fwrite(buf, 1, n, f);
+			fclose(maps);
+		}
+		return !ferror(f);
+	}
+
+	/// @brief Writes sampled call stacks to a file, in the legacy heap profile format read by pprof
+	/// @param path Path of the file to create
+	/// @return False if the file could not be written
+	bool dump_heap_profile(const char* path) const volatile
+	{
+		FILE* f = fopen(path, "w");
+		if (!f)
+			return false;
+		bool result = write_heap_profile(f);
+		return (fclose(f) == 0) && result;
+	}
+};
+
+
+}
+
+
+#endif
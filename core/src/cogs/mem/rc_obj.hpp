@@ -9,6 +9,8 @@
 #define COGS_HEADER_MEM_RC_OBJ
 
 
+#include <type_traits>
+
 #include "cogs/mem/default_memory_manager.hpp"
 #include "cogs/mem/placement.hpp"
 #include "cogs/mem/placement_header.hpp"
@@ -56,6 +58,13 @@ private:
 		default_memory_manager::destruct_deallocate_type(this);
 	}
 
+#if COGS_DEFERRED_RC_RELEASE
+	virtual bool is_release_deferrable() const
+	{
+		return std::is_base_of_v<deferred_release_object, std::remove_cv_t<type> >;
+	}
+#endif
+
 	rc_obj(this_t&&) = delete;
 	rc_obj(const this_t&) = delete;
 	this_t& operator=(this_t&&) = delete;
@@ -74,6 +83,32 @@ public:
 	type* get_object() { return &m_contents.get(); }
 };
 
+
+/// @brief A reference-counted object container, allocated from a memory manager other than default_memory_manager.
+///
+/// When disposed, it is deallocated using the memory manager it was allocated from.
+/// @tparam T Type to contain
+/// @tparam memory_manager_t Memory manager type.  A non-static memory manager must outlive the object.
+template <typename T, class memory_manager_t>
+class memory_manager_rc_obj : public rc_obj<T>
+{
+private:
+	memory_manager_t* m_memoryManager;
+
+	virtual void dispose()
+	{
+		if constexpr (std::remove_cv_t<memory_manager_t>::is_static)
+			std::remove_cv_t<memory_manager_t>::destruct_deallocate_type(this);
+		else
+			m_memoryManager->destruct_deallocate_type(this);
+	}
+
+public:
+	explicit memory_manager_rc_obj(memory_manager_t& mm)
+		: m_memoryManager(&mm)
+	{ }
+};
+
 }
 
 
@@ -17,19 +17,58 @@
 #include "cogs/debug.hpp"
 #include "cogs/env.hpp"
 #include "cogs/env/mem/alignment.hpp"
+#include "cogs/env/mem/memory_manager.hpp"
 #include "cogs/math/boolean.hpp"
+#include "cogs/math/const_max_int.hpp"
 #include "cogs/mem/placement.hpp"
 #include "cogs/mem/ptr.hpp"
 #include "cogs/operators.hpp"
 #include "cogs/sync/hazard.hpp"
 
 
+#ifndef COGS_DEFERRED_RC_RELEASE
+
+/// @brief If non-zero, support for deferred release of reference-counted objects is enabled.
+///
+/// On a thread with deferred release enabled (see rc_obj_base::set_deferred_release()), when the last strong
+/// reference to an object derived from deferred_release_object is released, the object is not destructed
+/// immediately.  It is destructed later, by rc_obj_base::process_deferred_releases(), which processes a bounded
+/// number of objects per call.  Objects released by the destructor of a deferred object are also deferred, so
+/// tearing down a large graph of objects does not occur all at once, nor recursively.
+///
+/// thread_pool threads enable deferred release, and process a batch of deferred releases after each task.
+#define COGS_DEFERRED_RC_RELEASE 0
+#endif
+
+
+#ifndef COGS_DEFERRED_RC_RELEASE_BATCH_SIZE
+
+/// @brief The number of deferred releases processed by a thread_pool thread after each task
+#define COGS_DEFERRED_RC_RELEASE_BATCH_SIZE 64
+#endif
+
+
 namespace cogs {
 
 
 class rc_obj_base;
 
 
+/// @ingroup Mem
+/// @brief A base class for reference-counted objects whose destruction may be deferred.
+///
+/// When COGS_DEFERRED_RC_RELEASE is enabled, and the last strong reference to an object derived from
+/// deferred_release_object is released on a thread with deferred release enabled, the object is destructed later,
+/// by rc_obj_base::process_deferred_releases().  Once its last strong reference has been released, weak references
+/// to the object cannot be used to acquire a strong reference, even if it has not yet been destructed.
+///
+/// Other objects are always released immediately.  This includes the internal nodes of lock-free containers,
+/// which rely on being released synchronously.
+class deferred_release_object
+{
+};
+
+
 /// @ingroup Mem
 /// @brief The strength type of a reference.  Weak references are conditional to strong references remaining in scope.
 ///
@@ -133,6 +172,76 @@ private:
 
 	inline static placement<hazard> s_hazard;
 
+	void complete_release()
+	{
+		if (run_released_handlers())
+		{
+			released();
+			release_weak();
+		}
+	}
+
+#if COGS_DEFERRED_RC_RELEASE
+	// A stack of objects released by a thread, but not yet destructed
+	class deferred_releases
+	{
+	public:
+		rc_obj_base** m_releases;
+		size_t m_count;
+		size_t m_capacity;
+		bool m_enabled;
+
+		deferred_releases()
+			: m_releases(nullptr),
+			m_count(0),
+			m_capacity(0),
+			m_enabled(false)
+		{ }
+
+		~deferred_releases()
+		{
+			process(const_max_int_v<size_t>);
+			m_enabled = false;
+			if (!!m_releases)
+				env::memory_manager::deallocate(m_releases);
+		}
+
+		bool push(rc_obj_base* desc)
+		{
+			if (m_count == m_capacity)
+			{
+				size_t newCapacity = !m_capacity ? COGS_DEFERRED_RC_RELEASE_BATCH_SIZE : (m_capacity * 2);
+				rc_obj_base** newReleases = (rc_obj_base**)env::memory_manager::allocate(sizeof(rc_obj_base*) * newCapacity, alignof(rc_obj_base*));
+				if (!newReleases)
+					return false;
+				if (!!m_releases)
+				{
+					for (size_t i = 0; i < m_count; i++)
+						newReleases[i] = m_releases[i];
+					env::memory_manager::deallocate(m_releases);
+				}
+				m_releases = newReleases;
+				m_capacity = newCapacity;
+			}
+			m_releases[m_count++] = desc;
+			return true;
+		}
+
+		bool process(size_t maxReleases)
+		{
+			// Objects released by the destructor of a deferred object are pushed onto the stack, and processed
+			// by subsequent iterations, so the depth of the call stack does not grow.
+			for (size_t i = 0; !!m_count && (i < maxReleases); i++)
+				m_releases[--m_count]->complete_release();
+			return !!m_count;
+		}
+	};
+
+	inline static thread_local deferred_releases s_deferredReleases;
+
+	virtual bool is_release_deferrable() const { return false; }
+#endif
+
 #if COGS_DEBUG_LEAKED_REF_DETECTION
 public:
 	class tracking_header : public slink_t<tracking_header>
@@ -486,17 +595,48 @@ public:
 			} while (!atomic::compare_exchange(m_counts[reference_strength::strong], oldCount - i, oldCount, oldCount));
 			if (oldCount == i)
 			{
-				if (run_released_handlers())
+#if COGS_DEFERRED_RC_RELEASE
+				if (is_release_deferrable())
 				{
-					released();
-					release_weak();
+					deferred_releases& deferred = s_deferredReleases;
+					if (deferred.m_enabled && deferred.push(this))
+						return true;
 				}
+#endif
+				complete_release();
 				return true;
 			}
 		}
 		return false;
 	}
 
+#if COGS_DEFERRED_RC_RELEASE
+	/// @brief Enables or disables deferred release on the calling thread.
+	///
+	/// When disabled, all objects with deferred releases pending on the calling thread are destructed.
+	/// @param enable True to enable deferred release, false to disable it
+	static void set_deferred_release(bool enable)
+	{
+		deferred_releases& deferred = s_deferredReleases;
+		if (!enable)
+			deferred.process(const_max_int_v<size_t>);
+		deferred.m_enabled = enable;
+	}
+
+	static bool is_deferred_release_enabled() { return s_deferredReleases.m_enabled; }
+
+	/// @brief Destructs objects whose last strong reference was released by the calling thread, while deferred release was enabled.
+	/// @param maxReleases The maximum number of objects to destruct.  Objects released by their destructors are included.
+	/// @return True if deferred releases remain to be processed
+	static bool process_deferred_releases(size_t maxReleases = const_max_int_v<size_t>)
+	{
+		return s_deferredReleases.process(maxReleases);
+	}
+
+	/// @brief Gets the number of deferred releases pending on the calling thread
+	static size_t get_deferred_release_count() { return s_deferredReleases.m_count; }
+#endif
+
 	bool release_weak(size_t i = 1)
 	{
 #if COGS_DEBUG_LEAKED_REF_DETECTION
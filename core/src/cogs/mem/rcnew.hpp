@@ -64,8 +64,20 @@ type* rcnew_glue(
 	std::enable_if_t<!has_allocate_v<memory_manager_t>, memory_manager_t&&> mm,
 	const rcnew_glue_obj_t& temp = rcnew_glue_obj_t())
 {
-	rc_obj<type>* desc = mm.template allocate_type<rc_obj<type> >();
-	new (desc) rc_obj<type>;
+	typedef std::remove_reference_t<memory_manager_t> memory_manager_type;
+	rc_obj<type>* desc;
+	if constexpr (std::is_same_v<std::remove_cv_t<memory_manager_type>, default_memory_manager>)
+	{
+		desc = mm.template allocate_type<rc_obj<type> >();
+		new (desc) rc_obj<type>;
+	}
+	else
+	{
+		// Deallocated using the same memory manager
+		memory_manager_rc_obj<type, memory_manager_type>* mmDesc = mm.template allocate_type<memory_manager_rc_obj<type, memory_manager_type> >();
+		new (mmDesc) memory_manager_rc_obj<type, memory_manager_type>(mm);
+		desc = mmDesc;
+	}
 	type* obj = desc->get_object();
 
 #if COGS_DEBUG_LEAKED_REF_DETECTION || COGS_DEBUG_RC_LOGGING
@@ -155,6 +167,7 @@ struct rcnew_glue_t
 
 
 #define rcnew(type) (::cogs::rcref<type>)(::cogs::rcnew_glue_t<type>)new (::cogs::rcnew_glue<type, decltype(::cogs::default_memory_manager())>(COGS_DEBUG_AT, ::cogs::default_memory_manager())) type
+#define rcnew_with(mm, type) (::cogs::rcref<type>)(::cogs::rcnew_glue_t<type>)new (::cogs::rcnew_glue<type, decltype(mm)&>(COGS_DEBUG_AT, (mm))) type
 #define placement_rcnew(rcObjPtr) (::cogs::rcref<typename std::remove_pointer_t<decltype(rcObjPtr)>::type>)(::cogs::rcnew_glue_t<typename std::remove_pointer_t<decltype(rcObjPtr)>::type>)new (::cogs::rcnew_glue(COGS_DEBUG_AT, (rcObjPtr))) typename std::remove_pointer_t<decltype(rcObjPtr)>::type
 #define nested_rcnew(objPtr, descRef) (void)!(::cogs::rcnew_glue_t<std::remove_pointer_t<decltype(objPtr)> >)new (::cogs::rcnew_glue(COGS_DEBUG_AT, rc_container_content_t<std::remove_pointer_t<decltype(objPtr)> >({ (objPtr), &(descRef) }))) std::remove_pointer_t<decltype(objPtr)>
 
@@ -163,6 +176,7 @@ struct rcnew_glue_t
 
 
 #define rcnew(type) (::cogs::rcref<type>)(::cogs::rcnew_glue_t<type>)new (::cogs::rcnew_glue<type, decltype(::cogs::default_memory_manager())>(::cogs::default_memory_manager())) type
+#define rcnew_with(mm, type) (::cogs::rcref<type>)(::cogs::rcnew_glue_t<type>)new (::cogs::rcnew_glue<type, decltype(mm)&>((mm))) type
 #define placement_rcnew(rcObjPtr) (::cogs::rcref<typename std::remove_pointer_t<decltype(rcObjPtr)>::type>)(::cogs::rcnew_glue_t<typename std::remove_pointer_t<decltype(rcObjPtr)>::type>)new (::cogs::rcnew_glue((rcObjPtr))) typename std::remove_pointer_t<decltype(rcObjPtr)>::type
 #define nested_rcnew(objPtr, descRef) (void)!(::cogs::rcnew_glue_t<std::remove_pointer_t<decltype(objPtr)> >)new (::cogs::rcnew_glue(rc_container_content_t<std::remove_pointer_t<decltype(objPtr)> >({ (objPtr), &(descRef) }))) std::remove_pointer_t<decltype(objPtr)>
 
@@ -0,0 +1,419 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_MEM_SLAB_MEMORY_MANAGER
+#define COGS_HEADER_MEM_SLAB_MEMORY_MANAGER
+
+#include <cstring>
+
+#include "cogs/env.hpp"
+#include "cogs/env/mem/memory_manager.hpp"
+#include "cogs/mem/memory_manager_base.hpp"
+#include "cogs/mem/ptr.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+#include "cogs/sync/versioned_ptr.hpp"
+
+
+namespace cogs {
+
+/// @ingroup Mem
+/// @brief A lock-free memory manager that allocates blocks from slabs of fixed-size blocks, in fine-grained size classes.
+///
+/// Size classes are: 8, 16, 24, 32, 48, 64, 80, 96, 112, 128, then 4 classes per power of 2 (i.e. 160, 192, 224, 256, 320, ...),
+/// up to 8192 bytes.  Blocks have no per-block overhead.  The size class of a block is found from the slab containing it.
+///
+/// Each slab is slab_size bytes, aligned to slab_size, and contains blocks of a single size class.  Freed blocks are
+/// kept on a free list per size class, for reuse by blocks of that size class.  Slabs are not released until the
+/// slab_memory_manager is destroyed.  Larger blocks, and blocks requiring alignment greater than 16 bytes, are allocated
+/// directly from the large block memory manager.
+/// @tparam slab_size Size of each slab.  Must be a power of 2, and at least 8192.  Default: 64KB
+/// @tparam large_block_memory_manager_type Memory manager to use to allocate slabs, and blocks too large for a slab.  Default: env::memory manager
+template <size_t slab_size = 1024 * 64, class large_block_memory_manager_type = env::memory_manager>
+class slab_memory_manager : public memory_manager_base<slab_memory_manager<slab_size, large_block_memory_manager_type>, false>
+{
+public:
+	typedef slab_memory_manager<slab_size, large_block_memory_manager_type> this_t;
+
+	static constexpr size_t max_block_size = 8192;
+
+private:
+	static_assert((slab_size & (slab_size - 1)) == 0);
+	static_assert(slab_size >= max_block_size);
+
+	static constexpr size_t small_class_count = 10;
+	static constexpr size_t small_class_max = 128;
+
+	static constexpr size_t get_class_size(size_t i)
+	{
+		constexpr size_t small_class_sizes[small_class_count] = { 8, 16, 24, 32, 48, 64, 80, 96, 112, 128 };
+		if (i < small_class_count)
+			return small_class_sizes[i];
+		i -= small_class_count;
+		size_t base = small_class_max << (i / 4);
+		return base + ((i % 4) + 1) * (base / 4);
+	}
+
+	static constexpr size_t get_class_count()
+	{
+		size_t i = small_class_count;
+		while (get_class_size(i) < max_block_size)
+			i++;
+		return i + 1;
+	}
+
+	static constexpr size_t get_slab_shift()
+	{
+		size_t i = 0;
+		while (((size_t)1 << i) < slab_size)
+			i++;
+		return i;
+	}
+
+	// Slab indexes are mapped to size classes by a 3 level radix tree.
+	static constexpr size_t slab_shift = get_slab_shift();
+	static constexpr size_t address_bits = (sizeof(void*) >= 8) ? 48 : (sizeof(void*) * 8);
+	static constexpr size_t index_bits = address_bits - slab_shift;
+	static constexpr size_t leaf_bits = index_bits / 3;
+	static constexpr size_t node_bits = index_bits / 3;
+	static constexpr size_t root_bits = index_bits - (leaf_bits + node_bits);
+
+	class leaf
+	{
+	public:
+		unsigned char m_classes[(size_t)1 << leaf_bits]; // size class + 1, or 0 if not a slab
+	};
+
+	class node
+	{
+	public:
+		leaf* m_leaves[(size_t)1 << node_bits];
+	};
+
+	class free_block
+	{
+	public:
+		ptr<free_block> m_next;
+	};
+
+	typedef typename versioned_ptr<free_block>::version_t version_t;
+
+	class size_class
+	{
+	public:
+		volatile versioned_ptr<free_block> m_head;
+	};
+
+	large_block_memory_manager_type m_largeBlockMemoryManager;
+	node* m_root[(size_t)1 << root_bits];
+	size_class m_classes[get_class_count()];
+	void* m_slabs alignas(atomic::get_alignment_v<void*>); // List of all slabs, linked by the last pointer in each slab
+
+	large_block_memory_manager_type& get_large_block_memory_manager() const volatile
+	{
+		return const_cast<this_t*>(this)->m_largeBlockMemoryManager;
+	}
+
+	this_t* get_this() const volatile { return const_cast<this_t*>(this); }
+
+	template <typename T>
+	T* allocate_zeroed()
+	{
+		T* result = (T*)get_large_block_memory_manager().allocate(sizeof(T));
+		if (!!result)
+			memset(result, 0, sizeof(T));
+		return result;
+	}
+
+	// Records the size class of a slab.  Returns false if the slab address cannot be represented.
+	bool register_slab(void* slab, size_t sizeClass)
+	{
+		size_t index = (size_t)slab >> slab_shift;
+		if (!!(index >> index_bits))
+			return false;
+		size_t rootIndex = index >> (leaf_bits + node_bits);
+		size_t nodeIndex = (index >> leaf_bits) & (((size_t)1 << node_bits) - 1);
+		size_t leafIndex = index & (((size_t)1 << leaf_bits) - 1);
+		node* n = atomic::load(m_root[rootIndex]);
+		if (!n)
+		{
+			node* newNode = allocate_zeroed<node>();
+			if (!newNode)
+				return false;
+			if (atomic::compare_exchange(m_root[rootIndex], newNode, n, n))
+				n = newNode;
+			else
+				get_large_block_memory_manager().deallocate(newNode);
+		}
+		leaf* l = atomic::load(n->m_leaves[nodeIndex]);
+		if (!l)
+		{
+			leaf* newLeaf = allocate_zeroed<leaf>();
+			if (!newLeaf)
+				return false;
+			if (atomic::compare_exchange(n->m_leaves[nodeIndex], newLeaf, l, l))
+				l = newLeaf;
+			else
+				get_large_block_memory_manager().deallocate(newLeaf);
+		}
+		atomic::store(l->m_classes[leafIndex], (unsigned char)(sizeClass + 1));
+		return true;
+	}
+
+	// Allocates a new slab for a size class, and returns the number of blocks it contains
+	void* allocate_slab(size_t sizeClass, size_t& blockCount)
+	{
+		void* slab = get_large_block_memory_manager().allocate(slab_size, slab_size);
+		if (!slab)
+			return nullptr;
+		if (!register_slab(slab, sizeClass))
+		{
+			get_large_block_memory_manager().deallocate(slab);
+			return nullptr;
+		}
+		blockCount = slab_size / get_class_size(sizeClass);
+
+		// The slab's list link occupies the end of the slab, if not used by a block.  Otherwise, its last block is reserved for it.
+		size_t blockSize = get_class_size(sizeClass);
+		size_t linkOffset = slab_size - sizeof(void*);
+		if ((blockCount * blockSize) > linkOffset)
+			blockCount--;
+		void** lnk = (void**)((unsigned char*)slab + linkOffset);
+		void* oldHead = atomic::load(m_slabs);
+		do {
+			*lnk = oldHead;
+		} while (!atomic::compare_exchange(m_slabs, slab, oldHead, oldHead));
+		return slab;
+	}
+
+	// Links a contiguous run of blocks, and pushes them to the free list of a size class
+	void push_blocks(size_t sizeClass, unsigned char* first, size_t n)
+	{
+		if (!n)
+			return;
+		size_t blockSize = get_class_size(sizeClass);
+		free_block* head = (free_block*)first;
+		free_block* tail = head;
+		for (size_t i = 1; i < n; i++)
+		{
+			free_block* next = (free_block*)(first + (i * blockSize));
+			tail->m_next = next;
+			tail = next;
+		}
+		push_chain(sizeClass, head, tail);
+	}
+
+	void push_chain(size_t sizeClass, free_block* head, free_block* tail)
+	{
+		volatile versioned_ptr<free_block>& listHead = m_classes[sizeClass].m_head;
+		ptr<free_block> oldHead;
+		version_t v;
+		listHead.get(oldHead, v);
+		do {
+			tail->m_next = oldHead;
+		} while (!listHead.versioned_exchange(head, v, oldHead));
+	}
+
+	free_block* pop(size_t sizeClass)
+	{
+		volatile versioned_ptr<free_block>& listHead = m_classes[sizeClass].m_head;
+		ptr<free_block> newHead;
+		ptr<free_block> oldHead;
+		version_t v;
+		listHead.get(oldHead, v);
+		do {
+			if (!oldHead)
+				break;
+			newHead = oldHead->m_next; // May be stale, but slabs are never released, so it's safe to read.  The version will mismatch.
+		} while (!listHead.versioned_exchange(newHead, v, oldHead));
+		return oldHead.get_ptr();
+	}
+
+	// Removes the entire free list of a size class
+	free_block* pop_all(size_t sizeClass)
+	{
+		volatile versioned_ptr<free_block>& listHead = m_classes[sizeClass].m_head;
+		ptr<free_block> oldHead;
+		version_t v;
+		listHead.get(oldHead, v);
+		do {
+			if (!oldHead)
+				break;
+		} while (!listHead.versioned_exchange(ptr<free_block>(), v, oldHead));
+		return oldHead.get_ptr();
+	}
+
+public:
+	/// @brief The number of size classes of blocks managed by the slab_memory_manager
+	static constexpr size_t size_class_count = get_class_count();
+
+	slab_memory_manager()
+		: m_slabs(nullptr)
+	{
+		for (size_t i = 0; i < ((size_t)1 << root_bits); i++)
+			m_root[i] = nullptr;
+	}
+
+	~slab_memory_manager()
+	{
+		void* slab = m_slabs;
+		while (!!slab)
+		{
+			void* next = *(void**)((unsigned char*)slab + (slab_size - sizeof(void*)));
+			m_largeBlockMemoryManager.deallocate(slab);
+			slab = next;
+		}
+		for (size_t i = 0; i < ((size_t)1 << root_bits); i++)
+		{
+			node* n = m_root[i];
+			if (!!n)
+			{
+				for (size_t j = 0; j < ((size_t)1 << node_bits); j++)
+				{
+					if (!!n->m_leaves[j])
+						m_largeBlockMemoryManager.deallocate(n->m_leaves[j]);
+				}
+				m_largeBlockMemoryManager.deallocate(n);
+			}
+		}
+	}
+
+	/// @brief Gets the size class used to allocate a block of n bytes.  Returns size_class_count if not allocated from a slab.
+	static size_t get_size_class(size_t n, size_t align = cogs::largest_alignment)
+	{
+		if (align > 16)
+			return size_class_count;
+		if (align > 8)
+			n = (n + 15) & ~(size_t)15; // Classes with sizes that are multiples of 16 are 16-byte aligned
+		if (n <= small_class_max)
+		{
+			constexpr unsigned char small_classes[(small_class_max / 8) + 1] = { 0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9 };
+			return small_classes[(n + 7) / 8];
+		}
+		if (n > max_block_size)
+			return size_class_count;
+		size_t b = bit_scan_reverse(n - 1);
+		size_t base = (size_t)1 << b;
+		size_t step = base / 4;
+		return small_class_count + ((b - 7) * 4) + (((n - base) + (step - 1)) / step) - 1;
+	}
+
+	/// @brief Gets the usable size of blocks of a size class
+	static constexpr size_t get_size_class_block_size(size_t sizeClass) { return get_class_size(sizeClass); }
+
+	/// @brief Gets the size class of an allocated block.  Returns size_class_count if not allocated from a slab.
+	size_t get_block_size_class(void* p) const volatile
+	{
+		size_t index = (size_t)p >> slab_shift;
+		if (!!(index >> index_bits))
+			return size_class_count;
+		node* n = atomic::load(get_this()->m_root[index >> (leaf_bits + node_bits)]);
+		if (!n)
+			return size_class_count;
+		leaf* l = atomic::load(n->m_leaves[(index >> leaf_bits) & (((size_t)1 << node_bits) - 1)]);
+		if (!l)
+			return size_class_count;
+		size_t c = atomic::load(l->m_classes[index & (((size_t)1 << leaf_bits) - 1)]);
+		return !c ? size_class_count : (c - 1);
+	}
+
+	/// @brief Allocates multiple blocks of the same size class.
+	///
+	/// Blocks are taken from the size class's free list, or carved from a new slab, at the cost of a single allocation.
+	/// Fewer than n blocks may be returned.  Each block is deallocated individually, with deallocate().
+	/// @param sizeClass Size class of blocks to allocate, as returned by get_size_class().  Must be less than size_class_count.
+	/// @param blocks Receives pointers to the allocated blocks
+	/// @param n Maximum number of blocks to allocate
+	/// @return The number of blocks allocated.  0 if out of memory.
+	size_t allocate_batch(size_t sizeClass, void** blocks, size_t n) volatile
+	{
+		COGS_ASSERT(sizeClass < size_class_count);
+		COGS_ASSERT(n > 0);
+		this_t* nonVolatileThis = get_this();
+		size_t result = 0;
+		free_block* fb = nonVolatileThis->pop_all(sizeClass);
+		if (!!fb)
+		{
+			do {
+				blocks[result++] = fb;
+				fb = fb->m_next.get_ptr();
+			} while (!!fb && (result < n));
+			if (!!fb)
+			{
+				free_block* tail = fb;
+				while (!!tail->m_next)
+					tail = tail->m_next.get_ptr();
+				nonVolatileThis->push_chain(sizeClass, fb, tail);
+			}
+			return result;
+		}
+		size_t blockCount;
+		unsigned char* slab = (unsigned char*)nonVolatileThis->allocate_slab(sizeClass, blockCount);
+		if (!slab)
+		{
+			COGS_ASSERT(false); // For now, let's consider out of memory to be a fatal error
+			return 0; // TBD ?
+		}
+		size_t blockSize = get_class_size(sizeClass);
+		if (n > blockCount)
+			n = blockCount;
+		for (; result < n; result++)
+			blocks[result] = slab + (result * blockSize);
+		nonVolatileThis->push_blocks(sizeClass, slab + (n * blockSize), blockCount - n);
+		return result;
+	}
+
+	void* allocate(size_t n, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		this_t* nonVolatileThis = get_this();
+		size_t sizeClass = get_size_class(n, align);
+		if (sizeClass == size_class_count)
+			return get_large_block_memory_manager().allocate(n, (align < cogs::largest_alignment) ? cogs::largest_alignment : align, usableSize);
+		void* result = nonVolatileThis->pop(sizeClass);
+		if (!result)
+			allocate_batch(sizeClass, &result, 1);
+		if (!!usableSize)
+			*usableSize = get_class_size(sizeClass);
+		return result;
+	}
+
+	void deallocate(void* p) volatile
+	{
+		if (!p)
+			return;
+		size_t sizeClass = get_block_size_class(p);
+		if (sizeClass == size_class_count)
+			get_large_block_memory_manager().deallocate(p);
+		else
+		{
+			free_block* fb = (free_block*)p;
+			get_this()->push_chain(sizeClass, fb, fb);
+		}
+	}
+
+	bool try_reallocate(void* p, size_t newSize, size_t align = cogs::largest_alignment, size_t* usableSize = nullptr) volatile
+	{
+		if (!p)
+			return false;
+		size_t sizeClass = get_block_size_class(p);
+		if (sizeClass == size_class_count)
+			return get_large_block_memory_manager().try_reallocate(p, newSize, align, usableSize);
+		size_t blockSize = get_class_size(sizeClass);
+		if ((newSize > blockSize) || (align > 16))
+			return false;
+		if (!!usableSize)
+			*usableSize = blockSize;
+		return true;
+	}
+};
+
+
+}
+
+
+#endif
@@ -9,7 +9,14 @@
 #define COGS_HEADER_SYNC_DISPATCH_PARALLEL
 
 
+#include "cogs/collections/map.hpp"
 #include "cogs/function.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/mem/object.hpp"
+#include "cogs/mem/rcnew.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/dispatcher.hpp"
 #include "cogs/sync/thread_pool.hpp"
 
 
@@ -55,6 +62,160 @@ dispatch_parallel(size_t n, F&& f, int priority = 0)
 }
 
 
+template <typename F, typename D>
+inline std::enable_if_t<
+	std::is_invocable_v<F, size_t, size_t>
+	&& std::is_invocable_v<D>,
+	void>
+dispatch_parallel_range(size_t n, F&& f, D&& doneFunc, size_t grainSize = 0, int priority = 0)
+{
+	{
+		rcptr<thread_pool> pool = thread_pool::get_default();
+		if (!!pool)
+		{
+			pool->dispatch_parallel_range(n, std::forward<F>(f), std::forward<D>(doneFunc), grainSize, priority);
+			return;
+		}
+
+		if (!!n)
+			f(0, n);
+	}
+
+	doneFunc();
+}
+
+
+template <typename F>
+inline std::enable_if_t<
+	std::is_invocable_v<F, size_t, size_t>,
+	void>
+dispatch_parallel_range(size_t n, F&& f, size_t grainSize = 0, int priority = 0)
+{
+	dispatch_parallel_range(n, std::forward<F>(f), []() {}, grainSize, priority);
+}
+
+
+/// @brief Invokes a delegate for each index in [begin, end), in parallel, using the default thread pool
+///
+/// Indexes are processed in chunks.  See thread_pool::dispatch_parallel_range().
+/// The caller should not wait for the returned task from a thread of the default thread pool.
+/// @param begin First index
+/// @param end One past the last index
+/// @param f Delegate to invoke, accepting a size_t index
+/// @param grainSize The number of indexes to claim at once, or 0 for guided chunk sizes.  Default: 0
+/// @param priority Priority.  Default: 0
+/// @return A task that completes when all indexes have been processed
+template <typename F>
+inline std::enable_if_t<
+	std::is_invocable_v<F, size_t>,
+	rcref<task<void> > >
+parallel_for(size_t begin, size_t end, F&& f, size_t grainSize = 0, int priority = 0)
+{
+	rcref<signallable_task<void> > t = rcnew(signallable_task<void>);
+	size_t n = (end > begin) ? (end - begin) : 0;
+	dispatch_parallel_range(n, [begin, f{ std::forward<F>(f) }](size_t i, size_t chunkEnd)
+	{
+		for (; i != chunkEnd; i++)
+			f(begin + i);
+	}, [t]() { t->signal(); }, grainSize, priority);
+	return t.template static_cast_to<task<void> >();
+}
+
+
+/// @brief Reduces the range [begin, end) in parallel, using the default thread pool
+///
+/// The range is divided into chunks.  Each chunk is reduced by calling f(chunkBegin, chunkEnd, identity),
+/// and the results of all chunks are combined in index order using r.  r must be associative, but need not be commutative.
+/// The caller should not wait for the returned task from a thread of the default thread pool.
+/// @param begin First index
+/// @param end One past the last index
+/// @param identity The identity value of the reduction.  The result if the range is empty.
+/// @param f Delegate to reduce a range, with the signature: T f(size_t begin, size_t end, const T& init)
+/// @param r Delegate to combine 2 results, with the signature: T r(const T& a, const T& b)
+/// @param grainSize The number of indexes to claim at once, or 0 for guided chunk sizes.  Default: 0
+/// @param priority Priority.  Default: 0
+/// @return A task that completes with the result of the reduction
+template <typename T, typename F, typename R>
+inline std::enable_if_t<
+	std::is_invocable_r_v<T, F, size_t, size_t, const T&>
+	&& std::is_invocable_r_v<T, R, const T&, const T&>,
+	rcref<task<T> > >
+parallel_reduce(size_t begin, size_t end, const T& identity, F&& f, R&& r, size_t grainSize = 0, int priority = 0)
+{
+	// Each chunk's result is pushed to a lock-free LIFO.  Once all chunks have completed, they are combined in order.
+	class reduce_state : public object
+	{
+	public:
+		class partial
+		{
+		public:
+			partial* m_next;
+			size_t m_begin;
+			T m_value;
+
+			partial(size_t b, T&& v)
+				: m_begin(b),
+				m_value(std::move(v))
+			{ }
+		};
+
+		partial* m_head alignas(atomic::get_alignment_v<partial*>);
+		T m_identity;
+		std::remove_cv_t<std::remove_reference_t<R> > m_reduce;
+		rcref<signallable_task<T> > m_task;
+
+		reduce_state(const T& identity, R&& r)
+			: m_head(nullptr),
+			m_identity(identity),
+			m_reduce(std::forward<R>(r)),
+			m_task(rcnew(signallable_task<T>))
+		{ }
+
+		void add(size_t b, T&& v)
+		{
+			partial* p = default_memory_manager::allocate_type<partial>();
+			new (p) partial(b, std::move(v));
+			partial* oldHead = atomic::load(m_head);
+			do {
+				p->m_next = oldHead;
+			} while (!atomic::compare_exchange(m_head, p, oldHead, oldHead));
+		}
+
+		void complete()
+		{
+			nonvolatile_map<size_t, T> sorted;
+			partial* p = atomic::load(m_head);
+			m_head = nullptr;
+			while (!!p)
+			{
+				partial* next = p->m_next;
+				sorted.insert_replace(p->m_begin, std::move(p->m_value));
+				default_memory_manager::destruct_deallocate_type(p);
+				p = next;
+			}
+			typename nonvolatile_map<size_t, T>::iterator i = sorted.get_first();
+			if (!i)
+			{
+				m_task->signal(m_identity);
+				return;
+			}
+			T result = std::move(i->value);
+			while (!!++i)
+				result = m_reduce(result, i->value);
+			m_task->signal(std::move(result));
+		}
+	};
+
+	rcref<reduce_state> state = rcnew(reduce_state)(identity, std::forward<R>(r));
+	size_t n = (end > begin) ? (end - begin) : 0;
+	dispatch_parallel_range(n, [begin, state, f{ std::forward<F>(f) }](size_t i, size_t chunkEnd)
+	{
+		state->add(i, f(begin + i, begin + chunkEnd, state->m_identity));
+	}, [state]() { state->complete(); }, grainSize, priority);
+	return state->m_task.template static_cast_to<task<T> >();
+}
+
+
 }
 
 
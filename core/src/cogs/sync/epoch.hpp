@@ -0,0 +1,322 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_SYNC_EPOCH
+#define COGS_HEADER_SYNC_EPOCH
+
+
+#include <new>
+
+#include "cogs/debug.hpp"
+#include "cogs/env.hpp"
+#include "cogs/env/mem/memory_manager.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+
+
+#ifndef COGS_EPOCH_RECLAIM_THRESHOLD
+
+/// @brief The number of resources a thread retires between attempts to advance the epoch and reclaim resources
+#define COGS_EPOCH_RECLAIM_THRESHOLD 64
+#endif
+
+
+namespace cogs {
+
+
+/// @ingroup Synchronization
+/// @brief Prevents resources from being disposed while they may still be in use, using epoch-based reclamation.
+///
+/// epoch provides the same contract as cogs::hazard: a resource removed from a lock-free data structure is not
+/// disposed until no thread can still be referencing it.  Rather than protecting each pointer as it is read,
+/// a thread protects all pointers read within a critical section, delimited by the scope of an epoch::guard.
+/// Entering a critical section requires a single store and fence.  Reads within it do not.  This makes
+/// epoch well suited to read-mostly traversals of linked structures.
+///
+/// A resource is passed to epoch::retire() after it has been unlinked, so no new references to it can be obtained.
+/// It is disposed after every thread that was within a critical section at the time has left it.  Retired resources
+/// are disposed in batches, by the threads retiring them.
+///
+/// A thread that remains within a critical section prevents all resources retired after it entered from being
+/// disposed, so critical sections should be brief, and must not block.  Critical sections may be nested.
+class epoch
+{
+private:
+	class retired
+	{
+	public:
+		retired* m_next;
+		void* m_resource;
+		void (*m_dispose)(void*);
+		size_t m_epoch;
+	};
+
+	class thread_record
+	{
+	public:
+		thread_record* m_nextRecord; // Records are not removed from the registry.  Records of exited threads are reused.
+		size_t m_epoch alignas(atomic::get_alignment_v<size_t>); // (epoch << 1) | 1 while in a critical section, otherwise 0
+		int m_inUse alignas(atomic::get_alignment_v<int>);
+		size_t m_nesting;
+		retired* m_retired; // Most recently retired first
+		size_t m_retiredSinceReclaim;
+
+		thread_record()
+			: m_nextRecord(nullptr),
+			m_epoch(0),
+			m_inUse(1),
+			m_nesting(0),
+			m_retired(nullptr),
+			m_retiredSinceReclaim(0)
+		{ }
+	};
+
+	// Hands off the resources retired by a thread when it exits, and releases its record
+	class thread_record_holder
+	{
+	public:
+		thread_record* m_record;
+
+		thread_record_holder()
+			: m_record(nullptr)
+		{ }
+
+		~thread_record_holder()
+		{
+			thread_record* r = m_record;
+			m_record = nullptr;
+			if (!!r)
+			{
+				reclaim(*r);
+				if (!!r->m_retired)
+				{
+					push_orphans(r->m_retired);
+					r->m_retired = nullptr;
+				}
+				atomic::store(r->m_inUse, 0);
+			}
+		}
+	};
+
+	inline static size_t s_epoch alignas(atomic::get_alignment_v<size_t>) = 1;
+	inline static thread_record* s_records alignas(atomic::get_alignment_v<thread_record*>) = nullptr;
+	inline static retired* s_orphans alignas(atomic::get_alignment_v<retired*>) = nullptr; // Retired by exited threads
+	inline static thread_local thread_record_holder s_threadRecord;
+
+	static thread_record& get_thread_record()
+	{
+		thread_record* r = s_threadRecord.m_record;
+		if (!!r)
+			return *r;
+
+		// Reuse a record released by an exited thread, if there is one
+		for (r = atomic::load(s_records); !!r; r = r->m_nextRecord)
+		{
+			int oldInUse = 0;
+			if (atomic::load(r->m_inUse) == 0 && atomic::compare_exchange(r->m_inUse, 1, oldInUse))
+				break;
+		}
+		if (!r)
+		{
+			r = new (env::memory_manager::allocate(sizeof(thread_record), alignof(thread_record))) thread_record;
+			thread_record* oldHead = atomic::load(s_records);
+			do {
+				r->m_nextRecord = oldHead;
+			} while (!atomic::compare_exchange(s_records, r, oldHead, oldHead));
+		}
+		s_threadRecord.m_record = r;
+		return *r;
+	}
+
+	// The epoch can advance once every thread in a critical section has observed the current epoch
+	static size_t try_advance()
+	{
+		size_t e = atomic::load(s_epoch);
+		for (thread_record* r = atomic::load(s_records); !!r; r = r->m_nextRecord)
+		{
+			size_t localEpoch = atomic::load(r->m_epoch);
+			if (!!(localEpoch & 1) && ((localEpoch >> 1) != e))
+				return e;
+		}
+		size_t oldEpoch = e;
+		if (atomic::compare_exchange(s_epoch, e + 1, oldEpoch, oldEpoch))
+			return e + 1;
+		return oldEpoch;
+	}
+
+	// Disposes resources retired at least 2 epochs ago.  Returns the remaining resources.
+	static retired* dispose_expired(retired* list, size_t e)
+	{
+		// Resources are ordered from most to least recently retired.  Find the first that has expired.
+		retired** prev = &list;
+		retired* r = list;
+		while (!!r && (r->m_epoch + 2 > e))
+		{
+			prev = &r->m_next;
+			r = r->m_next;
+		}
+		*prev = nullptr;
+		while (!!r)
+		{
+			retired* next = r->m_next;
+			(*r->m_dispose)(r->m_resource);
+			env::memory_manager::deallocate(r);
+			r = next;
+		}
+		return list;
+	}
+
+	static void push_orphans(retired* list)
+	{
+		retired* tail = list;
+		while (!!tail->m_next)
+			tail = tail->m_next;
+		retired* oldHead = atomic::load(s_orphans);
+		do {
+			tail->m_next = oldHead;
+		} while (!atomic::compare_exchange(s_orphans, list, oldHead, oldHead));
+	}
+
+	static void reclaim(thread_record& r)
+	{
+		r.m_retiredSinceReclaim = 0;
+		size_t e = try_advance();
+		r.m_retired = dispose_expired(r.m_retired, e);
+
+		if (!!atomic::load(s_orphans))
+		{
+			// Orphaned lists from different threads are not ordered relative to each other.  Check every entry.
+			retired* orphans = atomic::exchange(s_orphans, (retired*)nullptr);
+			retired* remaining = nullptr;
+			while (!!orphans)
+			{
+				retired* next = orphans->m_next;
+				if (orphans->m_epoch + 2 <= e)
+				{
+					(*orphans->m_dispose)(orphans->m_resource);
+					env::memory_manager::deallocate(orphans);
+				}
+				else
+				{
+					orphans->m_next = remaining;
+					remaining = orphans;
+				}
+				orphans = next;
+			}
+			if (!!remaining)
+				push_orphans(remaining);
+		}
+	}
+
+	template <typename type>
+	static void dispose_type(void* p)
+	{
+		default_memory_manager::destruct_deallocate_type((type*)p);
+	}
+
+	static void enter()
+	{
+		thread_record& r = get_thread_record();
+		if (!r.m_nesting++)
+		{
+			// Sequentially consistent, so the store is visible before any protected pointer is read
+			atomic::store(r.m_epoch, (atomic::load(s_epoch) << 1) | 1);
+		}
+	}
+
+	static void exit()
+	{
+		thread_record& r = *s_threadRecord.m_record;
+		COGS_ASSERT(!!r.m_nesting);
+		if (!--r.m_nesting)
+		{
+			atomic::store(r.m_epoch, (size_t)0);
+			// Resources retired within the critical section are reclaimed once it has been left
+			if (r.m_retiredSinceReclaim >= COGS_EPOCH_RECLAIM_THRESHOLD)
+				reclaim(r);
+		}
+	}
+
+public:
+	/// @brief Delimits a critical section, within which resources read from a lock-free data structure
+	/// will not be disposed.
+	class guard
+	{
+	private:
+		guard(const guard&) = delete;
+		guard& operator=(const guard&) = delete;
+
+	public:
+		guard() { enter(); }
+		~guard() { exit(); }
+	};
+
+	/// @brief Disposes of a resource once no thread can still be referencing it.
+	///
+	/// The resource must already be unreachable by threads entering a critical section.
+	/// @param p Pointer to the resource
+	/// @param dispose Function to call to dispose of the resource
+	static void retire(void* p, void (*dispose)(void*))
+	{
+		thread_record& r = get_thread_record();
+		retired* rt = (retired*)env::memory_manager::allocate(sizeof(retired), alignof(retired));
+		rt->m_resource = p;
+		rt->m_dispose = dispose;
+		rt->m_epoch = atomic::load(s_epoch);
+		rt->m_next = r.m_retired;
+		r.m_retired = rt;
+		if (++r.m_retiredSinceReclaim >= COGS_EPOCH_RECLAIM_THRESHOLD && !r.m_nesting)
+			reclaim(r);
+	}
+
+	/// @brief Destructs and deallocates an object allocated using default_memory_manager, once no thread can still be referencing it.
+	/// @param p Pointer to the object
+	template <typename type>
+	static void retire(type* p)
+	{
+		retire((void*)p, &dispose_type<type>);
+	}
+
+	/// @brief Attempts to advance the epoch, and disposes resources retired by the calling thread that are no longer referenced.
+	///
+	/// Has no effect if called within a critical section.
+	static void reclaim()
+	{
+		thread_record& r = get_thread_record();
+		if (!r.m_nesting)
+			reclaim(r);
+	}
+
+	/// @brief Gets the number of resources retired by the calling thread that have not yet been disposed
+	static size_t get_retired_count()
+	{
+		thread_record* r = s_threadRecord.m_record;
+		size_t n = 0;
+		if (!!r)
+		{
+			for (retired* rt = r->m_retired; !!rt; rt = rt->m_next)
+				n++;
+		}
+		return n;
+	}
+
+	/// @brief Gets whether the calling thread is within a critical section
+	static bool is_in_critical_section()
+	{
+		thread_record* r = s_threadRecord.m_record;
+		return !!r && !!r->m_nesting;
+	}
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,144 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_SYNC_NUMA_THREAD_POOL
+#define COGS_HEADER_SYNC_NUMA_THREAD_POOL
+
+
+#include "cogs/env.hpp"
+#include "cogs/collections/vector.hpp"
+#include "cogs/mem/rcnew.hpp"
+#include "cogs/sync/dispatcher.hpp"
+#include "cogs/sync/processor_set.hpp"
+#include "cogs/sync/thread.hpp"
+#include "cogs/sync/thread_pool.hpp"
+
+
+namespace cogs {
+
+
+/// @ingroup Synchronization
+/// @brief A dispatcher comprised of one thread_pool per NUMA node.
+///
+/// Threads of each node's thread_pool are restricted to run on the processors of that node.  Tasks dispatched
+/// directly to the numa_thread_pool are queued to the pool of the node the dispatching thread is running on,
+/// so work dispatched by a thread of a node remains on that node.  To process data allocated on a particular
+/// node, dispatch to that node's pool, using get_node().
+///
+/// If NUMA topology is not available, a numa_thread_pool has a single node containing all processors.
+class numa_thread_pool : public dispatcher
+{
+private:
+	vector<rcptr<thread_pool> > m_nodePools; // Indexed by node.  Null for nodes without processors.
+	rcptr<thread_pool> m_fallbackPool; // Used for nodes without processors
+
+	numa_thread_pool(const numa_thread_pool&) = delete;
+	numa_thread_pool& operator=(const numa_thread_pool&) = delete;
+
+	virtual void dispatch_inner(const rcref<task_base>& t, int priority) volatile
+	{
+		numa_thread_pool* nonVolatileThis = const_cast<numa_thread_pool*>(this);
+		dispatcher::dispatch_inner(*nonVolatileThis->get_node(get_current_numa_node()), t, priority);
+	}
+
+public:
+	/// @brief Constructor
+	/// @param startNow If true, start() is called.  Default: false
+	/// @param workStealing Passed to the thread_pool of each node.  Default: COGS_THREAD_POOL_WORK_STEALING
+	explicit numa_thread_pool(bool startNow = false, bool workStealing = (COGS_THREAD_POOL_WORK_STEALING != 0))
+	{
+		unsigned int nodeCount = get_numa_node_count();
+		m_nodePools.resize(nodeCount);
+		for (unsigned int node = 0; node < nodeCount; node++)
+		{
+			processor_set processors = get_numa_node_processors(node);
+			size_t processorCount = processors.get_count();
+			if (!processorCount)
+				continue;
+			rcptr<thread_pool> pool = rcnew(thread_pool)(false, processorCount, workStealing, processors);
+			m_nodePools.get_ptr()[node] = pool;
+			if (!m_fallbackPool)
+				m_fallbackPool = pool;
+		}
+		if (!m_fallbackPool)
+		{
+			m_fallbackPool = rcnew(thread_pool)(false, thread_pool::get_default_size(), workStealing);
+			m_nodePools.get_ptr()[0] = m_fallbackPool;
+		}
+		if (startNow)
+			start();
+	}
+
+	~numa_thread_pool()
+	{
+		shutdown();
+		join();
+	}
+
+	void start()
+	{
+		for (size_t i = 0; i < m_nodePools.get_length(); i++)
+		{
+			if (!!m_nodePools[i])
+				m_nodePools[i]->start();
+		}
+	}
+
+	void shutdown()
+	{
+		for (size_t i = 0; i < m_nodePools.get_length(); i++)
+		{
+			if (!!m_nodePools[i])
+				m_nodePools[i]->shutdown();
+		}
+	}
+
+	void join()
+	{
+		for (size_t i = 0; i < m_nodePools.get_length(); i++)
+		{
+			if (!!m_nodePools[i])
+				m_nodePools[i]->join();
+		}
+	}
+
+	unsigned int get_node_count() const { return (unsigned int)m_nodePools.get_length(); }
+
+	/// @brief Gets the thread_pool of a NUMA node.
+	///
+	/// If the node has no processors, or does not exist, the pool of the first node with processors is returned.
+	rcref<thread_pool> get_node(unsigned int node) const
+	{
+		if (node < m_nodePools.get_length())
+		{
+			const rcptr<thread_pool>& pool = m_nodePools.get_const_ptr()[node];
+			if (!!pool)
+				return pool.dereference();
+		}
+		return m_fallbackPool.dereference();
+	}
+
+	/// @brief Gets the thread_pool of the NUMA node the calling thread is running on
+	rcref<thread_pool> get_current_node() const { return get_node(get_current_numa_node()); }
+
+	size_t get_thread_count() const
+	{
+		size_t result = 0;
+		for (size_t i = 0; i < m_nodePools.get_length(); i++)
+		{
+			if (!!m_nodePools[i])
+				result += m_nodePools[i]->get_thread_count();
+		}
+		return result;
+	}
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,174 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good
+
+#ifndef COGS_HEADER_SYNC_PROCESSOR_SET
+#define COGS_HEADER_SYNC_PROCESSOR_SET
+
+
+#include "cogs/env.hpp"
+#include "cogs/operators.hpp"
+
+
+#ifndef COGS_MAX_PROCESSORS
+
+/// @brief The maximum number of processors that can be represented in a processor_set
+#define COGS_MAX_PROCESSORS 1024
+#endif
+
+
+namespace cogs {
+
+
+/// @ingroup Synchronization
+/// @brief A set of processor indexes, used to describe NUMA nodes and thread affinity
+class processor_set
+{
+private:
+	static constexpr size_t bits_per_word = sizeof(uint64_t) * 8;
+	static constexpr size_t word_count = (COGS_MAX_PROCESSORS + bits_per_word - 1) / bits_per_word;
+
+	uint64_t m_words[word_count];
+
+public:
+	static constexpr size_t max_processors = word_count * bits_per_word;
+
+	processor_set() { clear(); }
+
+	void clear()
+	{
+		for (size_t i = 0; i < word_count; i++)
+			m_words[i] = 0;
+	}
+
+	void add(size_t i)
+	{
+		if (i < max_processors)
+			m_words[i / bits_per_word] |= (uint64_t)1 << (i % bits_per_word);
+	}
+
+	/// @brief Adds the range of processors [first, last]
+	void add_range(size_t first, size_t last)
+	{
+		for (size_t i = first; i <= last && i < max_processors; i++)
+			add(i);
+	}
+
+	void add(const processor_set& src)
+	{
+		for (size_t i = 0; i < word_count; i++)
+			m_words[i] |= src.m_words[i];
+	}
+
+	void remove(size_t i)
+	{
+		if (i < max_processors)
+			m_words[i / bits_per_word] &= ~((uint64_t)1 << (i % bits_per_word));
+	}
+
+	bool contains(size_t i) const
+	{
+		if (i >= max_processors)
+			return false;
+		return !!(m_words[i / bits_per_word] & ((uint64_t)1 << (i % bits_per_word)));
+	}
+
+	bool is_empty() const
+	{
+		for (size_t i = 0; i < word_count; i++)
+		{
+			if (!!m_words[i])
+				return false;
+		}
+		return true;
+	}
+
+	bool operator!() const { return is_empty(); }
+
+	size_t get_count() const
+	{
+		size_t result = 0;
+		for (size_t i = 0; i < word_count; i++)
+		{
+			if (!!m_words[i])
+				result += bit_count(m_words[i]);
+		}
+		return result;
+	}
+
+	/// @brief Gets the lowest processor index in the set that is equal to or greater than i
+	/// @return The processor index, or max_processors if there are none
+	size_t find_next(size_t i = 0) const
+	{
+		while (i < max_processors)
+		{
+			uint64_t w = m_words[i / bits_per_word] & (~(uint64_t)0 << (i % bits_per_word));
+			if (!!w)
+				return ((i / bits_per_word) * bits_per_word) + bit_scan_forward(w);
+			i = ((i / bits_per_word) + 1) * bits_per_word;
+		}
+		return max_processors;
+	}
+
+	/// @brief Gets the lowest 64 processors of the set, as a bit mask
+	uint64_t get_mask() const { return m_words[0]; }
+
+	/// @brief Parses a processor list, as used by Linux sysfs.  i.e. "0-3,8,10-11"
+	static processor_set parse_list(const char* s)
+	{
+		processor_set result;
+		size_t first = 0;
+		size_t n = 0;
+		bool inRange = false;
+		bool hasDigits = false;
+		for (;; s++)
+		{
+			char c = *s;
+			if (c >= '0' && c <= '9')
+			{
+				n = (n * 10) + (c - '0');
+				hasDigits = true;
+				continue;
+			}
+			if (c == '-' && hasDigits && !inRange)
+			{
+				first = n;
+				inRange = true;
+			}
+			else if (hasDigits)
+			{
+				if (inRange)
+					result.add_range(first, n);
+				else
+					result.add(n);
+				inRange = false;
+			}
+			n = 0;
+			hasDigits = false;
+			if (!c || c == '\n')
+				break;
+		}
+		return result;
+	}
+
+	bool operator==(const processor_set& cmp) const
+	{
+		for (size_t i = 0; i < word_count; i++)
+		{
+			if (m_words[i] != cmp.m_words[i])
+				return false;
+		}
+		return true;
+	}
+
+	bool operator!=(const processor_set& cmp) const { return !operator==(cmp); }
+};
+
+
+}
+
+
+#endif
@@ -0,0 +1,266 @@
+//
+//  Copyright (C) 2000-2022 - Colen M. Garoutte-Carson <colen at cogmine.com>, Cog Mine LLC
+//
+
+
+// Status: Good, NeedsTesting
+
+#ifndef COGS_HEADER_SYNC_READER_BIASED_RWLOCK
+#define COGS_HEADER_SYNC_READER_BIASED_RWLOCK
+
+
+#include <new>
+
+#include "cogs/env.hpp"
+#include "cogs/env/mem/memory_manager.hpp"
+#include "cogs/env/sync/thread.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
+#include "cogs/sync/rwlock.hpp"
+#include "cogs/sync/yield.hpp"
+
+
+#ifndef COGS_READER_BIASED_RWLOCK_SLOTS
+
+/// @brief The number of reader slots each thread has.  A thread can hold a read lock on up to this many
+/// reader_biased_rwlock's at once using the fast path, less any that hash to the same slot.
+#define COGS_READER_BIASED_RWLOCK_SLOTS 64
+#endif
+
+
+#ifndef COGS_READER_BIASED_RWLOCK_INHIBIT_FACTOR
+
+/// @brief After a writer revokes reader bias, the number of read acquisitions, per thread scanned, before reader
+/// bias is restored
+#define COGS_READER_BIASED_RWLOCK_INHIBIT_FACTOR 9
+#endif
+
+
+#ifndef COGS_RWLOCK_MAX_SPIN_COUNT
+
+/// @brief The maximum number of times a reader_biased_rwlock spins waiting for a writer, before blocking
+#define COGS_RWLOCK_MAX_SPIN_COUNT 1024
+#endif
+
+
+namespace cogs {
+
+
+/// @ingroup Synchronization
+/// @brief A read/write lock optimized for read-mostly use by many threads.
+///
+/// Based on BRAVO (Biased Locking for Reader-Writer Locks, Dice and Kogan).  While the lock is reader biased,
+/// a reader acquires it by storing the address of the lock in a slot owned by the calling thread, without
+/// writing to memory shared with other threads.  A writer revokes reader bias, then waits for readers holding
+/// slots to release them.  Reader bias is restored after a number of read acquisitions proportional to the
+/// cost of the revocation, so frequent writers fall back to the underlying rwlock.
+///
+/// Readers and writers that encounter an active writer spin before blocking.  The number of spins adapts
+/// to how long writers have recently held the lock.
+///
+/// A read lock must be released by the thread that acquired it.
+class reader_biased_rwlock
+{
+private:
+	class thread_record
+	{
+	public:
+		thread_record* m_nextRecord; // Records are not removed from the registry.  Records of exited threads are reused.
+		int m_inUse alignas(atomic::get_alignment_v<int>);
+		const volatile reader_biased_rwlock* m_slots[COGS_READER_BIASED_RWLOCK_SLOTS];
+
+		thread_record()
+			: m_nextRecord(nullptr),
+			m_inUse(1)
+		{
+			for (size_t i = 0; i < COGS_READER_BIASED_RWLOCK_SLOTS; i++)
+				m_slots[i] = nullptr;
+		}
+	};
+
+	class thread_record_holder
+	{
+	public:
+		thread_record* m_record;
+
+		thread_record_holder()
+			: m_record(nullptr)
+		{ }
+
+		~thread_record_holder()
+		{
+			if (!!m_record)
+				atomic::store(m_record->m_inUse, 0);
+		}
+	};
+
+	inline static thread_record* s_records alignas(atomic::get_alignment_v<thread_record*>) = nullptr;
+	inline static thread_local thread_record_holder s_threadRecord;
+
+	static constexpr size_t record_alignment = 64; // Avoid false sharing between threads' slots
+
+	rwlock m_lock;
+	int m_readBias alignas(atomic::get_alignment_v<int>);
+	int m_writerActive alignas(atomic::get_alignment_v<int>);
+	size_t m_inhibitCount alignas(atomic::get_alignment_v<size_t>);
+	unsigned int m_spinCount alignas(atomic::get_alignment_v<unsigned int>);
+
+	reader_biased_rwlock(const reader_biased_rwlock&) = delete;
+	reader_biased_rwlock& operator=(const reader_biased_rwlock&) = delete;
+
+	static thread_record& get_thread_record()
+	{
+		thread_record* r = s_threadRecord.m_record;
+		if (!!r)
+			return *r;
+
+		// Reuse a record released by an exited thread, if there is one.  Its slots are all empty.
+		for (r = atomic::load(s_records); !!r; r = r->m_nextRecord)
+		{
+			int oldInUse = 0;
+			if (atomic::load(r->m_inUse) == 0 && atomic::compare_exchange(r->m_inUse, 1, oldInUse))
+				break;
+		}
+		if (!r)
+		{
+			r = new (env::memory_manager::allocate(sizeof(thread_record), record_alignment)) thread_record;
+			thread_record* oldHead = atomic::load(s_records);
+			do {
+				r->m_nextRecord = oldHead;
+			} while (!atomic::compare_exchange(s_records, r, oldHead, oldHead));
+		}
+		s_threadRecord.m_record = r;
+		return *r;
+	}
+
+	size_t get_slot_index() const volatile
+	{
+		return ((size_t)this / sizeof(void*)) % COGS_READER_BIASED_RWLOCK_SLOTS;
+	}
+
+	volatile reader_biased_rwlock* get_this() const volatile { return const_cast<volatile reader_biased_rwlock*>(this); }
+
+	void spin_while_writer_active() volatile
+	{
+		if (env::get_processor_count() == 1)
+			return;
+		unsigned int spinCount = atomic::load(m_spinCount);
+		unsigned int i = 0;
+		while ((i < spinCount) && !!atomic::load(m_writerActive))
+		{
+			yield();
+			i++;
+		}
+		if (!i)
+			return;
+
+		// If the writer finished while spinning, spin longer next time.  Otherwise, block sooner.
+		unsigned int newSpinCount;
+		if (i < spinCount)
+			newSpinCount = (spinCount >= (COGS_RWLOCK_MAX_SPIN_COUNT / 2)) ? COGS_RWLOCK_MAX_SPIN_COUNT : (spinCount * 2);
+		else
+			newSpinCount = (spinCount > 1) ? (spinCount / 2) : 1;
+		if (newSpinCount != spinCount)
+			atomic::store(m_spinCount, newSpinCount);
+	}
+
+	void restore_read_bias() volatile
+	{
+		size_t inhibitCount = atomic::load(m_inhibitCount);
+		if (!inhibitCount)
+			atomic::store(m_readBias, 1);
+		else
+			atomic::compare_exchange(m_inhibitCount, inhibitCount - 1, inhibitCount);
+	}
+
+	void revoke_read_bias() volatile
+	{
+		atomic::store(m_readBias, 0);
+		size_t slotIndex = get_slot_index();
+		size_t threadCount = 0;
+		for (thread_record* r = atomic::load(s_records); !!r; r = r->m_nextRecord)
+		{
+			threadCount++;
+			while (atomic::load(r->m_slots[slotIndex]) == get_this())
+				yield();
+		}
+		atomic::store(m_inhibitCount, threadCount * COGS_READER_BIASED_RWLOCK_INHIBIT_FACTOR);
+	}
+
+public:
+	reader_biased_rwlock()
+		: m_readBias(1),
+		m_writerActive(0),
+		m_inhibitCount(0),
+		m_spinCount(COGS_RWLOCK_MAX_SPIN_COUNT / 8)
+	{ }
+
+	bool read_acquire(const timeout_t& timeout = timeout_t::infinite()) volatile
+	{
+		if (!!atomic::load(m_readBias))
+		{
+			thread_record& r = get_thread_record();
+			const volatile reader_biased_rwlock* volatile& slot = r.m_slots[get_slot_index()];
+			if (!atomic::load(slot))
+			{
+				// The slot must be visible before reader bias is checked again, so a revoking writer will wait for it
+				atomic::store(slot, this);
+				if (!!atomic::load(m_readBias))
+					return true;
+				atomic::store(slot, (const volatile reader_biased_rwlock*)nullptr);
+			}
+		}
+
+		spin_while_writer_active();
+		if (!m_lock.read_acquire(timeout))
+			return false;
+		if (!atomic::load(m_readBias))
+			restore_read_bias();
+		return true;
+	}
+
+	void read_release() volatile
+	{
+		thread_record* r = s_threadRecord.m_record;
+		if (!!r)
+		{
+			const volatile reader_biased_rwlock* volatile& slot = r->m_slots[get_slot_index()];
+			if (atomic::load(slot) == this)
+			{
+				atomic::store(slot, (const volatile reader_biased_rwlock*)nullptr);
+				return;
+			}
+		}
+		m_lock.read_release();
+	}
+
+	/// @brief Acquires the write lock.
+	///
+	/// If the lock is reader biased, the writer waits for all readers holding the lock using the fast path to
+	/// release it, regardless of the timeout.
+	bool write_acquire(bool writePriority = true, const timeout_t& timeout = timeout_t::infinite()) volatile
+	{
+		spin_while_writer_active();
+		if (!m_lock.write_acquire(writePriority, timeout))
+			return false;
+		atomic::store(m_writerActive, 1);
+		if (!!atomic::load(m_readBias))
+			revoke_read_bias();
+		return true;
+	}
+
+	void write_release(bool readPriority = false) volatile
+	{
+		atomic::store(m_writerActive, 0);
+		m_lock.write_release(readPriority);
+	}
+
+	bool is_read_biased() const volatile { return !!atomic::load(m_readBias); }
+};
+
+
+}
+
+
+#endif
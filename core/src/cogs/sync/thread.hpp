@@ -15,6 +15,7 @@
 #include "cogs/mem/placement.hpp"
 #include "cogs/mem/rcnew.hpp"
 #include "cogs/env/sync/thread.hpp"
+#include "cogs/sync/processor_set.hpp"
 #include "cogs/sync/single_fire_condition.hpp"
 #include "cogs/sync/yield.hpp"
 
@@ -101,6 +102,19 @@ public:
 
 inline unsigned int get_processor_count() { return env::get_processor_count(); }
 
+/// @brief Gets the number of NUMA nodes.  If NUMA topology is not available, all processors are considered part of node 0.
+inline unsigned int get_numa_node_count() { return env::get_numa_node_count(); }
+
+/// @brief Gets the set of processors in a NUMA node.  Empty if the node is offline or does not exist.
+inline processor_set get_numa_node_processors(unsigned int node) { return env::get_numa_node_processors(node); }
+
+/// @brief Gets the NUMA node of the processor the calling thread is currently running on
+inline unsigned int get_current_numa_node() { return env::get_current_numa_node(); }
+
+/// @brief Restricts the calling thread to run only on the specified processors
+/// @return False if not supported, or if the processor set is invalid
+inline bool set_current_thread_affinity(const processor_set& processors) { return env::set_current_thread_affinity(processors); }
+
 }
 
 
@@ -12,11 +12,31 @@
 #include "cogs/env.hpp"
 #include "cogs/collections/container_dlist.hpp"
 #include "cogs/collections/map.hpp"
+#include "cogs/collections/work_stealing_deque.hpp"
 #include "cogs/function.hpp"
 #include "cogs/math/const_max_int.hpp"
 #include "cogs/math/measure.hpp"
+#include "cogs/mem/default_memory_manager.hpp"
 #include "cogs/mem/rcnew.hpp"
+#include "cogs/sync/processor_set.hpp"
 #include "cogs/sync/quit_dispatcher.hpp"
+#include "cogs/sync/semaphore.hpp"
+
+
+#ifndef COGS_THREAD_POOL_WORK_STEALING
+
+/// @brief If non-zero, thread_pool's are constructed in work-stealing mode by default, including the default thread pool
+#define COGS_THREAD_POOL_WORK_STEALING 0
+#endif
+
+
+#ifndef COGS_THREAD_POOL_LOCAL_QUEUE_SIZE
+
+/// @brief The capacity of each thread's queue in a work-stealing thread_pool.  Must be a power of 2.
+///
+/// Tasks dispatched while a thread's queue is full are queued to the shared queue instead.
+#define COGS_THREAD_POOL_LOCAL_QUEUE_SIZE 1024
+#endif
 
 
 namespace cogs {
@@ -30,15 +50,19 @@ private:
 	class parallel_task
 	{
 	public:
-		function<void(size_t)> m_delegate;
+		function<void(size_t, size_t)> m_delegate;
 		function<void()> m_doneDelegate;
 		size_t m_parallelCount;
+		size_t m_grainSize; // 0 = guided
+		size_t m_threadCount;
 		volatile size_type m_progress;
 
-		parallel_task(size_t n, const function<void(size_t)>& d, const function<void()>& doneDelegate)
+		parallel_task(size_t n, const function<void(size_t, size_t)>& d, const function<void()>& doneDelegate, size_t grainSize, size_t threadCount)
 			: m_delegate(d),
 			m_doneDelegate(doneDelegate),
 			m_parallelCount(n),
+			m_grainSize(grainSize),
+			m_threadCount(threadCount),
 			m_progress(0)
 		{ }
 
@@ -46,6 +70,22 @@ private:
 		{
 			m_doneDelegate();
 		}
+
+		// Gets the number of iterations to claim at once, given the number already claimed
+		size_t get_chunk_size(size_t progress) const
+		{
+			size_t remaining = m_parallelCount - progress;
+			size_t n = m_grainSize;
+			if (!n)
+			{
+				// Guided: Claim a share of the remaining iterations, so chunks shrink as the end nears,
+				// balancing load across threads without claiming one iteration at a time.
+				n = remaining / (m_threadCount * 2);
+				if (!n)
+					n = 1;
+			}
+			return (n > remaining) ? remaining : n;
+		}
 	};
 
 	typedef container_dlist<rcref<parallel_task> > parallel_task_list_t;
@@ -67,38 +107,194 @@ private:
 
 	typedef map<int, rcref<parallel_task_level> > parallel_task_level_map_t;
 
-	class main_loop : public object
+	// In work-stealing mode, a task dispatched at the default priority from a worker thread of the same pool
+	// is queued in that worker's local deque, rather than in m_tasks.
+	class local_dispatched : public dispatched
+	{
+	public:
+		rcptr<local_dispatched> m_self; // Keeps this alive while queued.  Cleared by the thread that dequeues it.
+		volatile boolean m_moved; // Set if moved to m_tasks due to a priority change
+
+		local_dispatched(const rcref<volatile dispatcher>& parentDispatcher, const rcref<task_base>& t)
+			: dispatched(parentDispatcher, t)
+		{ }
+	};
+
+	typedef work_stealing_deque<local_dispatched*, COGS_THREAD_POOL_LOCAL_QUEUE_SIZE> local_queue_t;
+
+	class main_loop : public dispatcher, public object
 	{
 	public:
+		class worker
+		{
+		public:
+			local_queue_t m_localTasks;
+			main_loop* m_mainLoop;
+			size_t m_index;
+		};
+
+		inline static thread_local worker* s_currentWorker = nullptr;
+
 		priority_dispatcher m_tasks;
 
+#ifdef COGS_OS_FUTEX_SEMAPHORE
+		volatile os::futex_semaphore m_semaphore; // Released on every dispatch.  Avoids a system call if no threads are blocked.
+#else
 		volatile semaphore m_semaphore;
+#endif
 		volatile parallel_task_level_map_t m_parallelTaskLevelMap;
 		volatile boolean m_exiting;
 
-		explicit main_loop(size_t threadCount)
-			: m_semaphore(0, threadCount)
-		{ }
+		// Only used in work-stealing mode
+		worker* m_workers;
+		size_t m_workerCount;
+		volatile size_type m_sleepingCount;
 
-		void run()
+		main_loop(size_t threadCount, bool workStealing)
+			: m_semaphore(0, threadCount),
+			m_workers(nullptr),
+			m_workerCount(0),
+			m_sleepingCount(0)
 		{
-			parallel_task_level_map_t::volatile_iterator currentPriorityLevelItor;
+			if (workStealing)
+			{
+				m_workerCount = threadCount;
+				m_workers = default_memory_manager::allocate_type<worker>(threadCount);
+				for (size_t i = 0; i < threadCount; i++)
+				{
+					new (&m_workers[i]) worker();
+					m_workers[i].m_mainLoop = this;
+					m_workers[i].m_index = i;
+				}
+			}
+		}
+
+		~main_loop()
+		{
+			if (!!m_workers)
+			{
+				for (size_t i = 0; i < m_workerCount; i++)
+				{
+					local_dispatched* d;
+					while (m_workers[i].m_localTasks.pop(d))
+						d->m_self.release();
+				}
+				default_memory_manager::destruct_deallocate_type(m_workers, m_workerCount);
+			}
+		}
+
+		virtual void dispatch_inner(const rcref<task_base>& t, int priority) volatile
+		{
+			main_loop* ml = const_cast<main_loop*>(this);
+			if (!priority)
+			{
+				worker* w = s_currentWorker;
+				if (!!w && (w->m_mainLoop == ml) && ml->dispatch_local(*w, t))
+					return;
+			}
+			dispatcher::dispatch_inner(m_tasks, t, priority);
+			m_semaphore.release();
+		}
+
+		// Only called for local_dispatched.  Tasks in m_tasks are dispatched by m_tasks.
+		virtual void change_priority_inner(volatile dispatched& d, int newPriority) volatile
+		{
+			local_dispatched& ld = *(local_dispatched*)&d;
 			for (;;)
 			{
-				currentPriorityLevelItor = m_parallelTaskLevelMap.get_first();
-				if (!currentPriorityLevelItor)
+				if (ld.m_moved)
 				{
-					if (m_tasks.invoke())
-						continue;
+					// Already moved to m_tasks.  Pass the change on to it.
+					rcptr<volatile dispatched> d2 = ld.get_task_base()->get_dispatched();
+					if (!!d2 && (d2.get_ptr() != &d))
+						dispatcher::change_priority_inner(m_tasks, *d2, newPriority);
+					break;
+				}
 
-					// Only check of exiting if out of tasks, immediately before acquiring the semaphore.
-					// Ensures all tasts have been processed, and we don't consume the semaphore preventing
-					// other threads from waking in order to exit.
-					if (m_exiting)
-						break;
-					m_semaphore.acquire();
-					continue;
+				// Only default priority tasks are queued locally.  Move it to m_tasks, to preserve cross-priority ordering.
+				// The entry left in the local deque is skipped when dequeued.
+				if (!newPriority)
+					break;
+				if (ld.m_moved.compare_exchange(true, false))
+				{
+					dispatcher::dispatch_inner(m_tasks, ld.get_task_base(), newPriority);
+					m_semaphore.release();
+					break;
 				}
+			}
+		}
+
+		bool dispatch_local(worker& w, const rcref<task_base>& t)
+		{
+			rcref<local_dispatched> d = rcnew(local_dispatched)(this_rcref, t);
+			t->set_dispatched(d.template static_cast_to<dispatched>());
+			d->m_self = d;
+			if (!w.m_localTasks.push(d.get_ptr()))
+			{
+				d->m_self.release();
+				return false; // Full.  Caller will fall back to m_tasks.
+			}
+
+			// Wake an idle worker to steal it.  A worker increments m_sleepingCount before its final check for work.
+			if (!!m_sleepingCount)
+				m_semaphore.release();
+			return true;
+		}
+
+		// Invokes a task from the current worker's deque, or one stolen from another worker's deque
+		bool invoke_local(worker& w)
+		{
+			local_dispatched* d;
+			for (;;)
+			{
+				if (!w.m_localTasks.pop(d) && !steal(w, d))
+					return false;
+				rcptr<local_dispatched> r = std::move(d->m_self);
+				if (!r->m_moved && r->get_task_base()->signal())
+					return true;
+				//continue; // Cancelled or moved
+			}
+		}
+
+		bool steal(worker& w, local_dispatched*& d)
+		{
+			for (size_t i = 1; i < m_workerCount; i++)
+			{
+				worker& victim = m_workers[(w.m_index + i) % m_workerCount];
+				if (victim.m_localTasks.steal(d))
+					return true;
+			}
+			return false;
+		}
+
+		bool has_local_work() const
+		{
+			for (size_t i = 0; i < m_workerCount; i++)
+			{
+				if (!m_workers[i].m_localTasks.is_empty())
+					return true;
+			}
+			return false;
+		}
+
+		int get_next_shared_priority()
+		{
+			int result = m_tasks.get_next_priority();
+			parallel_task_level_map_t::volatile_iterator currentPriorityLevelItor = m_parallelTaskLevelMap.get_first();
+			if (!!currentPriorityLevelItor && (currentPriorityLevelItor->key < result))
+				result = currentPriorityLevelItor->key;
+			return result;
+		}
+
+		// Invokes a task from m_tasks, or an iteration of a parallel task.  Returns false if there were none.
+		bool invoke_shared()
+		{
+			parallel_task_level_map_t::volatile_iterator currentPriorityLevelItor;
+			for (;;)
+			{
+				currentPriorityLevelItor = m_parallelTaskLevelMap.get_first();
+				if (!currentPriorityLevelItor)
+					return m_tasks.invoke();
 
 				if (currentPriorityLevelItor->value->m_parallelTasks.is_empty())
 				{
@@ -122,28 +318,30 @@ private:
 
 							// Ran higher priority event, recheck priorities
 							if (p < currentPriority)
-								continue;
+								return true;
 							currentPriorityLevelItor->value->m_alternateFlag = true;
 						}
 					}
 				}
 
 				// Run next parallel task
+				bool ranParallelTask = false;
 				parallel_task_list_t::volatile_iterator parallelTaskItor = currentPriorityLevelItor->value->m_parallelTaskItor++;
 				for (;;)
 				{
 					if (!!parallelTaskItor)
 					{
 						size_type progress = (*parallelTaskItor)->m_progress;
+						size_t chunkSize;
 						bool done;
 						for (;;)
 						{
 							done = progress == (*parallelTaskItor)->m_parallelCount;
 							if (done)
 								break;
-							size_type progressPlusOne = progress;
-							++progressPlusOne;
-							if ((*parallelTaskItor)->m_progress.compare_exchange(progressPlusOne, progress, progress))
+							chunkSize = (*parallelTaskItor)->get_chunk_size(progress.get_int());
+							size_type newProgress = progress.get_int() + chunkSize;
+							if ((*parallelTaskItor)->m_progress.compare_exchange(newProgress, progress, progress))
 								break;
 						}
 
@@ -154,8 +352,9 @@ private:
 							continue;
 						}
 
-						(*parallelTaskItor)->m_delegate(progress.get_int());
+						(*parallelTaskItor)->m_delegate(progress.get_int(), progress.get_int() + chunkSize);
 						currentPriorityLevelItor->value->m_alternateFlag = false;
+						ranParallelTask = true;
 						break;
 					}
 					parallel_task_list_t::volatile_iterator firstItor = currentPriorityLevelItor->value->m_parallelTasks.get_first();
@@ -167,13 +366,94 @@ private:
 
 					currentPriorityLevelItor->value->m_parallelTaskItor.compare_exchange(firstItor, parallelTaskItor, parallelTaskItor);
 				}
+				if (ranParallelTask)
+					return true;
 				//continue;
 			}
+		}
+
+		// Destructs a batch of objects released by tasks run by the current thread.  Returns false if there were none.
+		static bool process_deferred_releases()
+		{
+#if COGS_DEFERRED_RC_RELEASE
+			if (!!rc_obj_base::get_deferred_release_count())
+			{
+				rc_obj_base::process_deferred_releases(COGS_DEFERRED_RC_RELEASE_BATCH_SIZE);
+				return true;
+			}
+#endif
+			return false;
+		}
+
+		void run()
+		{
+			for (;;)
+			{
+				if (invoke_shared())
+				{
+					process_deferred_releases();
+					continue;
+				}
+				if (process_deferred_releases())
+					continue;
+
+				// Only check of exiting if out of tasks, immediately before acquiring the semaphore.
+				// Ensures all tasts have been processed, and we don't consume the semaphore preventing
+				// other threads from waking in order to exit.
+				if (m_exiting)
+					break;
+				m_semaphore.acquire();
+			}
+		}
+
+		void run(worker& w)
+		{
+			s_currentWorker = &w;
+			for (;;)
+			{
+				// Shared tasks of better than default priority run before any local tasks.
+				if (((get_next_shared_priority() < 0) && invoke_shared()) || invoke_local(w) || invoke_shared())
+				{
+					process_deferred_releases();
+					continue;
+				}
+				if (process_deferred_releases())
+					continue;
+
+				++m_sleepingCount;
+				if (has_local_work() || !m_tasks.is_empty() || !!m_parallelTaskLevelMap.get_first())
+				{
+					--m_sleepingCount;
+					continue;
+				}
+				if (m_exiting)
+				{
+					--m_sleepingCount;
+					break;
+				}
+				m_semaphore.acquire();
+				--m_sleepingCount;
+			}
+			s_currentWorker = nullptr;
+		}
 
+		void run(size_t index)
+		{
+#if COGS_DEFERRED_RC_RELEASE
+			rc_obj_base::set_deferred_release(true);
+#endif
+			if (!m_workers)
+				run();
+			else
+				run(m_workers[index]);
+#if COGS_DEFERRED_RC_RELEASE
+			rc_obj_base::set_deferred_release(false);
+#endif
 		}
 	};
 
 	const size_t m_threadCount;
+	const processor_set m_affinity;
 	rcref<main_loop> m_mainLoop;
 
 	volatile container_dlist<rcref<thread> > m_threads;
@@ -182,8 +462,7 @@ private:
 	virtual void dispatch_inner(const rcref<task_base>& t, int priority) volatile
 	{
 		COGS_ASSERT(m_state == 1);
-		dispatcher::dispatch_inner(m_mainLoop->m_tasks, t, priority);
-		m_mainLoop->m_semaphore.release();
+		dispatcher::dispatch_inner(*m_mainLoop, t, priority);
 	}
 
 	typedef singleton<thread_pool, singleton_posthumous_behavior::return_null, singleton_cleanup_behavior::must_call_shutdown>
@@ -257,9 +536,20 @@ public:
 		return n;
 	}
 
-	explicit thread_pool(bool startNow = false, size_t threadCount = get_default_size())
+	/// @brief Constructor
+	/// @param startNow If true, start() is called.  Default: false
+	/// @param threadCount Number of threads.  Default: get_default_size()
+	/// @param workStealing If true, each thread has its own queue.  Tasks dispatched at the default priority (0)
+	/// from a thread of the pool are queued to that thread's queue, and idle threads steal from other threads' queues.
+	/// Tasks dispatched with other priorities, from other threads, or using dispatch_parallel(), are queued to a
+	/// shared priority queue.  Any queued task with a better (lower) priority than the default is run before local
+	/// tasks, and tasks with worse priority run only once no local tasks remain.  Order among tasks of the default
+	/// priority is not preserved.  Default: COGS_THREAD_POOL_WORK_STEALING
+	/// @param affinity If not empty, each thread of the pool is restricted to run on the specified processors.  Default: empty
+	explicit thread_pool(bool startNow = false, size_t threadCount = get_default_size(), bool workStealing = (COGS_THREAD_POOL_WORK_STEALING != 0), const processor_set& affinity = processor_set())
 		: m_threadCount(threadCount),
-		m_mainLoop(rcnew(main_loop)(threadCount)),
+		m_affinity(affinity),
+		m_mainLoop(rcnew(main_loop)(threadCount, workStealing)),
 		m_state(0)
 	{
 		if (startNow)
@@ -279,9 +569,11 @@ public:
 		{
 			for (size_t i = 0; i < m_threadCount; i++)
 			{
-				m_threads.append(thread::spawn([r{ m_mainLoop }]()
+				m_threads.append(thread::spawn([r{ m_mainLoop }, i, affinity{ m_affinity }]()
 				{
-					r->run();
+					if (!!affinity)
+						set_current_thread_affinity(affinity);
+					r->run(i);
 				}));
 			}
 		}
@@ -290,6 +582,19 @@ public:
 
 	size_t get_thread_count() const { return m_threadCount; }
 
+	bool is_work_stealing() const { return !!m_mainLoop->m_workers; }
+
+	/// @brief Gets the set of processors threads of the pool are restricted to.  Empty if not restricted.
+	const processor_set& get_affinity() const { return m_affinity; }
+
+	/// @brief Invokes a delegate n times, in parallel.  Each invocation is passed an index in the range [0, n).
+	///
+	/// Each index is claimed by a thread individually, so an invocation may block without preventing other
+	/// threads from processing other indexes.  To process a large number of short iterations, use dispatch_parallel_range().
+	/// @param n Number of invocations
+	/// @param f Delegate to invoke.  May accept a size_t index, or no arguments.
+	/// @param doneFunc Delegate to invoke once all invocations have completed
+	/// @param priority Priority.  Default: 0
 	template <typename F>
 	std::enable_if_t<
 		std::is_invocable_v<F, size_t>
@@ -306,37 +611,88 @@ public:
 		&& std::is_invocable_v<D>,
 		void>
 	dispatch_parallel(size_t n, F&& f, D&& doneFunc, int priority = 0) volatile
+	{
+		dispatch_parallel_range(n, [f{ std::forward<F>(f) }](size_t i, size_t end)
+		{
+			for (; i != end; i++)
+			{
+				if constexpr (std::is_invocable_v<F, size_t>)
+					f(i);
+				else
+					f();
+			}
+		}, std::forward<D>(doneFunc), 1, priority);
+	}
+
+	/// @brief Invokes a delegate over sub-ranges of [0, n), in parallel.
+	///
+	/// Threads claim chunks of iterations, and the delegate is passed the range [begin, end) of each chunk.
+	/// @param n Number of iterations
+	/// @param f Delegate to invoke, accepting 2 size_t arguments, the beginning and end of a range of iterations
+	/// @param doneFunc Delegate to invoke once all iterations have completed
+	/// @param grainSize The number of iterations to claim at once.  If 0, chunks are guided; each is a share of
+	/// the remaining iterations, decreasing in size as the end approaches.  Default: 0
+	/// @param priority Priority.  Default: 0
+	template <typename F>
+	std::enable_if_t<
+		std::is_invocable_v<F, size_t, size_t>,
+		void>
+	dispatch_parallel_range(size_t n, F&& f, size_t grainSize = 0, int priority = 0) volatile
+	{
+		dispatch_parallel_range(n, std::forward<F>(f), []() {}, grainSize, priority);
+	}
+
+	template <typename F, typename D>
+	std::enable_if_t<
+		std::is_invocable_v<F, size_t, size_t>
+		&& std::is_invocable_v<D>,
+		void>
+	dispatch_parallel_range(size_t n, F&& f, D&& doneFunc, size_t grainSize = 0, int priority = 0) volatile
 	{
 		COGS_ASSERT(m_state == 1);
-		if (!!n)
+		if (!n)
 		{
-			rcref<parallel_task> t = rcnew(parallel_task)(n, std::move(f), std::move(doneFunc));
-			rcptr<parallel_task_level> level;
+			doneFunc();
+			return;
+		}
 
-			parallel_task_level_map_t::volatile_iterator i;
-			for (;;)
+		// Wake no more threads than there are chunks
+		size_t wakeCount = m_threadCount;
+		if (!!grainSize)
+		{
+			size_t chunkCount = (n / grainSize) + ((n % grainSize) ? 1 : 0);
+			if (wakeCount > chunkCount)
+				wakeCount = chunkCount;
+		}
+		else if (wakeCount > n)
+			wakeCount = n;
+
+		rcref<parallel_task> t = rcnew(parallel_task)(n, std::forward<F>(f), std::forward<D>(doneFunc), grainSize, m_threadCount);
+		rcptr<parallel_task_level> level;
+
+		parallel_task_level_map_t::volatile_iterator i;
+		for (;;)
+		{
+			if (!i)
+				i = m_mainLoop->m_parallelTaskLevelMap.find(priority);
+			if (!!i)
 			{
-				if (!i)
-					i = m_mainLoop->m_parallelTaskLevelMap.find(priority);
-				if (!!i)
+				if (!i->value->m_parallelTasks.prepend_emplace_if_not_empty(t).inserted)
 				{
-					if (!i->value->m_parallelTasks.prepend_emplace_if_not_empty(t).inserted)
-					{
-						COGS_ASSERT(i->value->m_parallelTasks.is_empty());
-						m_mainLoop->m_parallelTaskLevelMap.remove(i);
-						i.release();
-						continue;
-					}
-					m_mainLoop->m_semaphore.release(n);
-					break;
-				}
-				if (!level)
-					level = rcnew(parallel_task_level)(t);
-				if (!m_mainLoop->m_parallelTaskLevelMap.insert_unique_emplace(priority, level.dereference()).inserted)
+					COGS_ASSERT(i->value->m_parallelTasks.is_empty());
+					m_mainLoop->m_parallelTaskLevelMap.remove(i);
+					i.release();
 					continue;
-				m_mainLoop->m_semaphore.release(n);
+				}
+				m_mainLoop->m_semaphore.release(wakeCount);
 				break;
 			}
+			if (!level)
+				level = rcnew(parallel_task_level)(t);
+			if (!m_mainLoop->m_parallelTaskLevelMap.insert_unique_emplace(priority, level.dereference()).inserted)
+				continue;
+			m_mainLoop->m_semaphore.release(wakeCount);
+			break;
 		}
 	}
 
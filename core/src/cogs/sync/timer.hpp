@@ -9,21 +9,47 @@
 #define COGS_HEADER_SYNC_TIMER
 
 
-#include "cogs/collections/multimap.hpp"
+#include "cogs/collections/vector.hpp"
 #include "cogs/env.hpp"
 #include "cogs/function.hpp"
+#include "cogs/math/const_max_int.hpp"
+#include "cogs/math/fixed_integer.hpp"
+#include "cogs/math/measure.hpp"
+#include "cogs/math/time.hpp"
 #include "cogs/mem/object.hpp"
 #include "cogs/mem/placement.hpp"
 #include "cogs/mem/rcnew.hpp"
+#include "cogs/operators.hpp"
 #include "cogs/sync/cleanup_queue.hpp"
+#include "cogs/sync/atomic_compare_exchange.hpp"
+#include "cogs/sync/atomic_exchange.hpp"
+#include "cogs/sync/atomic_load.hpp"
+#include "cogs/sync/atomic_store.hpp"
 #include "cogs/sync/dispatcher.hpp"
 #include "cogs/sync/resettable_condition.hpp"
 #include "cogs/sync/semaphore.hpp"
 #include "cogs/sync/singleton.hpp"
 #include "cogs/sync/thread.hpp"
+#include "cogs/sync/thread_pool.hpp"
 #include "cogs/sync/transactable.hpp"
 
 
+#ifndef COGS_TIMER_WHEEL_RESOLUTION_US
+
+/// @brief The resolution of the timer wheel, in microseconds.
+///
+/// Timers fire at the first tick at or after their expiration.  Timers expiring within the same tick are fired together.
+#define COGS_TIMER_WHEEL_RESOLUTION_US 1000
+#endif
+
+
+#ifndef COGS_TIMER_DISPATCH_GRAIN
+
+/// @brief The maximum number of expired timers fired by each task dispatched to the thread pool
+#define COGS_TIMER_DISPATCH_GRAIN 64
+#endif
+
+
 namespace cogs {
 
 
@@ -53,10 +79,150 @@ private:
 		inner_timer(const inner_timer&) = delete;
 		inner_timer& operator=(const inner_timer&) = delete;
 
+		// Timers are kept in a hashed hierarchical timing wheel, serviced by a single timer thread.
+		// Time is divided into ticks of COGS_TIMER_WHEEL_RESOLUTION_US.  A tick count is treated as 11 digits of 6 bits,
+		// and each digit has a level of 64 slots.  A timer is placed at the level of the highest digit in which its
+		// expiration tick differs from the current tick, in the slot for that digit of its expiration tick.  When the
+		// current tick reaches the start of a slot in a higher level, its timers are cascaded to lower levels.
+		// Inserting a timer is O(1).  Timers expiring in the same tick are coalesced into one wake-up.
+		// Only the timer thread accesses the wheel.
+		class wheel
+		{
+		private:
+			static constexpr size_t bits_per_level = 6;
+			static constexpr size_t slot_count = (size_t)1 << bits_per_level;
+			static constexpr size_t level_count = ((sizeof(uint64_t) * 8) + bits_per_level - 1) / bits_per_level;
+
+			inner_timer* m_slots[level_count][slot_count];
+			uint64_t m_occupied[level_count];
+			uint64_t m_currentTick;
+
+			static size_t get_digit(uint64_t tick, size_t level) { return (size_t)(tick >> (level * bits_per_level)) & (slot_count - 1); }
+
+			inner_timer* take_slot(size_t level, size_t slot)
+			{
+				inner_timer* result = m_slots[level][slot];
+				m_slots[level][slot] = nullptr;
+				m_occupied[level] &= ~((uint64_t)1 << slot);
+				return result;
+			}
+
+		public:
+			wheel()
+				: m_currentTick(0)
+			{
+				for (size_t level = 0; level < level_count; level++)
+				{
+					m_occupied[level] = 0;
+					for (size_t slot = 0; slot < slot_count; slot++)
+						m_slots[level][slot] = nullptr;
+				}
+			}
+
+			uint64_t get_current_tick() const { return m_currentTick; }
+
+			// t->m_tick must be later than the current tick
+			void insert(inner_timer* t)
+			{
+				COGS_ASSERT(t->m_tick > m_currentTick);
+				size_t level = bit_scan_reverse(t->m_tick ^ m_currentTick) / bits_per_level;
+				size_t slot = get_digit(t->m_tick, level);
+				t->m_next = m_slots[level][slot];
+				m_slots[level][slot] = t;
+				m_occupied[level] |= (uint64_t)1 << slot;
+			}
+
+			// Gets the next tick at which timers expire, or need to be cascaded to a lower level.
+			uint64_t get_next_event_tick() const
+			{
+				uint64_t result = const_max_int_v<uint64_t>;
+				for (size_t level = 0; level < level_count; level++)
+				{
+					size_t digit = get_digit(m_currentTick, level);
+					if (digit == slot_count - 1)
+						continue;
+					uint64_t occupied = m_occupied[level] & (const_max_int_v<uint64_t> << (digit + 1));
+					if (!occupied)
+						continue;
+					size_t shift = level * bits_per_level;
+					size_t upperShift = shift + bits_per_level;
+					uint64_t tick = (upperShift >= (sizeof(uint64_t) * 8)) ? 0 : ((m_currentTick >> upperShift) << upperShift);
+					tick |= (uint64_t)bit_scan_forward(occupied) << shift;
+					if (tick < result)
+						result = tick;
+				}
+				return result;
+			}
+
+			// Advances the current tick to n.  Expired timers are passed to f.
+			template <typename F>
+			void advance(uint64_t n, F&& f)
+			{
+				while (m_currentTick < n)
+				{
+					uint64_t nextTick = get_next_event_tick();
+					if (nextTick > n)
+					{
+						m_currentTick = n;
+						break;
+					}
+					m_currentTick = nextTick;
+					for (size_t level = level_count - 1; level > 0; level--)
+					{
+						if (!!(m_currentTick & (((uint64_t)1 << (level * bits_per_level)) - 1)))
+							continue;
+						inner_timer* t = take_slot(level, get_digit(m_currentTick, level));
+						while (!!t)
+						{
+							inner_timer* next = t->m_next;
+							if (t->m_tick == m_currentTick)
+								f(t);
+							else
+								insert(t);
+							t = next;
+						}
+					}
+					inner_timer* t = take_slot(0, get_digit(m_currentTick, 0));
+					while (!!t)
+					{
+						inner_timer* next = t->m_next;
+						f(t);
+						t = next;
+					}
+				}
+			}
+
+			// Removes all timers, passing them to f.
+			template <typename F>
+			void clear(F&& f)
+			{
+				for (size_t level = 0; level < level_count; level++)
+				{
+					for (size_t slot = 0; slot < slot_count; slot++)
+					{
+						inner_timer* t = take_slot(level, slot);
+						while (!!t)
+						{
+							inner_timer* next = t->m_next;
+							f(t);
+							t = next;
+						}
+					}
+				}
+			}
+		};
+
 		class globals
 		{
 		public:
-			volatile multimap<timeout_t, rcref<inner_timer> > m_timers;
+			// Timers are added to m_incoming by any thread, and moved into the wheel by the timer thread.
+			inner_timer* m_incoming alignas(atomic::get_alignment_v<inner_timer*>) = nullptr;
+
+			// The tick at which the timer thread will next wake.  Used to avoid waking it for timers that expire later.
+			uint64_t m_nextWakeTick alignas(atomic::get_alignment_v<uint64_t>) = const_max_int_v<uint64_t>;
+
+			const timeout_t::period_t m_epoch = timeout_t::now();
+			wheel m_wheel;
 
 			volatile rcptr<thread> m_timerThread;
 			semaphore m_timerThreadSemaphore{ 0, 1 };
@@ -71,6 +237,49 @@ private:
 					m_timerThreadSemaphore.release();
 					timerThread->join();
 				}
+				m_wheel.clear([](inner_timer* t) { t->m_self.release(); });
+				inner_timer* t = m_incoming;
+				while (!!t)
+				{
+					inner_timer* next = t->m_next;
+					t->m_self.release();
+					t = next;
+				}
+			}
+
+			static uint64_t get_microseconds(const timeout_t::period_t& p)
+			{
+				measure<fixed_integer<false, 64>, microseconds> us(p);
+				return us.get().get_int();
+			}
+
+			uint64_t get_elapsed_microseconds() const
+			{
+				timeout_t::period_t n = timeout_t::now();
+				n -= m_epoch;
+				return get_microseconds(n);
+			}
+
+			uint64_t get_tick_now() const { return get_elapsed_microseconds() / COGS_TIMER_WHEEL_RESOLUTION_US; }
+
+			// Gets the tick of the first tick boundary at or after the expiration of t
+			uint64_t get_expiration_tick(const timeout_t& t, uint64_t elapsedMicroseconds) const
+			{
+				uint64_t us = elapsedMicroseconds + get_microseconds(t.get_pending());
+				return (us + COGS_TIMER_WHEEL_RESOLUTION_US - 1) / COGS_TIMER_WHEEL_RESOLUTION_US;
+			}
+
+			void add(const rcref<inner_timer>& t, const timeout_t& timeout)
+			{
+				uint64_t tick = get_expiration_tick(timeout, get_elapsed_microseconds());
+				t->m_tick = tick;
+				t->m_self = t;
+				inner_timer* oldHead = atomic::load(m_incoming);
+				do {
+					t->m_next = oldHead;
+				} while (!atomic::compare_exchange(m_incoming, t.get_ptr(), oldHead, oldHead));
+				if (tick < atomic::load(m_nextWakeTick))
+					m_timerThreadSemaphore.release();
 			}
 		};
 
@@ -83,6 +292,36 @@ private:
 			return g;
 		}
 
+		// Fires expired timers.  If a thread pool is available, they are fired in batches in the thread pool,
+		// so the timer thread is not delayed by work done in response to timers.
+		static void fire(vector<rcref<timer> >& expiredTimers)
+		{
+			size_t n = expiredTimers.get_length();
+			if (!n)
+				return;
+			rcptr<thread_pool> pool = thread_pool::get_default();
+			if (!pool)
+			{
+				for (size_t i = 0; i < n; i++)
+					expiredTimers[i]->triggered();
+			}
+			else
+			{
+				// Each batch shares the storage of expiredTimers, which is released from it below.
+				for (size_t i = 0; i < n; i += COGS_TIMER_DISPATCH_GRAIN)
+				{
+					vector<rcref<timer> > batch(expiredTimers, i, COGS_TIMER_DISPATCH_GRAIN);
+					pool->dispatch([batch]()
+					{
+						size_t batchLength = batch.get_length();
+						for (size_t j = 0; j < batchLength; j++)
+							batch.get_const_ptr()[j]->triggered();
+					});
+				}
+			}
+			expiredTimers.clear();
+		}
+
 		static void thread_main()
 		{
 			rcptr<globals> acquiredTimerGlobals = init();
@@ -90,42 +329,76 @@ private:
 			{
 				globals* myTimerGlobals = acquiredTimerGlobals.get_ptr(); // We know it's not going anywhere until this thread is joined, so don't reference it.
 				acquiredTimerGlobals = 0;
+				wheel& w = myTimerGlobals->m_wheel;
+				vector<rcref<timer> > expiredTimers;
 				timeout_t timeout = timeout_t::infinite();
 				do {
 					myTimerGlobals->m_timerThreadSemaphore.acquire_any(timeout); // timeout of next timer
-					multimap<timeout_t, rcref<inner_timer> >::volatile_iterator itor;
-					for (;;)
+					uint64_t elapsedMicroseconds = myTimerGlobals->get_elapsed_microseconds();
+					uint64_t nowTick = elapsedMicroseconds / COGS_TIMER_WHEEL_RESOLUTION_US;
+
+					auto expired = [&](inner_timer* tPtr)
 					{
-						itor = myTimerGlobals->m_timers.get_first();
-						if (!itor || !!(itor->key.get_pending())) // Only bother with stuff that expired.
-							break;
-						rcref<inner_timer> t = itor->value;
-						myTimerGlobals->m_timers.remove(itor);
+						rcref<inner_timer> t = std::move(tPtr->m_self).dereference();
 						read_token rt;
 						for (;;) // Loop until transactable write succeeds
 						{
 							t->m_timeoutInfo.begin_read(rt);
 							if (rt->m_aborted)
 								break;
-							if (!!rt->m_timeout.get_pending()) // Got extended.  Put it back in the list.
-								myTimerGlobals->m_timers.insert(rt->m_timeout, t);
-							else // expired
+							if (!!rt->m_timeout.get_pending()) // Got extended.  Put it back in the wheel.
 							{
-								rcptr<timer> outerTimer = t->m_outerTimer;
-								if (!outerTimer)
+								uint64_t tick = myTimerGlobals->get_expiration_tick(rt->m_timeout, elapsedMicroseconds);
+								if (tick > w.get_current_tick())
+								{
+									t->m_tick = tick;
+									t->m_self = t;
+									w.insert(t.get_ptr());
 									break;
-								if (!t->m_timeoutInfo.end_write(rt, timeout_info_t(rt->m_timeout, true, false)))
-									continue;
-								outerTimer->triggered();
+								}
+								// Expires in the current tick.  Fire it.
 							}
+							rcptr<timer> outerTimer = t->m_outerTimer;
+							if (!outerTimer)
+								break;
+							if (!t->m_timeoutInfo.end_write(rt, timeout_info_t(rt->m_timeout, true, false)))
+								continue;
+							expiredTimers.append(1, outerTimer.dereference());
 							break;
 						}
-						//continue;
+					};
+
+					// Move newly added timers into the wheel
+					inner_timer* t = atomic::exchange(myTimerGlobals->m_incoming, (inner_timer*)nullptr);
+					while (!!t)
+					{
+						inner_timer* next = t->m_next;
+						if (t->m_tick > w.get_current_tick())
+							w.insert(t);
+						else
+							expired(t);
+						t = next;
 					}
-					if (!itor)
+
+					if (nowTick > w.get_current_tick())
+						w.advance(nowTick, expired);
+					fire(expiredTimers);
+
+					uint64_t nextTick = w.get_next_event_tick();
+					atomic::store(myTimerGlobals->m_nextWakeTick, nextTick);
+					if (!!atomic::load(myTimerGlobals->m_incoming))
+						timeout = timeout_t::none();
+					else if (nextTick == const_max_int_v<uint64_t>)
 						timeout = timeout_t::infinite();
 					else
-						timeout = itor->key;
+					{
+						uint64_t wakeMicroseconds = nextTick * COGS_TIMER_WHEEL_RESOLUTION_US;
+						elapsedMicroseconds = myTimerGlobals->get_elapsed_microseconds();
+						if (wakeMicroseconds <= elapsedMicroseconds)
+							timeout = timeout_t::none();
+						else
+							timeout = measure<fixed_integer<false, 64>, microseconds>(wakeMicroseconds - elapsedMicroseconds);
+					}
 				} while (!myTimerGlobals->m_terminating);
 			}
 		}
@@ -158,6 +431,11 @@ private:
 		volatile transactable_t m_timeoutInfo;
 		const weak_rcptr<timer> m_outerTimer;
 
+		// Only accessed by the timer thread once added
+		inner_timer* m_next;
+		rcptr<inner_timer> m_self; // Keeps this alive while in the wheel
+		uint64_t m_tick;
+
 		typedef transactable_t::read_token read_token;
 		typedef transactable_t::write_token write_token;
 
@@ -214,9 +492,7 @@ private:
 						}
 						else
 						{
-							multimap<timeout_t, rcref<inner_timer> >::volatile_iterator itor = timerGlobals->m_timers.insert(t, this_rcref).inserted;
-							if (itor == timerGlobals->m_timers.get_first())
-								timerGlobals->m_timerThreadSemaphore.release();
+							timerGlobals->add(this_rcref, t);
 						}
 					}
 					break;
@@ -325,7 +601,9 @@ private:
 
 		inner_timer(const timeout_t& t, const rcref<timer>& tmr)
 			: m_timeoutInfo(transactable_t::construct_embedded_t(), t),
-			m_outerTimer(tmr)
+			m_outerTimer(tmr),
+			m_next(nullptr),
+			m_tick(0)
 		{ }
 	};
 